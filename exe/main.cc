@@ -4,9 +4,9 @@
 #include <pxp-agent/util/daemonize.hpp>
 
 #include <cpp-pcp-client/util/thread.hpp>
-#include <cpp-pcp-client/util/chrono.hpp>
 
 #include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.main"
 #include <leatherman/logging/logging.hpp>
@@ -22,6 +22,7 @@ namespace PXPAgent {
 
 namespace HW = HorseWhisperer;
 namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
 
 // Exit code returned after a successful execution
 static int PXP_AGENT_SUCCESS = 0;
@@ -32,17 +33,63 @@ static int PXP_AGENT_GENERAL_FAILURE = 1;
 // Exit code returned after a parsing failure
 static int PXP_AGENT_PARSING_FAILURE = 2;
 
-// Start a thread that just busy waits to facilitate acceptance testing
+// Set once a termination signal is caught
+static bool stop_requested { false };
+static PCPClient::Util::mutex stop_mutex;
+static PCPClient::Util::condition_variable stop_cond_var;
+
+// The running agent, to be stopped when a termination signal is caught
+static Agent* running_agent_ptr { nullptr };
+
+// Wait until a termination signal is caught, to facilitate
+// acceptance testing
 void loopIdly() {
-    PCPClient::Util::thread idle_thread {
+    PCPClient::Util::unique_lock<PCPClient::Util::mutex> the_lock { stop_mutex };
+    stop_cond_var.wait(the_lock, []() { return stop_requested; });
+}
+
+// NB: the agent is stopped right away if a termination signal was
+// caught before it was set
+void setRunningAgent(Agent* agent_ptr) {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { stop_mutex };
+    running_agent_ptr = agent_ptr;
+
+    if (running_agent_ptr != nullptr && stop_requested) {
+        running_agent_ptr->stop();
+    }
+}
+
+bool isStopRequested() {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { stop_mutex };
+    return stop_requested;
+}
+
+#ifndef _WIN32
+// Start a thread that waits for a termination signal; once caught,
+// stop the running agent (if any) so that startAgent() drains it and
+// returns
+void watchTerminationSignals() {
+    Util::setTerminationSignalHandlers();
+
+    PCPClient::Util::thread watcher_thread {
         []() {
-            for (;;) {
-                PCPClient::Util::this_thread::sleep_for(
-                    PCPClient::Util::chrono::milliseconds(5000));
+            auto sig = Util::waitForTerminationSignal();
+            LOG_INFO("Caught signal %1% - stopping pxp-agent",
+                     std::to_string(sig));
+
+            // NB: stop() does not block
+            PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock {
+                stop_mutex };
+            stop_requested = true;
+            stop_cond_var.notify_all();
+
+            if (running_agent_ptr != nullptr) {
+                running_agent_ptr->stop();
             }
         } };
-    idle_thread.join();
+    watcher_thread.detach();
 }
+#endif
 
 int startAgent(std::vector<std::string> arguments) {
 #ifndef _WIN32
@@ -68,6 +115,10 @@ int startAgent(std::vector<std::string> arguments) {
         return PXP_AGENT_GENERAL_FAILURE;
     }
 
+#ifndef _WIN32
+    watchTerminationSignals();
+#endif
+
     int exit_code { PXP_AGENT_SUCCESS };
     if (!Configuration::Instance().valid()) {
         // pxp-agent will execute in uncofigured mode
@@ -75,7 +126,16 @@ int startAgent(std::vector<std::string> arguments) {
     } else {
         try {
             Agent agent { Configuration::Instance().getAgentConfiguration() };
+            setRunningAgent(&agent);
+            lth_util::scope_exit agent_resetter {
+                []() { setRunningAgent(nullptr); } };
             agent.start();
+
+            // NB: start() returns once stopped; the connection is
+            // kept while draining, to send the responses
+            if (isStopRequested()) {
+                agent.drain(Configuration::Instance().get<int>("drain-timeout"));
+            }
         } catch (const Agent::WebSocketConfigurationError& e) {
             LOG_ERROR("WebSocket configuration error (%1%) - pxp-agent will "
                       "continue executing, but will not attempt to connect to "
@@ -95,6 +155,14 @@ int startAgent(std::vector<std::string> arguments) {
 
 #ifdef _WIN32
     Util::daemon_cleanup();
+#else
+    // NB: otherwise the PID file is removed by pidf_ptr
+    if (isStopRequested() && !HW::GetFlag<bool>("foreground") && !pidf_ptr) {
+        auto pidfile = Configuration::Instance().get<std::string>("pidfile");
+        LOG_INFO("Removing PID file '%1%'", pidfile);
+        Util::PIDFile pidf { pidfile };
+        pidf.cleanup();
+    }
 #endif
     return exit_code;
 }
@@ -3,7 +3,9 @@
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <cstdint>
 #include <string>
+#include <utility>  // move
 
 namespace PXPAgent {
 
@@ -18,18 +20,32 @@ struct ActionOutcome {
     std::string std_out;
     lth_jc::JsonContainer results;
 
-    ActionOutcome() {
+    /// Whether the results were validated against the output schema
+    /// of the action while being parsed; in that case, the results of
+    /// a non-blocking action are parsed only if they must be sent
+    bool validated;
+
+    /// Whether the output of a non-blocking action was left in the
+    /// spool, to be sent in fragments; std_out and results are then
+    /// empty
+    bool fragmented;
+
+    ActionOutcome()
+            : validated { false },
+              fragmented { false } {
     }
 
     ActionOutcome(int exitcode_,
-                  std::string& stderr_,
-                  std::string& stdout_,
-                  lth_jc::JsonContainer& results_)
+                  const std::string& stderr_,
+                  const std::string& stdout_,
+                  const lth_jc::JsonContainer& results_)
             : type { Type::External },
               exitcode { exitcode_ },
               std_err { stderr_ },
               std_out { stdout_ },
-              results { results_ } {
+              results { results_ },
+              validated { false },
+              fragmented { false } {
     }
 
     ActionOutcome(int exitcode_,
@@ -38,23 +54,29 @@ struct ActionOutcome {
                   lth_jc::JsonContainer&& results_)
             : type { Type::External },
               exitcode { exitcode_ },
-              std_err { stderr_ },
-              std_out { stdout_ },
-              results { results_ } {
+              std_err { std::move(stderr_) },
+              std_out { std::move(stdout_) },
+              results { std::move(results_) },
+              validated { false },
+              fragmented { false } {
     }
 
     ActionOutcome(int exitcode_,
-                  lth_jc::JsonContainer& results_)
+                  const lth_jc::JsonContainer& results_)
             : type { Type::Internal },
               exitcode { exitcode_ },
-              results { results_ } {
+              results { results_ },
+              validated { false },
+              fragmented { false } {
     }
 
     ActionOutcome(int exitcode_,
                   lth_jc::JsonContainer&& results_)
             : type { Type::Internal },
               exitcode { exitcode_ },
-              results { results_ } {
+              results { std::move(results_) },
+              validated { false },
+              fragmented { false } {
     }
 };
 
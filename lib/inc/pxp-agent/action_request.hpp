@@ -1,13 +1,17 @@
 #ifndef SRC_AGENT_ACTION_REQUEST_HPP_
 #define SRC_AGENT_ACTION_REQUEST_HPP_
 
+#include <pxp-agent/request_timeline.hpp>
+
 #include <cpp-pcp-client/protocol/chunks.hpp>      // ParsedChunk
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <vector>
 
 namespace PXPAgent {
 
@@ -18,6 +22,10 @@ static std::map<RequestType, std::string> requestTypeNames {
     { RequestType::Blocking, "blocking" },
     { RequestType::NonBlocking, "non blocking" } };
 
+/// Return the content of the parsed chunks, for logging; binary data
+/// is described by its size, rather than dumped
+std::string describeParsedChunks(const PCPClient::ParsedChunks& parsed_chunks);
+
 class ActionRequest {
   public:
     struct Error : public std::runtime_error {
@@ -25,8 +33,16 @@ class ActionRequest {
     };
 
     /// Throws an ActionRequest::Error in case it fails to retrieve
-    /// the data chunk from the specified ParsedChunks or in case of
-    /// binary data (currently not supported).
+    /// the data chunk from the specified ParsedChunks or, in case of
+    /// binary data, if its header is missing or invalid.
+    ///
+    /// Binary data is made of a header line, with the same JSON
+    /// content of the data of the JSON requests, followed by a blob
+    /// (see PXPSchemas::BINARY_BLOCKING_REQUEST_TYPE); the data entry
+    /// of parsedChunks() is then set to the header.
+    ///
+    /// NB: the constructor that takes a const reference copies the
+    /// parsed chunks, blob included.
     ActionRequest(RequestType type_,
                   const PCPClient::ParsedChunks& parsed_chunks_);
     ActionRequest(RequestType type_,
@@ -39,14 +55,40 @@ class ActionRequest {
     const std::string& module() const;
     const std::string& action() const;
     const bool& notifyOutcome() const;
+
+    /// The encoding of the results accepted by the requester (e.g.
+    /// "gzip"); empty if not specified
+    const std::string& acceptEncoding() const;
+    /// NB: the debug entry is moved to debug()
     const PCPClient::ParsedChunks& parsedChunks() const;
 
+    /// The debug chunks of the request, shared with its responses, so
+    /// that they are not copied for each response
+    const std::shared_ptr<const std::vector<lth_jc::JsonContainer>>& debug() const;
+
+    /// Whether the requester asked for the timeline of the request,
+    /// with the "timing" entry of the data
+    bool timing() const;
+
+    /// The timeline of the request, from which the phase latencies
+    /// of its action are recorded
+    const RequestTimeline& timeline() const;
+
+    /// Stamp the event on the timeline of the request
+    void stamp(RequestTimeline::Event event) const;
+
     // The following accessors perform lazy initialization
     // The params entry is not required; in case it's not included
     // in the request, an empty JsonContainer object is returned
     const lth_jc::JsonContainer& params() const;
     const std::string& paramsTxt() const;
 
+    /// Whether the request has binary data, with a blob
+    bool hasBlob() const;
+
+    /// The blob of a request with binary data; empty otherwise
+    const std::string& blob() const;
+
   private:
     RequestType type_;
     std::string id_;
@@ -55,7 +97,11 @@ class ActionRequest {
     std::string module_;
     std::string action_;
     bool notify_outcome_;
+    std::string accept_encoding_;
     PCPClient::ParsedChunks parsed_chunks_;
+    std::shared_ptr<const std::vector<lth_jc::JsonContainer>> debug_;
+    bool timing_;
+    std::shared_ptr<RequestTimeline> timeline_;
 
     // Lazy initialized
     mutable lth_jc::JsonContainer params_;
@@ -63,6 +109,7 @@ class ActionRequest {
 
     void init();
     void validateFormat();
+    void parseBinaryData();
 };
 
 }  // namespace PXPAgent
@@ -7,6 +7,7 @@
 #include <pxp-agent/configuration.hpp>
 
 #include <cpp-pcp-client/protocol/chunks.hpp>      // ParsedChunk
+#include <cpp-pcp-client/util/thread.hpp>
 
 #include <memory>
 #include <string>
@@ -37,7 +38,7 @@ class Agent {
     // identity by inspecting the certificate.
     Agent(const Configuration::Agent& agent_configuration);
 
-    // Start the agent and loop indefinitely, by:
+    // Start the agent and loop until stop() is called, by:
     //  - registering message callbacks;
     //  - connecting to the PCP broker;
     //  - monitoring the state of the connection;
@@ -47,6 +48,18 @@ class Agent {
     // such as message sending failures are only logged.
     void start();
 
+    // Make start() return, once its current connection attempt, if
+    // any, is done. It can be called from any thread, also before
+    // start().
+    void stop();
+
+    // Stop processing requests and wait up to the specified timeout
+    // for the running jobs to complete; the jobs that are still
+    // running afterwards will be flagged as orphaned in the spool.
+    // It's meant to be called once start() returned, before
+    // destroying the agent, so that the responses can be sent.
+    void drain(uint32_t timeout_s);
+
   private:
     // PXP connector
     std::shared_ptr<PXPConnector> connector_ptr_;
@@ -54,6 +67,19 @@ class Agent {
     // Request Processor
     RequestProcessor request_processor_;
 
+    bool stopping_;
+    PCPClient::Util::mutex stop_mutex_;
+    PCPClient::Util::condition_variable stop_cond_var_;
+
+    // Wait up to the specified time for stop() to be called.
+    // Return true if the agent is stopping.
+    bool waitForStop(uint32_t timeout_s);
+
+    // Try to connect to the PCP broker until connected, retrying with
+    // an increasing delay, or until the agent is stopping.
+    // Return true if connected.
+    bool connectUntilStopped();
+
     // Callback for PCPClient::Connector handling incoming PXP
     // blocking requests; it will execute the requested action and,
     // once finished, reply to the sender with an PXP blocking
@@ -0,0 +1,68 @@
+#ifndef SRC_AGENT_AGENT_METRICS_HPP_
+#define SRC_AGENT_AGENT_METRICS_HPP_
+
+#include <pxp-agent/dispatch_table.hpp>
+#include <pxp-agent/histogram.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+/// Collects the metrics of the agent: the request counters and the
+/// per-phase latency histograms of each action, kept by the handles
+/// of the dispatch table, plus the registered latency histograms,
+/// counters and gauges.
+///
+/// The metrics are recorded by the request processing code without
+/// any locking (see Histogram); they are only aggregated here, when
+/// a report is requested.
+class AgentMetrics {
+  public:
+    /// Return the current value of a quantity (e.g. a queue depth or
+    /// the number of dropped messages)
+    using Gauge = std::function<uint64_t()>;
+
+    /// The table must outlive the instance; it may be reassigned, as
+    /// long as no report is being produced meanwhile
+    explicit AgentMetrics(const DispatchTable& dispatch_table);
+
+    /// Register a gauge. Not thread safe: gauges and latencies must
+    /// be registered before any report is requested.
+    void addGauge(const std::string& name, Gauge gauge);
+
+    /// Register a counter, i.e. a gauge whose value never decreases
+    void addCounter(const std::string& name, Gauge counter);
+
+    /// Register a histogram, that must outlive the instance
+    void addLatency(const std::string& name, const Histogram& histogram);
+
+    /// Return an object with:
+    ///  - "actions": array with the counters ("requests", "failures")
+    ///    and latencies, by phase, of each action;
+    ///  - "latencies": object with the registered histograms;
+    ///  - "counters" and "gauges": objects with their current values.
+    /// Latencies are reported as their count, their sum, maximum and
+    /// quantiles in ms, and their non-empty buckets.
+    lth_jc::JsonContainer getReport() const;
+
+    /// Return the same metrics in the Prometheus text exposition
+    /// format; names are prefixed with "pxp_agent_" and latencies are
+    /// reported in seconds, with a bucket for each power of 2 us.
+    std::string getPrometheusText() const;
+
+  private:
+    const DispatchTable& dispatch_table_;
+    std::map<std::string, Gauge> gauges_;
+    std::map<std::string, Gauge> counters_;
+    std::map<std::string, const Histogram*> latencies_;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_AGENT_METRICS_HPP_
@@ -0,0 +1,100 @@
+#ifndef SRC_AGENT_COMPILED_SCHEMA_HPP_
+#define SRC_AGENT_COMPILED_SCHEMA_HPP_
+
+#include <cpp-pcp-client/validator/schema.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <iosfwd>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+/// JSON schema compiled into a flat list of checks, so that a
+/// document can be validated with a single loop, without walking the
+/// schema nor allocating memory (unless the document is invalid).
+///
+/// Only the subset of JSON Schema used by the actions of modules is
+/// supported: the "type" (single or multiple types), "properties",
+/// and "required" keywords, plus the annotations ("description",
+/// "title", "$schema", "id", "default"); schemas that include other
+/// keywords must be validated with a PCPClient::Validator.
+///
+/// The path of each property is built once, when the schema is
+/// compiled; a property is checked only if its parent object exists.
+/// JSON text can also be validated while being parsed, by matching
+/// the keys of the objects being scanned against the checks.
+class CompiledSchema {
+  public:
+    struct Unsupported : public std::runtime_error {
+        explicit Unsupported(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// Schema of an object, without constraints on its properties
+    CompiledSchema();
+
+    /// Throw a CompiledSchema::Unsupported in case the schema
+    /// includes unsupported keywords or invalid entries.
+    explicit CompiledSchema(const lth_jc::JsonContainer& schema);
+
+    /// Add a constraint on a top level property, as done with
+    /// PCPClient::Schema::addConstraint
+    void addConstraint(const std::string& property,
+                       PCPClient::TypeConstraint type,
+                       bool required = false);
+
+    /// Return true if the document is valid; otherwise set the error
+    /// message and return false
+    bool validate(const lth_jc::JsonContainer& data, std::string& error) const;
+
+    /// Parse the JSON text and validate it with a single pass over its
+    /// bytes, without building the document. Return true if the text
+    /// is valid JSON that complies with the schema; otherwise set the
+    /// error message and return false, with parse_error telling
+    /// whether the text is not valid JSON.
+    bool validate(const std::string& json_txt,
+                  std::string& error,
+                  bool& parse_error) const;
+
+    /// Same as above, reading the JSON text from the stream a buffer
+    /// at a time, so that the memory used does not depend on its size
+    bool validate(std::istream& json_stream,
+                  std::string& error,
+                  bool& parse_error) const;
+
+  private:
+    struct TextScanner;
+
+    struct Check {
+        std::vector<lth_jc::JsonContainerKey> path;
+
+        /// Allowed types (see typeBit()); 0 means any type
+        unsigned int types;
+
+        bool required;
+
+        /// Number of checks of the nested properties, that follow
+        /// this one and are skipped if the property is not an object
+        size_t num_nested;
+    };
+
+    unsigned int root_types_;
+    std::vector<Check> checks_;
+
+    bool validate(TextScanner& scanner,
+                  std::string& error,
+                  bool& parse_error) const;
+
+    void compileObject(const lth_jc::JsonContainer& schema,
+                       const std::vector<lth_jc::JsonContainerKey>& path);
+
+    static unsigned int compileTypes(const lth_jc::JsonContainer& schema);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_COMPILED_SCHEMA_HPP_
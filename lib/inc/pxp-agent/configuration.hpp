@@ -131,6 +131,22 @@ class Configuration {
         std::string spool_dir;
         std::string modules_config_dir;
         std::string client_type;
+        int max_concurrent_jobs;
+        int max_queued_jobs;
+        double sender_rate_limit;
+        int sender_rate_burst;
+        int metadata_flush_delay;
+        int spool_archive_after;
+        int spool_archive_retention;
+        int outbound_queue_size;
+        int outbound_message_ttl;
+        int response_batch_delay;
+        int response_batch_size;
+        int result_compression_threshold;
+        int result_fragment_size;
+        std::string metrics_textfile;
+        int metrics_interval;
+        std::string metrics_socket;
     };
 
     /// Reset the HorseWhisperer singleton.
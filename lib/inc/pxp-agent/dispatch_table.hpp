@@ -0,0 +1,109 @@
+#ifndef SRC_AGENT_DISPATCH_TABLE_HPP_
+#define SRC_AGENT_DISPATCH_TABLE_HPP_
+
+#include <pxp-agent/module.hpp>
+#include <pxp-agent/histogram.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+/// Table of the actions of the loaded modules, built once all modules
+/// are loaded and never modified afterwards, so that it can be read
+/// concurrently without locking.
+///
+/// The handles of the actions are stored in a flat, open addressing
+/// hash table indexed by the combined hash of the module and action
+/// names; a request is dispatched with a single lookup, that does not
+/// allocate memory.
+class DispatchTable {
+  public:
+    /// Phases of the processing of a request, timed per action
+    enum class Phase { Validation, QueueWait, Spawn, Execution, Send };
+    static const size_t NUM_PHASES { 5 };
+
+    static const std::string& phaseName(Phase phase);
+
+    /// Counters and latency histograms of the requests of an action
+    struct Stats {
+        std::atomic<uint64_t> num_requests;
+        std::atomic<uint64_t> num_failures;
+        std::atomic<uint64_t> total_duration_ms;
+
+        /// Indexed by Phase
+        std::array<Histogram, NUM_PHASES> latencies;
+    };
+
+    struct Handle {
+        std::shared_ptr<Module> module_ptr;
+        std::string module_name;
+        std::string action_name;
+
+        /// Whether the action supports only blocking requests (i.e.
+        /// it belongs to an internal module)
+        bool blocking_only;
+
+        /// Compiled input schema, if any, owned by the module
+        const CompiledSchema* input_schema;
+
+        Stats stats;
+
+        Handle(std::shared_ptr<Module> module_ptr_,
+               const std::string& action_name_);
+
+        /// Validate the input parameters, with the compiled schema if
+        /// available or with the validator of the module otherwise.
+        /// Throw a PCPClient::validation_error if invalid.
+        void validateInput(const lth_jc::JsonContainer& params) const;
+
+        /// Update the stats after a request has been processed
+        void recordRequest(bool succeeded, uint64_t duration_ms);
+
+        void recordPhase(Phase phase, uint64_t duration_us);
+    };
+
+    /// Empty table
+    DispatchTable();
+
+    /// Build the table from the loaded modules, by module name
+    explicit DispatchTable(
+        const std::map<std::string, std::shared_ptr<Module>>& modules);
+
+    /// Return the handle of the specified action or nullptr, in case
+    /// the module or the action is unknown
+    std::shared_ptr<Handle> find(const std::string& module_name,
+                                 const std::string& action_name) const;
+
+    /// The handles of all actions, ordered by module and action name
+    const std::vector<std::shared_ptr<Handle>>& handles() const;
+
+  private:
+    struct Slot {
+        size_t hash;
+        std::shared_ptr<Handle> handle;
+    };
+
+    std::vector<std::shared_ptr<Handle>> handles_;
+
+    /// Number of slots is a power of two, at least twice the number
+    /// of handles; empty slots have a null handle
+    std::vector<Slot> slots_;
+
+    size_t mask_;
+
+    static size_t hashOf(const std::string& module_name,
+                         const std::string& action_name);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_DISPATCH_TABLE_HPP_
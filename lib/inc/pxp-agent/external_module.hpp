@@ -44,6 +44,8 @@ class ExternalModule : public Module {
 
     /// Writes the content of the specified out/err_file in,
     /// respectively, out/err_txt. Reads first err_file.
+    /// The files are decompressed in case they have been compressed
+    /// by the OutputCompressor.
     /// Throws a ProcessingError in case it fails to read out_file.
     static void readNonBlockingOutcome(const ActionRequest& request,
                                        const std::string& out_file,
@@ -58,6 +60,9 @@ class ExternalModule : public Module {
     /// Module configuration data
     lth_jc::JsonContainer config_;
 
+    /// Module configuration data, serialized once for all requests
+    const std::string config_txt_;
+
     /// Metadata validator
     static const PCPClient::Validator metadata_validator_;
 
@@ -69,21 +74,47 @@ class ExternalModule : public Module {
 
     void registerAction(const lth_jc::JsonContainer& action);
 
+    void compileSchema(std::map<std::string, CompiledSchema>& schemas,
+                       const std::string& action_name,
+                       const lth_jc::JsonContainer& schema);
+
     /// Returns a string in JSON format, containing the "params" entry
     /// of the PXP request and the module configuration (both are
-    /// JSON objects).
+    /// JSON objects). The string is assembled from the serialized
+    /// params and configuration, without building a JsonContainer.
+    /// In case the request has a blob, it follows the JSON input,
+    /// after a newline; note that this copies the blob.
     std::string getRequestInput(const ActionRequest& request);
 
     /// Log information about the outcome of the performed action
     /// while checking the exit code and validating the JSON format
     /// of the output.
-    /// Returns an ActionOutcome object.
+    /// Returns an ActionOutcome object; out_txt and err_txt are moved
+    /// into it. If the output schema of the action is compiled, the
+    /// output is validated while being parsed.
     /// Throws a ProcessingError in case of invalid output.
     ActionOutcome processRequestOutcome(const ActionRequest& request,
                                         int exit_code,
                                         std::string& out_txt,
                                         std::string& err_txt);
 
+    /// Same as above, for the output of a non-blocking action whose
+    /// results will be sent in fragments: the output file is validated
+    /// with the compiled schema while being read, without loading it,
+    /// and the outcome is flagged as fragmented, with no results.
+    /// Throws a ProcessingError in case of invalid output.
+    ActionOutcome processFragmentedOutcome(const ActionRequest& request,
+                                           int exit_code,
+                                           const std::string& out_file,
+                                           std::string& err_txt,
+                                           const CompiledSchema& schema);
+
+    /// Log the exit code and the error output of a failed action, or
+    /// the error output of a successful one
+    void logExitStatus(const std::string& action_name,
+                       int exit_code,
+                       const std::string& err_txt);
+
     ActionOutcome callBlockingAction(const ActionRequest& request);
 
     ActionOutcome callNonBlockingAction(const ActionRequest& request);
@@ -0,0 +1,65 @@
+#ifndef SRC_AGENT_HISTOGRAM_HPP_
+#define SRC_AGENT_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PXPAgent {
+
+/// Histogram of durations, in microseconds, with logarithmic buckets:
+/// each power of two is split in 4 linear sub-buckets, so that the
+/// relative error of the reported values is below 25%, for durations
+/// up to 2^40 us (about 12 days).
+///
+/// The counts are striped across shards, selected by the recording
+/// thread, and updated with relaxed atomic operations, so that
+/// recording a duration never blocks and concurrent threads rarely
+/// contend for the same counters. Snapshots are not atomic with
+/// respect to concurrent updates.
+class Histogram {
+  public:
+    static const size_t NUM_BUCKETS { 160 };
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t sum_us;
+        uint64_t max_us;
+
+        /// Count of each bucket
+        std::vector<uint64_t> counts;
+
+        /// Return the upper bound of the bucket that contains the
+        /// specified quantile (in [0, 1]); 0 if empty
+        uint64_t quantile(double q) const;
+    };
+
+    Histogram();
+
+    void record(uint64_t duration_us);
+
+    Snapshot snapshot() const;
+
+    /// Return the index of the bucket of the specified duration
+    static size_t bucketOf(uint64_t duration_us);
+
+    /// Return the (exclusive) upper bound of the specified bucket
+    static uint64_t upperBoundOf(size_t bucket);
+
+  private:
+    static const size_t NUM_SHARDS { 4 };
+
+    struct Shard {
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts;
+        std::atomic<uint64_t> sum_us;
+        std::atomic<uint64_t> max_us;
+    };
+
+    std::array<Shard, NUM_SHARDS> shards_;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_HISTOGRAM_HPP_
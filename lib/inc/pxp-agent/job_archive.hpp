@@ -0,0 +1,117 @@
+#ifndef SRC_AGENT_JOB_ARCHIVE_HPP_
+#define SRC_AGENT_JOB_ARCHIVE_HPP_
+
+#include <pxp-agent/job_index.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+// Size [bytes] above which a new segment is started
+static const uint64_t ARCHIVE_MAX_SEGMENT_SIZE { 64 * 1024 * 1024 };
+
+// Interval between packing and garbage collection runs
+static const uint32_t ARCHIVE_CHECK_INTERVAL_S { 300 };
+
+/// Archive of the results of finalized jobs.
+///
+/// Jobs are packed into append-only segment files stored in the
+/// 'archive' subdirectory of the spool; each record contains the
+/// metadata and the output streams of a job, as they are stored in
+/// the spool (output files may be gzip compressed, see
+/// OutputCompressor). Each segment has an index file that lists the
+/// offset and job ID of its records; the indexes are loaded in memory
+/// when the archive is instantiated.
+///
+/// If enabled, a maintenance thread periodically packs the completed
+/// jobs that were last updated more than 'archive_after_s' seconds
+/// ago, removing their results directories, and drops the segments
+/// that were last written more than 'retention_s' seconds ago.
+class JobArchive {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    struct Record {
+        std::string metadata;
+        std::string stdout_txt;
+        std::string stderr_txt;
+    };
+
+    /// An archive_after_s value of 0 disables packing and garbage
+    /// collection; a retention_s value of 0 means the segments are
+    /// kept forever. Packed jobs are removed from the job index, if
+    /// specified, as their results directory is.
+    /// Throw a JobArchive::Error in case it fails to load the index.
+    JobArchive(const std::string& spool_dir,
+               uint32_t archive_after_s = 0,
+               uint32_t retention_s = 0,
+               uint64_t max_segment_size = ARCHIVE_MAX_SEGMENT_SIZE,
+               std::shared_ptr<JobIndex> job_index_ptr = nullptr);
+
+    ~JobArchive();
+
+    /// Retrieve the record of the specified job; the output streams
+    /// are decompressed. Return false if the job is not archived.
+    /// Throw a JobArchive::Error in case of read failure.
+    bool find(const std::string& job_id, Record& record);
+
+    /// Append the results of the job stored in the specified
+    /// directory to the archive, then remove the directory.
+    /// Throw a JobArchive::Error in case of failure.
+    void pack(const std::string& job_dir);
+
+    /// Pack the completed jobs whose metadata was last modified
+    /// before the specified time.
+    /// Return the number of packed jobs.
+    unsigned int packCompletedJobs(std::time_t modified_before);
+
+    /// Remove the sealed segments last written before the specified
+    /// time, together with their index.
+    /// Return the number of removed segments.
+    unsigned int removeSegments(std::time_t written_before);
+
+  private:
+    struct Location {
+        uint32_t segment;
+        uint64_t offset;
+    };
+
+    std::string spool_dir_;
+    std::string archive_dir_;
+    uint32_t archive_after_s_;
+    uint32_t retention_s_;
+    uint64_t max_segment_size_;
+    std::shared_ptr<JobIndex> job_index_ptr_;
+    std::map<std::string, Location> index_;
+    uint32_t current_segment_;
+    bool stopping_;
+
+    /// Serializes the writes of segments and indexes and guards
+    /// current_segment_; held while syncing files, so it's never
+    /// taken by readers
+    PCPClient::Util::mutex writer_mutex_;
+
+    /// Guards index_ and stopping_; acquired after writer_mutex_
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+    PCPClient::Util::thread maintenance_thread_;
+
+    std::string getSegmentPath(uint32_t segment) const;
+
+    void loadIndex();
+
+    void maintenanceTask();
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_JOB_ARCHIVE_HPP_
@@ -0,0 +1,50 @@
+#ifndef SRC_AGENT_JOB_INDEX_HPP_
+#define SRC_AGENT_JOB_INDEX_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <map>
+#include <string>
+
+namespace PXPAgent {
+
+/// In-memory index of the jobs (non-blocking actions) in progress,
+/// by job ID.
+///
+/// The index is populated by the startup scan of the spool (see
+/// SpoolRecovery) with the jobs whose process is still executing or
+/// whose outcome is yet to be stored, and kept up to date as jobs are
+/// started and finalized, so that a job in progress can be told
+/// without inspecting its process. Jobs are removed once their
+/// metadata is finalized, as it then tells their state; the index
+/// does not grow with the spool.
+class JobIndex {
+  public:
+    struct Entry {
+        std::string job_dir;
+    };
+
+    JobIndex();
+
+    /// Add the entry of the specified job
+    void set(const std::string& job_id, const std::string& job_dir);
+
+    /// Remove the entry of the specified job, if indexed (i.e. once
+    /// its metadata has been finalized)
+    void remove(const std::string& job_id);
+
+    /// Retrieve the entry of the specified job.
+    /// Return false if the job is not indexed.
+    bool find(const std::string& job_id, Entry& entry);
+
+    /// Number of jobs in progress
+    size_t size();
+
+  private:
+    std::map<std::string, Entry> entries_;
+    PCPClient::Util::mutex mutex_;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_JOB_INDEX_HPP_
@@ -0,0 +1,123 @@
+#ifndef SRC_AGENT_JOB_JOURNAL_HPP_
+#define SRC_AGENT_JOB_JOURNAL_HPP_
+
+#include <pxp-agent/action_request.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+// Number of records appended after which the journal is compacted,
+// i.e. rewritten with the records of the jobs that are not done
+static const uint32_t JOURNAL_COMPACTION_THRESHOLD { 4096 };
+
+/// Write-ahead journal of the accepted non-blocking requests.
+///
+/// Each record is a line made of the CRC32 checksum of its JSON
+/// content followed by the content itself; records describe the
+/// state transitions of a job: 'accepted', 'started', 'completed'
+/// and 'failed'. Records are appended by a writer thread that syncs
+/// the file once per batch (group commit); the callback passed to
+/// logAccepted() is executed by the writer thread once its record is
+/// durable, whereas the other transitions are recorded without
+/// notification.
+///
+/// The records of a job are kept, to be rewritten when the file is
+/// compacted, until the job is started, completed or failed; the
+/// started jobs are taken over by SpoolRecovery, both when replaying
+/// the file and when compacting it.
+///
+/// When instantiated, the journal replays the existing file, ignoring
+/// the records following a corrupted or truncated one, and determines
+/// the jobs that were accepted but not started by the previous run.
+class JobJournal {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// Job that was accepted by a previous run but never started
+    struct Entry {
+        std::string job_id;
+        std::string requester;
+        std::string request_id;
+        std::string module;
+        std::string action;
+        bool notify_outcome;
+    };
+
+    /// Throw a JobJournal::Error in case it fails to open the file
+    explicit JobJournal(const std::string& file_path);
+
+    ~JobJournal();
+
+    /// Return the jobs accepted by the previous run that were never
+    /// started; such jobs are expected to be flagged as failed.
+    std::vector<Entry> getInterruptedJobs() const;
+
+    /// Executed by the writer thread with true once the record is
+    /// durable, with false in case of write failure
+    using Callback = std::function<void(bool)>;
+
+    /// Record the acceptance of the request, without waiting for the
+    /// record to be written; the callback tells when it's durable.
+    void logAccepted(const ActionRequest& request, Callback on_durable);
+
+    void logStarted(const std::string& job_id);
+    void logCompleted(const std::string& job_id);
+    void logFailed(const std::string& job_id);
+
+    /// Block until the queued records are written and the callbacks
+    /// of their batches executed
+    void flush();
+
+  private:
+    std::string file_path_;
+    std::FILE* file_;
+    std::vector<Entry> interrupted_jobs_;
+
+    /// Accepted record of the jobs that were not started, by job ID
+    std::map<std::string, std::string> live_records_;
+    uint32_t num_appended_records_;
+
+    std::vector<std::string> pending_records_;
+    /// Callbacks of the pending records, executed once the records
+    /// are written
+    std::vector<Callback> pending_callbacks_;
+    bool writing_;
+    bool stopping_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable writer_cond_var_;
+    PCPClient::Util::condition_variable batch_cond_var_;
+    PCPClient::Util::thread writer_thread_;
+
+    void replay();
+
+    /// Queue a record; the callback, if any, is executed once the
+    /// batch of the record is written
+    void append(const std::string& job_id,
+                const std::string& state,
+                const std::string& record,
+                Callback on_durable = nullptr);
+
+    void writerTask();
+
+    /// Write and sync the records; return false in case of failure
+    bool writeRecords(const std::vector<std::string>& records);
+
+    /// Atomically replace the file with the specified records and
+    /// reopen it; return false in case of failure
+    bool rewrite(const std::vector<std::string>& records);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_JOB_JOURNAL_HPP_
@@ -0,0 +1,86 @@
+#ifndef SRC_AGENT_METADATA_WRITER_HPP_
+#define SRC_AGENT_METADATA_WRITER_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+/// Write the metadata files of jobs in groups.
+///
+/// Updates are queued and written by a separate thread; multiple
+/// updates of the same file that are queued at the same time are
+/// coalesced. Once it wakes up, the writer thread waits up to the
+/// specified delay for further updates, writes and syncs each file of
+/// the batch to a temporary file, renames the temporary files that
+/// were synced and, lastly, syncs each of their directories once.
+///
+/// Until a file has been renamed, its content can be retrieved with
+/// read(), so that readers see a consistent view of the metadata.
+class MetadataWriter {
+  public:
+    /// The writer thread waits up to max_delay_ms for the updates to
+    /// be grouped; a value of 0 means no delay.
+    explicit MetadataWriter(uint32_t max_delay_ms = 0);
+
+    /// Write the queued updates before returning
+    ~MetadataWriter();
+
+    /// Executed by the writer thread with true once the file is
+    /// written, with false in case of failure
+    using Callback = std::function<void(bool)>;
+
+    /// Queue the update of the specified file; the callback, if any,
+    /// is executed once the update (or a later one that replaced it
+    /// while queued) is written
+    void write(const std::string& file_path,
+               const std::string& content,
+               Callback on_written = nullptr);
+
+    /// Retrieve the content of the specified file, either from the
+    /// queued updates or, if none, from disk.
+    /// Return false in case the file cannot be read.
+    bool read(const std::string& file_path, std::string& content);
+
+    /// Block until all queued updates have been written and their
+    /// callbacks executed
+    void flush();
+
+    uint32_t getNumWrittenBatches();
+
+  private:
+    struct Update {
+        std::string content;
+        std::vector<Callback> callbacks;
+    };
+
+    uint32_t max_delay_ms_;
+
+    /// Updates waiting to be written, by file path
+    std::map<std::string, Update> pending_;
+
+    /// Updates being written by the writer thread
+    std::map<std::string, Update> in_flight_;
+
+    uint32_t num_written_batches_;
+    uint32_t num_flush_requests_;
+    bool stopping_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable writer_cond_var_;
+    PCPClient::Util::condition_variable flushed_cond_var_;
+    PCPClient::Util::thread writer_thread_;
+
+    void writerTask();
+
+    /// Write the files; return the paths of the ones not written
+    std::set<std::string> writeBatch(const std::map<std::string, Update>& batch);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_METADATA_WRITER_HPP_
@@ -0,0 +1,67 @@
+#ifndef SRC_AGENT_METRICS_EXPORTER_HPP_
+#define SRC_AGENT_METRICS_EXPORTER_HPP_
+
+#include <pxp-agent/agent_metrics.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+/// Exports the metrics of the agent, in the Prometheus text format,
+/// for node-local collectors.
+///
+/// A dedicated thread periodically writes the metrics to a file, for
+/// the textfile collector of the node exporter; the file is replaced
+/// atomically. The metrics can also be served on a Unix domain socket
+/// (not supported on Windows), one client at a time: a client that
+/// sends an HTTP GET request gets an HTTP response, any other gets
+/// the bare metrics. The connection is then closed.
+class MetricsExporter {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// An empty path disables the relevant export. The socket file is
+    /// replaced if it exists, and removed when the exporter is
+    /// destroyed.
+    /// Throw a MetricsExporter::Error in case it fails to listen on
+    /// the socket.
+    MetricsExporter(std::shared_ptr<AgentMetrics> metrics_ptr,
+                    const std::string& textfile_path,
+                    uint32_t interval_s,
+                    const std::string& socket_path);
+
+    ~MetricsExporter();
+
+    /// Write the metrics to the textfile.
+    /// Throw a MetricsExporter::Error in case of failure.
+    void writeTextfile();
+
+  private:
+    std::shared_ptr<AgentMetrics> metrics_ptr_;
+    std::string textfile_path_;
+    uint32_t interval_s_;
+    std::string socket_path_;
+
+    /// Listening socket; -1 if not serving
+    int socket_fd_;
+
+    bool stopping_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+    PCPClient::Util::thread exporter_thread_;
+
+    void exporterTask();
+
+    /// Wait up to the specified time for a client and serve it
+    void serveClient(uint32_t timeout_ms);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_METRICS_EXPORTER_HPP_
@@ -3,12 +3,14 @@
 
 #include <pxp-agent/action_outcome.hpp>
 #include <pxp-agent/action_request.hpp>
+#include <pxp-agent/compiled_schema.hpp>
 
 #include <cpp-pcp-client/protocol/chunks.hpp>      // ParsedChunks
 #include <cpp-pcp-client/validator/validator.hpp>  // Validator
 
 #include <leatherman/json_container/json_container.hpp>
 
+#include <map>
 #include <vector>
 #include <string>
 
@@ -38,6 +40,11 @@ class Module {
     PCPClient::Validator input_validator_;
     PCPClient::Validator output_validator_;
 
+    /// Compiled input and output schemas, by action name; when
+    /// available, they are used in place of the validators
+    std::map<std::string, CompiledSchema> compiled_input_schemas_;
+    std::map<std::string, CompiledSchema> compiled_output_schemas_;
+
     Module();
 
     /// Whether or not the module has the specified action.
@@ -52,6 +59,24 @@ class Module {
     /// the action or if the action returns an invalid output.
     ActionOutcome executeAction(const ActionRequest& request);
 
+    /// Validate the input parameters of the specified action.
+    /// Throw a PCPClient::validation_error if invalid.
+    void validateInput(const lth_jc::JsonContainer& params,
+                       const std::string& action_name) const;
+
+    /// Validate the results of the specified action.
+    /// Throw a PCPClient::validation_error if invalid.
+    void validateOutput(const lth_jc::JsonContainer& results,
+                        const std::string& action_name) const;
+
+    /// Validate the data with the compiled schema, if not null,
+    /// otherwise with the validator schema named after the action.
+    /// Throw a PCPClient::validation_error if invalid.
+    static void validateWith(const CompiledSchema* schema,
+                             const PCPClient::Validator& validator,
+                             const lth_jc::JsonContainer& data,
+                             const std::string& action_name);
+
   protected:
     virtual ActionOutcome callAction(const ActionRequest& request) = 0;
 };
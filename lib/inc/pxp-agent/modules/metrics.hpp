@@ -0,0 +1,27 @@
+#ifndef SRC_MODULES_METRICS_H_
+#define SRC_MODULES_METRICS_H_
+
+#include <pxp-agent/module.hpp>
+#include <pxp-agent/agent_metrics.hpp>
+
+#include <memory>
+
+namespace PXPAgent {
+namespace Modules {
+
+/// Internal module that reports the metrics of the agent, as
+/// collected by AgentMetrics
+class Metrics : public PXPAgent::Module {
+  public:
+    explicit Metrics(std::shared_ptr<AgentMetrics> metrics_ptr);
+
+  private:
+    std::shared_ptr<AgentMetrics> metrics_ptr_;
+
+    ActionOutcome callAction(const ActionRequest& request);
+};
+
+}  // namespace Modules
+}  // namespace PXPAgent
+
+#endif  // SRC_MODULES_METRICS_H_
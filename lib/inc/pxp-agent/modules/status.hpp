@@ -2,6 +2,11 @@
 #define SRC_MODULES_STATUS_H_
 
 #include <pxp-agent/module.hpp>
+#include <pxp-agent/metadata_writer.hpp>
+#include <pxp-agent/job_archive.hpp>
+#include <pxp-agent/job_index.hpp>
+
+#include <memory>
 
 namespace PXPAgent {
 namespace Modules {
@@ -14,7 +19,27 @@ class Status : public PXPAgent::Module {
     static const std::string RUNNING;
 
     Status();
+
+    /// The metadata of jobs will be retrieved through the specified
+    /// writer, to include the updates that are not on disk yet; the
+    /// results of jobs that are not in the spool will be looked up in
+    /// the specified archive, if any; the jobs included in the
+    /// specified index, if any, are reported as running without
+    /// checking their process
+    Status(std::shared_ptr<MetadataWriter> metadata_writer_ptr,
+           std::shared_ptr<JobArchive> archive_ptr = nullptr,
+           std::shared_ptr<JobIndex> index_ptr = nullptr);
+
   private:
+    std::shared_ptr<MetadataWriter> metadata_writer_ptr_;
+    std::shared_ptr<JobArchive> archive_ptr_;
+    std::shared_ptr<JobIndex> index_ptr_;
+
+    /// Return the outcome of an archived job
+    ActionOutcome getArchivedOutcome(const std::string& job_id,
+                                     const JobArchive::Record& record,
+                                     lth_jc::JsonContainer& results);
+
     ActionOutcome callAction(const ActionRequest& request);
 };
 
@@ -0,0 +1,238 @@
+#ifndef SRC_AGENT_OUTBOUND_QUEUE_HPP_
+#define SRC_AGENT_OUTBOUND_QUEUE_HPP_
+
+#include <pxp-agent/histogram.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+// Delay before the first retry of a message
+static const uint32_t OUTBOUND_MIN_BACKOFF_MS { 500 };
+
+// Upper bound of the delay between retries
+static const uint32_t OUTBOUND_MAX_BACKOFF_MS { 30000 };
+
+// Interval between calls of the idle function, while the queue is empty
+static const uint32_t OUTBOUND_IDLE_INTERVAL_MS { 5000 };
+
+/// Queue of the outbound messages, sent in FIFO order (see batching
+/// below) by a dedicated thread, so that the threads producing them never block on the
+/// connection.
+///
+/// In case the send function throws a PCPClient::connection_error
+/// (e.g. while the connection to the broker is being re-established)
+/// the message is kept in its position in the queue and retried with
+/// exponential backoff, until it expires. Messages are dropped, and
+/// logged, when they expire, when they fail with any other error, and
+/// when the queue is destroyed; the queue size, estimated as the size
+/// of the serialized data, is bounded, so that new messages are
+/// rejected when the broker is unreachable for long.
+///
+/// Persistent messages are not retried: when they fail with a
+/// connection error, expire, or are pending when the queue is
+/// destroyed, they are handed over to the undelivered function (e.g.
+/// to be stored in the SpoolOutbox). While the queue is empty, the
+/// sender thread periodically calls the idle function, that can
+/// queue the messages to be delivered again.
+///
+/// If batching is enabled, the messages of the configured types that
+/// have a single target, and were not retrieved from the outbox, wait
+/// up to the specified delay for further messages to the same target;
+/// these are then combined into a single message by the batch
+/// function. Meanwhile, the messages to other targets are sent. The
+/// order of the messages to each target is preserved.
+class OutboundQueue {
+  public:
+    struct Message {
+        std::vector<std::string> targets;
+        std::string message_type;
+        lth_jc::JsonContainer data;
+
+        /// Debug chunks, possibly shared with the request; may be null
+        std::shared_ptr<const std::vector<lth_jc::JsonContainer>> debug;
+
+        /// What the message is, for logging (e.g. "provisional
+        /// response for transaction 1234")
+        std::string description;
+
+        /// Whether the message must be handed over to the undelivered
+        /// function instead of being dropped
+        bool persistent;
+
+        /// Sequence number of the SpoolOutbox file the message was
+        /// retrieved from, 0 if none; such messages are not batched
+        uint64_t outbox_sequence_number;
+
+        /// Serialized data, if already available; otherwise set by
+        /// push, so that the data is serialized once, to estimate its
+        /// size and to send it. Empty for batches, that are sent as
+        /// data.
+        std::string data_txt;
+    };
+
+    /// Send the message; throw a PCPClient::connection_error in case
+    /// it may succeed later
+    using SendFunction = std::function<void(const Message&)>;
+
+    /// Keep the persistent message that could not be delivered;
+    /// return false in case of failure
+    using UndeliveredFunction = std::function<bool(const Message&)>;
+
+    using IdleFunction = std::function<void()>;
+
+    /// Combine the messages, in the given order, into a single one
+    using BatchFunction = std::function<Message(std::vector<Message>&&)>;
+
+    struct BatchOptions {
+        /// Maximum time a message waits for others to join its batch
+        uint32_t max_delay_ms;
+
+        size_t max_messages;
+        std::set<std::string> message_types;
+        BatchFunction batch_function;
+    };
+
+    /// A max_size_bytes value of 0 means no limit; a ttl_s value of
+    /// 0 means messages never expire. The undelivered and idle
+    /// functions are optional.
+    OutboundQueue(SendFunction send_function,
+                  uint64_t max_size_bytes,
+                  uint32_t ttl_s,
+                  uint32_t min_backoff_ms = OUTBOUND_MIN_BACKOFF_MS,
+                  UndeliveredFunction undelivered_function = nullptr,
+                  IdleFunction idle_function = nullptr);
+
+    /// Stop the sender thread; the queued messages are dropped
+    ~OutboundQueue();
+
+    /// Batch the messages from now on; a max_delay_ms of 0 disables
+    /// batching
+    void enableBatching(BatchOptions options);
+
+    /// Queue the message; in case the queue is full, wait up to
+    /// timeout_ms for enough messages to be sent. Return false if it
+    /// was rejected because the queue is full; the message is then
+    /// left untouched, except for its serialized data.
+    bool push(Message&& msg, uint32_t timeout_ms = 0);
+
+    /// Block until the queue is empty or the timeout expires. Return
+    /// true if the queue is empty.
+    bool flush(uint32_t timeout_ms);
+
+    size_t getNumQueued();
+
+    uint64_t getNumDropped();
+
+    /// Time from the queueing of the sent messages to their delivery
+    const Histogram& getSendLatency() const;
+
+  private:
+    struct Entry {
+        Message msg;
+        size_t size;
+        PCPClient::Util::chrono::system_clock::time_point queued;
+        PCPClient::Util::chrono::system_clock::time_point expiry;
+
+        /// Whether the message is a batch or was already considered
+        /// for one
+        bool batched;
+
+        /// Position of the entry in the FIFO order; a batch takes the
+        /// position of its first message
+        uint64_t order;
+    };
+
+    using EntryIterator = std::list<Entry>::iterator;
+
+    SendFunction send_function_;
+    UndeliveredFunction undelivered_function_;
+    IdleFunction idle_function_;
+    uint64_t max_size_bytes_;
+    uint32_t ttl_s_;
+    uint32_t min_backoff_ms_;
+    BatchOptions batch_options_;
+
+    /// NB: a list, so that the entry being sent is not moved and
+    /// entries can be removed from any position
+    std::list<Entry> entries_;
+
+    /// The entries of each list of targets, in FIFO order; only the
+    /// first one of each list can be sent
+    std::map<std::vector<std::string>, std::deque<EntryIterator>> target_entries_;
+
+    uint64_t next_order_;
+    uint64_t queued_size_;
+    uint64_t num_dropped_;
+    bool stopping_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable sender_cond_var_;
+    PCPClient::Util::condition_variable flushed_cond_var_;
+    PCPClient::Util::condition_variable room_cond_var_;
+    Histogram send_latency_;
+    PCPClient::Util::thread sender_thread_;
+
+    void senderTask();
+
+    /// Remove the expired messages; the caller must hold the lock
+    std::vector<Message> takeExpired();
+
+    /// Pass the persistent messages to the undelivered function and
+    /// log the other ones as dropped; the caller must not hold the
+    /// lock. Return the number of dropped messages.
+    uint32_t handOver(const std::vector<Message>& messages,
+                      const std::string& reason);
+
+    /// Remove the entry; the caller must hold the lock
+    void removeAt(EntryIterator it);
+
+    /// Remove the entry and return its message; the caller must hold
+    /// the lock
+    Message takeAt(EntryIterator it);
+
+    /// Remove the entry from the entries of its targets; the caller
+    /// must hold the lock
+    void unindex(EntryIterator it);
+
+    /// Erase the unindexed entry; the caller must hold the lock
+    void eraseEntry(EntryIterator it);
+
+    bool isBatchable(const Entry& entry) const;
+
+    /// Return the messages that can be batched with the given one,
+    /// that must be the first to its targets, starting with it, and
+    /// whether further messages may join them; the caller must hold
+    /// the lock
+    std::vector<EntryIterator> findBatch(EntryIterator first, bool& open) const;
+
+    /// Return the first message that can be sent now, or the end of
+    /// the entries if all messages are waiting for their batch,
+    /// setting wake_up to when the first batch is due; only the first
+    /// message to each list of targets is considered. The caller must
+    /// hold the lock.
+    EntryIterator findReady(
+        PCPClient::Util::chrono::system_clock::time_point& wake_up);
+
+    /// Replace the messages of the batch of the given message with
+    /// the combined one, at the position of the given message, and
+    /// return it; the caller must hold the lock
+    EntryIterator makeBatch(EntryIterator first);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_OUTBOUND_QUEUE_HPP_
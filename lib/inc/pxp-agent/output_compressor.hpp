@@ -0,0 +1,71 @@
+#ifndef SRC_AGENT_OUTPUT_COMPRESSOR_HPP_
+#define SRC_AGENT_OUTPUT_COMPRESSOR_HPP_
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <deque>
+#include <string>
+
+namespace PXPAgent {
+
+// Size [bytes] below which output files are not worth compressing
+static const uint64_t COMPRESSION_MIN_SIZE { 1024 };
+
+// Suffix of the compressed output files
+static const std::string COMPRESSED_FILE_SUFFIX { ".gz" };
+
+/// Compress the output files (stdout and stderr) of completed jobs
+/// with gzip, in a separate thread.
+///
+/// A compressed file replaces the original one: it's first written
+/// to a temporary file which is renamed to '<file>.gz', then the
+/// original file is removed. Output files must be read with the
+/// static functions of this class, that decompress transparently.
+class OutputCompressor {
+  public:
+    explicit OutputCompressor(uint64_t min_size = COMPRESSION_MIN_SIZE);
+
+    /// The jobs that are still queued will not be compressed
+    ~OutputCompressor();
+
+    /// Queue the compression of the output files of the job stored
+    /// in the specified directory
+    void compress(const std::string& job_dir);
+
+    /// Compress the specified file, if not smaller than min_size.
+    /// The compressed file is synced before replacing the original
+    /// one, that is removed once the rename is synced.
+    /// Return true if the file was compressed, false otherwise.
+    /// Throw a std::exception in case of failure.
+    static bool compressFile(const std::string& file_path, uint64_t min_size);
+
+    /// Return true if the specified output file exists, either
+    /// compressed or not
+    static bool exists(const std::string& file_path);
+
+    /// Read the specified output file, decompressing it if it has
+    /// been compressed. Return false in case of failure.
+    static bool read(const std::string& file_path, std::string& content);
+
+    /// Compress the specified data with gzip.
+    /// Throw a std::exception in case of failure.
+    static std::string compressData(const std::string& content);
+
+    /// Decompress the specified gzip data.
+    /// Throw a std::exception in case of failure.
+    static std::string decompress(const std::string& compressed);
+
+  private:
+    uint64_t min_size_;
+    std::deque<std::string> job_dirs_;
+    bool stopping_;
+    PCPClient::Util::mutex mutex_;
+    PCPClient::Util::condition_variable cond_var_;
+    PCPClient::Util::thread worker_thread_;
+
+    void workerTask();
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_OUTPUT_COMPRESSOR_HPP_
@@ -9,6 +9,8 @@
 
 #include <pxp-agent/action_request.hpp>
 #include <pxp-agent/configuration.hpp>
+#include <pxp-agent/outbound_queue.hpp>
+#include <pxp-agent/spool_outbox.hpp>
 
 #include <cpp-pcp-client/connector/connector.hpp>
 
@@ -16,13 +18,37 @@
 
 #include <cassert>
 #include <memory>
+#include <stdexcept>
+#include <string>
 
 namespace PXPAgent {
 
 namespace lth_jc = leatherman::json_container;
 
+/// PXP responses and errors are queued and sent by the thread of an
+/// OutboundQueue, that retries them across reconnections; PCP errors
+/// are sent synchronously.
+///
+/// Non-blocking responses that cannot be delivered are stored in the
+/// spool outbox; they are queued again, in batches, once connected.
+///
+/// If response-batch-delay is set, the non-blocking and provisional
+/// responses to the same requester are coalesced into batch response
+/// messages (see PXPSchemas::BATCH_RESPONSE_TYPE).
+///
+/// The results of a response are compressed when larger than the
+/// result-compression-threshold, if the request accepts it (see
+/// PXPSchemas::GZIP_RESULTS_ENCODING). Non-blocking results larger
+/// than the result-fragment-size are sent in fragments (see
+/// PXPSchemas::RESULTS_FRAGMENT_TYPE).
 class PXPConnector : public PCPClient::Connector {
   public:
+    /// Thrown once the stream of fragmented results is aborted, after
+    /// sending a PXP error in place of the remaining fragments
+    struct StreamError : public std::runtime_error {
+        explicit StreamError(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
     PXPConnector(const Configuration::Agent& agent_configuration);
 
     TEST_VIRTUAL_SPECIFIER void sendPCPError(
@@ -36,15 +62,120 @@ class PXPConnector : public PCPClient::Connector {
 
     TEST_VIRTUAL_SPECIFIER void sendBlockingResponse(
                     const ActionRequest& request,
-                    const leatherman::json_container::JsonContainer& results);
+                    leatherman::json_container::JsonContainer&& results);
 
     TEST_VIRTUAL_SPECIFIER void sendNonBlockingResponse(
                     const ActionRequest& request,
-                    const leatherman::json_container::JsonContainer& results,
+                    leatherman::json_container::JsonContainer&& results,
+                    const std::string& job_id);
+
+    /// In case the results stored in the specified file are larger
+    /// than the result-fragment-size, stream them as a sequence of
+    /// fragments followed by a non-blocking response, and return
+    /// true. Return false otherwise, or if the first fragment can't
+    /// be read, before queuing anything, so that the results are sent
+    /// in full by sendNonBlockingResponse.
+    /// The fragments are not persistent: they are retried in their
+    /// position in the outbound queue, instead of being stored in the
+    /// outbox, so that they are delivered in order. In case a further
+    /// fragment can't be read, or the queue has no room for it in
+    /// time, the stream is aborted with a PXP error, in place of the
+    /// non-blocking response, and a StreamError is thrown.
+    TEST_VIRTUAL_SPECIFIER bool sendFragmentedNonBlockingResponse(
+                    const ActionRequest& request,
+                    const std::string& results_file,
                     const std::string& job_id);
 
+    /// Send a PXP error / non-blocking response to the specified
+    /// requester, without an ActionRequest at hand (e.g. for jobs
+    /// started by a previous pxp-agent run); the ActionRequest
+    /// overloads delegate to these. The results are compressed as
+    /// for the ActionRequest overloads if the accepted encoding is
+    /// gzip.
+    TEST_VIRTUAL_SPECIFIER void sendPXPError(
+                    const std::string& requester,
+                    const std::string& request_id,
+                    const std::string& transaction_id,
+                    const std::string& description);
+
+    TEST_VIRTUAL_SPECIFIER void sendNonBlockingResponse(
+                    const std::string& requester,
+                    const std::string& transaction_id,
+                    leatherman::json_container::JsonContainer&& results,
+                    const std::string& job_id,
+                    const std::string& accept_encoding = "",
+                    std::shared_ptr<const std::vector<lth_jc::JsonContainer>> debug
+                        = nullptr);
+
     TEST_VIRTUAL_SPECIFIER void sendProvisionalResponse(
                     const ActionRequest& request);
+
+    /// Block until the queued messages have been sent or the timeout
+    /// expires. Return true if all messages were sent.
+    bool flushOutbound(uint32_t timeout_ms);
+
+    size_t getNumQueuedMessages();
+
+    /// Number of messages dropped by the outbound queue
+    uint64_t getNumDroppedMessages();
+
+    /// Number of messages stored in the spool outbox
+    size_t getNumStoredMessages();
+
+    const Histogram& getSendLatency() const;
+
+  private:
+    /// Size [bytes] above which results are compressed; 0 means never
+    uint64_t compression_threshold_;
+
+    /// Size [bytes] of the fragments of the results; 0 means results
+    /// are never fragmented
+    uint64_t fragment_size_;
+
+    /// NB: declared before the queue, that stores the pending
+    /// messages when destroyed
+    SpoolOutbox outbox_;
+
+    OutboundQueue outbound_queue_;
+
+    /// Queue the message, waiting up to timeout_ms in case the queue
+    /// is full; a persistent message is then stored in the outbox.
+    /// Return false if the message was neither queued nor stored.
+    TEST_VIRTUAL_SPECIFIER bool enqueue(OutboundQueue::Message&& msg,
+                                        uint32_t timeout_ms = 0);
+
+    /// Send a PXP error in place of the remaining fragments of the
+    /// results, then throw a StreamError
+    [[noreturn]] void abortStream(const ActionRequest& request,
+                                  const std::string& request_description,
+                                  const std::string& reason);
+
+    /// Set the results entry of the response data, compressing the
+    /// results if the accepted encoding is gzip and it's worth it.
+    /// The results are moved into the response data. In case the
+    /// results were serialized to decide and were not compressed,
+    /// return the serialized response data, so that the results are
+    /// not serialized again; return an empty string otherwise.
+    std::string setResults(lth_jc::JsonContainer& response_data,
+                           lth_jc::JsonContainer&& results,
+                           const std::string& accept_encoding,
+                           const std::string& transaction_id) const;
+
+    /// Stamp the Sent event of the request and return the debug chunks
+    /// of a response to it: those of the request, if specified,
+    /// followed by its timeline, if the requester asked for it
+    std::shared_ptr<const std::vector<lth_jc::JsonContainer>> getResponseDebug(
+        const ActionRequest& request,
+        bool with_request_debug) const;
+
+    /// Send a message of the outbound queue; the outbox file of a
+    /// stored message is removed unless it may be delivered later
+    void sendQueued(const OutboundQueue::Message& msg);
+
+    bool storeUndelivered(const OutboundQueue::Message& msg);
+
+    /// Queue a batch of stored messages, if connected
+    void redeliverStored();
 };
 
 }  // namespace PXPAgent
@@ -8,6 +8,13 @@
 namespace PXPAgent {
 namespace PXPSchemas {
 
+// The encoding of the results a requester can accept, by specifying
+// it as the 'accept_encoding' entry of the request; results larger
+// than the configured threshold are then gzip compressed, base64
+// encoded and sent as 'encoded_results', instead of 'results', with
+// 'results_encoding' set accordingly
+static const std::string GZIP_RESULTS_ENCODING { "gzip" };
+
 // PXP blocking transaction
 static const std::string BLOCKING_REQUEST_TYPE  {
     "http://puppetlabs.com/rpc_blocking_request" };
@@ -27,11 +34,36 @@ PCPClient::Schema NonBlockingRequestSchema();
 PCPClient::Schema NonBlockingResponseSchema();
 PCPClient::Schema ProvisionalResponseSchema();
 
+// PXP requests with binary data, made of a header line, with the
+// same JSON content of the data of the above requests, and a blob
+// (i.e. "<header>\n<blob>"); the blob is passed as is to the module
+static const std::string BINARY_BLOCKING_REQUEST_TYPE {
+    "http://puppetlabs.com/rpc_binary_blocking_request" };
+static const std::string BINARY_NON_BLOCKING_REQUEST_TYPE {
+    "http://puppetlabs.com/rpc_binary_non_blocking_request" };
+PCPClient::Schema BinaryBlockingRequestSchema();
+PCPClient::Schema BinaryNonBlockingRequestSchema();
+
 // PXP error
 static const std::string PXP_ERROR_MSG_TYPE {
     "http://puppetlabs.com/rpc_error_message" };
 PCPClient::Schema PXPErrorSchema();
 
+// PXP batch of responses to the same requester; each entry of the
+// 'responses' array has the 'message_type' and 'data' of a response
+static const std::string BATCH_RESPONSE_TYPE {
+    "http://puppetlabs.com/rpc_batch_response" };
+PCPClient::Schema BatchResponseSchema();
+
+// PXP fragment of the results of a non-blocking action; the results
+// larger than the configured fragment size are sent as a sequence of
+// fragments, each with a base64 encoded slice of the serialized
+// results as 'data', followed by a non-blocking response that
+// specifies 'num_fragments' instead of 'results'
+static const std::string RESULTS_FRAGMENT_TYPE {
+    "http://puppetlabs.com/rpc_results_fragment" };
+PCPClient::Schema ResultsFragmentSchema();
+
 }  // namespace PXPSchemas
 }  // namespace PXPAgent
 
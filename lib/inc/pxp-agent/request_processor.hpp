@@ -2,19 +2,34 @@
 #define SRC_AGENT_REQUEST_PROCESSOR_HPP_
 
 #include <pxp-agent/module.hpp>
-#include <pxp-agent/thread_container.hpp>
+#include <pxp-agent/dispatch_table.hpp>
+#include <pxp-agent/agent_metrics.hpp>
+#include <pxp-agent/metrics_exporter.hpp>
+#include <pxp-agent/request_scheduler.hpp>
+#include <pxp-agent/spool_recovery.hpp>
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/job_index.hpp>
+#include <pxp-agent/metadata_writer.hpp>
+#include <pxp-agent/output_compressor.hpp>
+#include <pxp-agent/job_archive.hpp>
 #include <pxp-agent/action_request.hpp>
 #include <pxp-agent/pxp_connector.hpp>
 #include <pxp-agent/configuration.hpp>
 
+#include <cpp-pcp-client/util/thread.hpp>
+
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace PXPAgent {
 
+class ResultsStorage;
+
 class RequestProcessor {
   public:
     struct Error : public std::runtime_error {
@@ -26,28 +41,58 @@ class RequestProcessor {
     RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
                      const Configuration::Agent& agent_configuration);
 
+    ~RequestProcessor();
+
     /// Execute the specified action.
     ///
     /// In case of blocking action, once it's done, send back to the
     /// requester a blocking response containing the action results.
     /// Propagates possible request errors raised by the action logic.
-    /// In case it fails to send the response, no further attempt will
-    /// be made.
+    /// Responses are queued by the PXPConnector, that retries them
+    /// until they expire.
     ///
     /// In case of non-blocking action, start a task for the specified
-    /// action in a separate execution thread.
-    /// Once the task has started, send a provisional response to the
-    /// requester. In case the request has the notify_outcome field
-    /// flagged, the task will send a non-blocking response
+    /// action in a separate execution thread or, if the maximum number
+    /// of concurrent jobs is reached, queue it.
+    /// Once the metadata of the job has been written, and the job
+    /// recorded in the journal and scheduled, send a provisional
+    /// response to the requester; the metadata and the journal are
+    /// synced by separate threads, so this does not block on disk I/O. In case the request has the notify_outcome
+    /// field flagged, the task will send a non-blocking response
     /// containing the action outcome, after the action is done. The
     /// task will also write the action outcome and request metadata
     /// to disk.
+    ///
+    /// Requests exceeding the rate limit of their sender are rejected
+    /// with a PXP error before their content is validated.
     void processRequest(const RequestType& request_type,
                         const PCPClient::ParsedChunks& parsed_chunks);
 
+    /// Stop processing requests and starting jobs, then wait up to
+    /// the specified timeout for the running jobs to complete.
+    /// The queued jobs, that will never be started, are failed and
+    /// their requesters get a PXP error; the metadata of the jobs
+    /// that are still running after the timeout are flagged as
+    /// orphaned. The pending metadata updates are written and the
+    /// queued responses are given a chance to be sent before
+    /// returning.
+    void drain(uint32_t timeout_s);
+
+    /// Fail the jobs accepted by a previous pxp-agent run that were
+    /// never started, as recorded by the journal, then adopt the ones
+    /// that are still executing, so that their metadata will be
+    /// finalized and their requesters notified once they complete
+    /// (see SpoolRecovery). Meant to be called once connected.
+    void adoptJobs();
+
   private:
-    /// Manages the lifecycle of non-blocking action jobs
-    ThreadContainer thread_container_;
+    /// Whether or not the processor is draining; requests are then
+    /// rejected
+    std::atomic<bool> draining_;
+
+    /// Rate limits requesters and manages the lifecycle of
+    /// non-blocking action jobs
+    RequestScheduler scheduler_;
 
     /// PXP Connector pointer
     std::shared_ptr<PXPConnector> connector_ptr_;
@@ -56,23 +101,90 @@ class RequestProcessor {
     /// be created
     const std::string spool_dir_;
 
+    /// Writes the metadata files of jobs in groups; shared with the
+    /// status module, that reads the pending updates
+    std::shared_ptr<MetadataWriter> metadata_writer_ptr_;
+
+    /// Write-ahead journal of the accepted non-blocking requests;
+    /// shared with the job tasks
+    std::shared_ptr<JobJournal> journal_ptr_;
+
+    /// State of the jobs stored in the spool; shared with the job
+    /// tasks and the status module
+    std::shared_ptr<JobIndex> job_index_ptr_;
+
+    /// Scans the spool at startup and watches the jobs adopted from
+    /// a previous pxp-agent run
+    SpoolRecovery spool_recovery_;
+
+    /// Compresses the output files of completed jobs; shared with
+    /// the job tasks
+    std::shared_ptr<OutputCompressor> compressor_ptr_;
+
+    /// Archive of the results of finalized jobs; shared with the
+    /// status module
+    std::shared_ptr<JobArchive> archive_ptr_;
+
     /// Modules
     std::map<std::string, std::shared_ptr<Module>> modules_;
 
+    /// Handles of the actions of the modules, built once the modules
+    /// are loaded
+    DispatchTable dispatch_table_;
+
+    /// Aggregates the stats of the dispatch table and the gauges of
+    /// the processor; shared with the metrics module
+    std::shared_ptr<AgentMetrics> metrics_ptr_;
+
     /// Where the configuration files of modules are stored
     const std::string modules_config_dir_;
 
     /// Modules configuration
     std::map<std::string, lth_jc::JsonContainer> modules_config_;
 
+    /// Results storage of the jobs, by job ID; the storage object is
+    /// owned by the job task, so it expires once the task is done
+    std::map<std::string, std::weak_ptr<ResultsStorage>> jobs_;
+    PCPClient::Util::mutex jobs_mutex_;
+
+    /// Exports the metrics, if configured; declared last, so that
+    /// its thread is stopped before the metrics sources are destroyed
+    std::unique_ptr<MetricsExporter> metrics_exporter_ptr_;
+
+    /// Wait for the queued responses to be sent, for a short time
+    void flushOutbound();
+
+    /// Finalize the metadata of the queued jobs as failed, record them
+    /// in the journal, and send a PXP error to their requesters
+    void failQueuedJobs();
+
+    /// Store a reference to the results storage of the job, to be
+    /// able to flag it as orphaned when draining
+    void trackJob(const std::string& job_id,
+                  std::shared_ptr<ResultsStorage> results_storage);
+
+    /// Return the handle of the requested action.
     /// Throw a RequestProcessor::Error in case of unknown module,
     /// unknown action, or if the requested input parameters entry
     /// does not match the JSON schema defined for the relevant action
-    void validateRequestContent(const ActionRequest& request);
-
-    void processBlockingRequest(const ActionRequest& request);
-
-    void processNonBlockingRequest(const ActionRequest& request);
+    std::shared_ptr<DispatchTable::Handle> validateRequestContent(
+        const ActionRequest& request);
+
+    void processBlockingRequest(const ActionRequest& request,
+                                DispatchTable::Handle& handle);
+
+    /// The request and the action handle are shared with the job
+    /// task, so that they're never copied
+    void processNonBlockingRequest(std::shared_ptr<const ActionRequest> request_ptr,
+                                   std::shared_ptr<DispatchTable::Handle> handle_ptr);
+
+    /// Schedule the job of a request recorded in the journal, then
+    /// send the provisional response; executed by the journal's
+    /// writer thread
+    void startJob(std::shared_ptr<const ActionRequest> request_ptr,
+                  std::shared_ptr<DispatchTable::Handle> handle_ptr,
+                  const std::string& results_dir,
+                  std::shared_ptr<ResultsStorage> results_storage);
 
     /// Load the modules configuration files
     void loadModulesConfiguration();
@@ -0,0 +1,147 @@
+#ifndef SRC_AGENT_REQUEST_SCHEDULER_HPP_
+#define SRC_AGENT_REQUEST_SCHEDULER_HPP_
+
+#include <pxp-agent/thread_container.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+
+/// Token bucket used to limit the rate of the requests of a single
+/// requester. The bucket holds up to 'burst' tokens and is refilled
+/// at 'rate' tokens per second; each admitted request consumes one.
+class TokenBucket {
+  public:
+    using clock = PCPClient::Util::chrono::steady_clock;
+
+    TokenBucket(double rate, double burst);
+
+    /// Refill the bucket and try to consume a token.
+    /// Return true if a token was consumed, false otherwise.
+    bool tryConsume(clock::time_point now = clock::now());
+
+    /// Return true if the bucket would be full at the given time;
+    /// such a bucket does not need to be stored.
+    bool isFull(clock::time_point now = clock::now()) const;
+
+  private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    clock::time_point last_refill_;
+
+    double tokensAt(clock::time_point now) const;
+};
+
+/// Admit and schedule the requests processed by pxp-agent.
+///
+/// In case a rate limit is set, each requester (PCP sender) is
+/// given a TokenBucket; requests exceeding the rate are not admitted.
+///
+/// Jobs (non-blocking actions) are executed in separate threads
+/// managed by a ThreadContainer. In case a maximum number of
+/// concurrent jobs is set, the jobs that cannot be started are
+/// queued per requester; when a job completes, its execution thread
+/// picks the next job by cycling over the requesters in round-robin
+/// order, so that a requester with many pending jobs cannot starve
+/// the others. In case a maximum number of queued jobs is set, jobs
+/// beyond it are rejected.
+///
+/// The token buckets are evicted in least recently used order, once
+/// their number reaches a fixed limit, so that the requesters seen
+/// over time do not accumulate.
+class RequestScheduler {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    using Task = std::function<void()>;
+
+    /// A max_concurrent_jobs value of 0 means no limit; a rate_limit
+    /// value of 0 (requests per second) disables rate limiting; a
+    /// max_queued_jobs value of 0 means no limit.
+    RequestScheduler(uint32_t max_concurrent_jobs = 0,
+                     double rate_limit = 0.0,
+                     uint32_t rate_burst = 1,
+                     uint32_t max_queued_jobs = 0);
+
+    /// Return true if the request of the specified sender can be
+    /// processed, false if it exceeds the sender's rate limit.
+    bool admit(const std::string& sender);
+
+    /// Execute the specified task in a separate thread, if the
+    /// number of running jobs allows that, otherwise append it to
+    /// the sender's queue.
+    /// Return true if the task was started, false if it was queued.
+    /// Throw a RequestScheduler::Error in case the scheduler is
+    /// draining or the queue is full; throw in case it fails to
+    /// spawn the execution thread.
+    bool schedule(const std::string& sender, Task task);
+
+    /// Return true if a task scheduled now could be neither started
+    /// nor queued, as the max number of queued jobs was reached.
+    bool isFull();
+
+    /// Stop accepting and dequeuing jobs, then wait up to the
+    /// specified timeout for the running ones to complete.
+    /// The queued jobs are not executed.
+    /// Return true if all running jobs completed, false otherwise.
+    bool drain(uint32_t timeout_ms);
+
+    bool isDraining();
+
+    uint32_t getNumRunningJobs();
+    uint32_t getNumQueuedJobs();
+
+    /// Number of worker threads still executing, and started so far
+    uint32_t getNumRunningThreads();
+    uint32_t getNumStartedThreads();
+
+  private:
+    uint32_t max_concurrent_jobs_;
+    double rate_limit_;
+    uint32_t rate_burst_;
+    uint32_t max_queued_jobs_;
+
+    /// The token bucket of each sender, with the position of the
+    /// sender in buckets_lru_
+    std::map<std::string,
+             std::pair<TokenBucket, std::list<std::string>::iterator>> buckets_;
+
+    /// Senders with a bucket, from the least to the most recently used
+    std::list<std::string> buckets_lru_;
+    std::map<std::string, std::deque<Task>> queues_;
+    std::deque<std::string> senders_round_robin_;
+    uint32_t num_running_jobs_;
+    uint32_t num_queued_jobs_;
+    bool draining_;
+    PCPClient::Util::mutex mutex_;
+
+    // NB: declared last so that it's destroyed first
+    ThreadContainer thread_container_;
+
+    /// Execute the task and then the queued ones, until no job is
+    /// left or the scheduler flags the end of the worker
+    void workerTask(Task task, std::shared_ptr<std::atomic<bool>> done);
+
+    /// Pop the next task from the queues, in round-robin order over
+    /// senders. Must be called with the lock held.
+    /// Return false if no task is queued or if draining.
+    bool popNextTask(Task& task);
+
+    /// Must be called with the lock held
+    bool isFullUnlocked() const;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_REQUEST_SCHEDULER_HPP_
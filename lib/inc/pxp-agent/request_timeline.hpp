@@ -0,0 +1,76 @@
+#ifndef SRC_AGENT_REQUEST_TIMELINE_HPP_
+#define SRC_AGENT_REQUEST_TIMELINE_HPP_
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+/// Timestamps of the processing phases of a request, from which the
+/// phase latencies of its action are recorded; they are also reported
+/// to the requesters that ask for them, so that the latency of a
+/// request can be broken down end to end.
+///
+/// Events are timed with a monotonic clock, relative to the receipt
+/// of the request; they can be stamped concurrently by the threads
+/// that process the request.
+class RequestTimeline {
+  public:
+    enum class Event {
+        Received,
+        Validated,
+        Scheduled,          // non-blocking requests only
+        Dequeued,           // non-blocking requests only
+        Started,            // the execution of the action
+        Spawned,            // external modules only
+        Exited,             // external modules only
+        OutputValidated,
+        Sent                // the response was queued
+    };
+    static const size_t NUM_EVENTS { 9 };
+
+    static const std::string& eventName(Event event);
+
+    /// Stamp the Received event
+    RequestTimeline();
+
+    /// Stamp the event; a later stamp of the same event (e.g. Sent,
+    /// for the provisional and the final response) overrides it
+    void stamp(Event event);
+
+    /// Return the time elapsed from the receipt to the event [us];
+    /// -1 if the event was not stamped
+    int64_t elapsedMicroseconds(Event event) const;
+
+    /// Return the time elapsed between the two events [us]; -1 if
+    /// either was not stamped, or if the last stamp of the second
+    /// precedes the one of the first
+    int64_t elapsedMicroseconds(Event from, Event to) const;
+
+    /// Return a debug chunk for a response, with a "hops" entry for
+    /// each stamped event, in the PCP hops format: the "server" is
+    /// "pxp-agent", the "stage" is the event name, and the "time" is
+    /// derived from the wall clock time of the receipt. Each entry
+    /// also reports the monotonic "elapsed_ms" since the receipt.
+    lth_jc::JsonContainer getDebugChunk() const;
+
+  private:
+    PCPClient::Util::chrono::steady_clock::time_point received_;
+    boost::posix_time::ptime received_time_;
+    std::array<std::atomic<int64_t>, NUM_EVENTS> elapsed_us_;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_REQUEST_TIMELINE_HPP_
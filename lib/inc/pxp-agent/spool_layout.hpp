@@ -0,0 +1,44 @@
+#ifndef SRC_AGENT_SPOOL_LAYOUT_HPP_
+#define SRC_AGENT_SPOOL_LAYOUT_HPP_
+
+#include <string>
+#include <vector>
+
+// The results directory of a job is stored in a shard subdirectory
+// of the spool, named after the last byte of the CRC32 checksum of
+// the job ID (transaction ID), in hexadecimal digits:
+//
+//      <spool_dir>/<shard>/<job_id>
+//
+// Jobs stored by previous versions, directly in the spool directory
+// (legacy layout), are still found and can be migrated.
+
+namespace PXPAgent {
+namespace SpoolLayout {
+
+/// Return the name of the shard of the specified job
+std::string getShard(const std::string& job_id);
+
+/// Return the path of the results directory of the specified job
+std::string getJobDir(const std::string& spool_dir, const std::string& job_id);
+
+/// Return the path of the results directory of the specified job,
+/// considering the legacy layout in case the job is not sharded
+std::string findJobDir(const std::string& spool_dir, const std::string& job_id);
+
+/// Return the paths of the results directories of all jobs, in
+/// both layouts; jobs of the legacy layout without metadata file
+/// are not considered
+std::vector<std::string> listJobDirs(const std::string& spool_dir);
+
+/// Move the completed jobs stored with the legacy layout to their
+/// shard; incomplete jobs are left in place, as their processes may
+/// be still writing there. Once no job is left, a marker file is
+/// stored in the spool, so that further calls do not scan it.
+/// Return the number of migrated jobs.
+unsigned int migrate(const std::string& spool_dir);
+
+}  // namespace SpoolLayout
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_SPOOL_LAYOUT_HPP_
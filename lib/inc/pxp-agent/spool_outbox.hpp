@@ -0,0 +1,73 @@
+#ifndef SRC_AGENT_SPOOL_OUTBOX_HPP_
+#define SRC_AGENT_SPOOL_OUTBOX_HPP_
+
+#include <pxp-agent/outbound_queue.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+// Number of stored messages retrieved at once
+static const size_t OUTBOX_BATCH_SIZE { 64 };
+
+/// Outbox of the messages that could not be delivered, stored in the
+/// 'outbox' subdirectory of the spool, one file per message, so that
+/// they survive broker outages and pxp-agent restarts.
+///
+/// Files are named after a sequence number, so that messages are
+/// retrieved in the order they were stored; the directory is created
+/// when the first message is stored.
+///
+/// A retrieved message keeps its file until it is removed, once
+/// delivered, so that it is not lost if pxp-agent stops in the
+/// meantime (it may then be delivered twice). If it can't be
+/// delivered, storing it again puts it back in its original position.
+class SpoolOutbox {
+  public:
+    struct Error : public std::runtime_error {
+        explicit Error(std::string const& msg) : std::runtime_error(msg) {}
+    };
+
+    /// List the stored messages; a failure is logged.
+    explicit SpoolOutbox(const std::string& spool_dir);
+
+    /// Store the message (its debug chunks are not stored); a message
+    /// retrieved from the outbox is only made available again.
+    /// Throw a SpoolOutbox::Error in case of failure.
+    void store(const OutboundQueue::Message& msg);
+
+    /// Retrieve up to max_messages messages, the least recently
+    /// stored first, setting their outbox_sequence_number; their files
+    /// are kept until removed. Invalid files are logged and removed.
+    std::vector<OutboundQueue::Message> take(size_t max_messages = OUTBOX_BATCH_SIZE);
+
+    /// Remove the file of a retrieved message, once delivered
+    void remove(uint64_t sequence_number);
+
+    /// Number of stored messages, including the retrieved ones that
+    /// have not been removed yet
+    size_t size();
+
+  private:
+    std::string outbox_dir_;
+
+    /// Sequence numbers of the stored messages not retrieved yet
+    std::set<uint64_t> sequence_numbers_;
+
+    /// Sequence numbers of the retrieved messages
+    std::set<uint64_t> taken_sequence_numbers_;
+
+    uint64_t next_sequence_number_;
+    PCPClient::Util::mutex mutex_;
+
+    std::string getFilePath(uint64_t sequence_number) const;
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_SPOOL_OUTBOX_HPP_
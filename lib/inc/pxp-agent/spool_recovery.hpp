@@ -0,0 +1,133 @@
+#ifndef SRC_AGENT_SPOOL_RECOVERY_HPP_
+#define SRC_AGENT_SPOOL_RECOVERY_HPP_
+
+#include <pxp-agent/thread_container.hpp>
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/job_index.hpp>
+#include <pxp-agent/pxp_connector.hpp>
+#include <pxp-agent/util/process.hpp>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace PXPAgent {
+
+// Interval between checks of the stop flag while waiting for an
+// adopted job to complete
+static const uint32_t ADOPTED_JOB_WAIT_INTERVAL_MS { 1000 };  // [ms]
+
+// Maximum number of threads that scan the spool directory
+static const uint32_t SPOOL_SCAN_MAX_THREADS { 8 };
+
+/// Adopt the jobs (non-blocking actions) started by a previous
+/// pxp-agent run that did not complete before it stopped.
+///
+/// At startup, the spool directory is scanned by multiple threads
+/// that classify every job; the jobs in progress are added to the
+/// JobIndex, if any, until finalized. Jobs whose metadata does not
+/// report their completion are adopted: a job whose process is still
+/// executing is watched by a separate thread; once it terminates, the
+/// exit code stored in the 'exitcode' file of the job is used to
+/// finalize its metadata and, if requested, the action outcome is
+/// sent to the requester in a non-blocking response. Jobs whose
+/// process terminated while pxp-agent was not running are finalized
+/// when adopted. Jobs without an exit code file are flagged as
+/// interrupted by the scan: their metadata is finalized with the
+/// 'interrupted' entry, as their outcome cannot be determined.
+///
+/// On Windows, the exit code of jobs is not stored, so the running
+/// jobs are not adopted; the status module checks their process.
+///
+/// Jobs that were accepted but never started, as reported by the
+/// JobJournal, can be failed deterministically with failJob().
+class SpoolRecovery {
+  public:
+    struct ScanReport {
+        unsigned int num_jobs;
+        unsigned int num_completed;
+        unsigned int num_running;
+        unsigned int num_exited;
+        unsigned int num_interrupted;
+        unsigned int num_invalid;
+        int duration_ms;
+    };
+
+    SpoolRecovery(const std::string& spool_dir,
+                  std::shared_ptr<PXPConnector> connector_ptr,
+                  std::shared_ptr<JobIndex> index_ptr = nullptr);
+
+    ~SpoolRecovery();
+
+    /// Classify the jobs stored in the spool directory, flag the
+    /// interrupted ones and index the ones in progress; the jobs with
+    /// the specified IDs are ignored. Nothing is sent to the requesters.
+    ScanReport scan(const std::set<std::string>& ignored_job_ids = {});
+
+    /// Adopt the incomplete jobs found by the last scan; scan the
+    /// spool directory first, if not done yet.
+    /// Return the number of jobs being watched.
+    unsigned int adoptJobs();
+
+    /// Flag as failed the job that was accepted by a previous run but
+    /// never started, for the specified reason, and notify the
+    /// requester with a PXP error.
+    void failJob(const JobJournal::Entry& job, const std::string& reason);
+
+    /// Number of adopted jobs still being watched
+    unsigned int getNumWatchedJobs();
+
+  private:
+    std::string spool_dir_;
+    std::shared_ptr<PXPConnector> connector_ptr_;
+    std::shared_ptr<JobIndex> index_ptr_;
+    bool scanned_;
+
+    /// Results directories and PIDs of the jobs still executing
+    std::vector<std::pair<std::string, int>> running_jobs_;
+
+    /// Results directories of the jobs that completed while
+    /// pxp-agent was not running
+    std::vector<std::string> exited_jobs_;
+
+    std::atomic<bool> stopping_;
+
+    // NB: declared last so that it's destroyed first
+    ThreadContainer thread_container_;
+
+    enum class JobClass { Completed, Running, Exited, Interrupted, Invalid };
+
+    /// Classify the job, setting its PID if running; flag it as
+    /// interrupted if neither running nor exited. The job is
+    /// considered running only if its PID and the start time of its
+    /// process match one of the specified processes.
+    JobClass classifyJob(const std::string& job_dir,
+                         const Util::ProcessSnapshot& processes,
+                         int& pid);
+
+    /// Finalize the metadata of the job as interrupted
+    void flagInterrupted(const std::string& job_dir);
+
+    /// Add the job in progress to / remove the finalized job from
+    /// the index, if any
+    void indexJob(const std::string& job_dir);
+    void unindexJob(const std::string& job_dir);
+
+    /// Wait for the process to terminate, then finalize the job;
+    /// return immediately if the SpoolRecovery is being destroyed
+    void watchJob(std::string job_dir,
+                  int pid,
+                  std::shared_ptr<std::atomic<bool>> done);
+
+    /// Finalize the metadata of the job with the exit code stored on
+    /// file and notify the requester, if requested.
+    /// Return false if the exit code is not available.
+    bool finalizeJob(const std::string& job_dir);
+};
+
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_SPOOL_RECOVERY_HPP_
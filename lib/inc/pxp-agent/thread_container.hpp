@@ -15,6 +15,9 @@ static const uint32_t THREADS_MONITORING_INTERVAL_MS { 500 };  // [ms]
 // Number of stored threads above which we start the monitoring task
 static const uint32_t THREADS_THRESHOLD { 10 };
 
+// Interval between checks when waiting for the threads to complete
+static const uint32_t THREADS_WAIT_INTERVAL_MS { 50 };  // [ms]
+
 struct ManagedThread {
     /// Thread object
     PCPClient::Util::thread the_instance;
@@ -32,8 +35,9 @@ struct ManagedThread {
 ///
 /// The purpose of this class is to manage the lifecycle of threads;
 /// in case one or more stored threads are executing by the time
-/// the ThreadContainer destructor is called, the std::terminate
-/// function will be invoked; the program will then immediately abort.
+/// the ThreadContainer destructor is called, they will be detached
+/// and left running; it's up to the caller to ensure that such
+/// threads do not access any destroyed object (see waitForAll).
 class ThreadContainer {
   public:
     uint32_t check_interval;  // [ms]
@@ -53,9 +57,17 @@ class ThreadContainer {
     /// false otherwise
     bool isMonitoring();
 
+    /// Wait up to the specified timeout for all the stored threads
+    /// to complete their execution.
+    /// Return true if all threads completed, false otherwise.
+    bool waitForAll(uint32_t timeout_ms);
+
     uint32_t getNumAddedThreads();
     uint32_t getNumErasedThreads();
 
+    /// Number of stored threads that have not completed yet
+    uint32_t getNumRunningThreads();
+
     void setName(const std::string& name);
 
   private:
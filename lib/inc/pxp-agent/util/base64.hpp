@@ -0,0 +1,19 @@
+#ifndef SRC_AGENT_UTIL_BASE64_HPP_
+#define SRC_AGENT_UTIL_BASE64_HPP_
+
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Encode the specified bytes in base64 (RFC 4648), with padding.
+std::string base64Encode(const std::string& data);
+
+/// Decode the specified base64 text.
+/// Throw a std::invalid_argument in case the text is not valid base64.
+std::string base64Decode(const std::string& txt);
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_BASE64_HPP_
@@ -14,6 +14,15 @@ void daemonize();
 void daemon_cleanup();
 #else
 std::unique_ptr<PIDFile> daemonize();
+
+/// Set the handlers of the termination signals (SIGINT, SIGTERM,
+/// and SIGQUIT); the caught signals can then be retrieved with
+/// waitForTerminationSignal().
+void setTerminationSignalHandlers();
+
+/// Block until a termination signal is caught; return its number.
+/// setTerminationSignalHandlers() must be called beforehand.
+int waitForTerminationSignal();
 #endif
 
 }  // namespace Util
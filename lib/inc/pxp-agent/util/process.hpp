@@ -1,12 +1,53 @@
 #ifndef SRC_UTIL_PROCESS_HPP_
 #define SRC_UTIL_PROCESS_HPP_
 
+#include <stdint.h>
+
+#include <map>
+
 namespace PXPAgent {
 namespace Util {
 
 bool processExists(int pid);
+
+/// Return true if the process with the given PID is executing and
+/// its start time matches the specified one, so that recycled PIDs
+/// are not mistaken for the original process; zombie processes are
+/// not considered as executing. A start time of 0 means unknown; in
+/// that case, only the PID is checked.
+bool processExists(int pid, uint64_t start_time);
+
+/// Return the start time of the process with the given PID, in an
+/// opaque, platform specific unit (clock ticks since boot on Linux,
+/// as reported by /proc/<pid>/stat), or 0 if it can't be determined.
+uint64_t getProcessStartTime(int pid);
+
 int getPid();
 
+/// Wait up to the specified timeout for the process with the given
+/// PID to terminate; the process doesn't have to be a child.
+/// Return true if the process is not executing, false otherwise.
+bool waitForProcessExit(int pid, uint32_t timeout_ms);
+
+/// Snapshot of the PIDs and start times of the processes executing
+/// when instantiated. Allows checking the liveness of many processes
+/// with a single scan of the process table (/proc, on Linux), where
+/// the stat file of each process is read once; on other platforms,
+/// each process is checked individually.
+class ProcessSnapshot {
+  public:
+    ProcessSnapshot();
+
+    /// Same as Util::processExists(), considering only the processes
+    /// that were executing when the snapshot was taken
+    bool processExists(int pid, uint64_t start_time) const;
+
+  private:
+    bool scanned_;
+    // Start times by PID; zombie processes are not included
+    std::map<int, uint64_t> start_times_;
+};
+
 }  // namespace Util
 }  // namespace PXPAgent
 
@@ -0,0 +1,22 @@
+#ifndef SRC_AGENT_UTIL_SYNC_FILE_HPP_
+#define SRC_AGENT_UTIL_SYNC_FILE_HPP_
+
+#include <cstdio>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+/// Flush the stream buffer and commit the file content to disk.
+/// Return true in case of success, false otherwise.
+bool syncFile(std::FILE* file);
+
+/// Commit the entries of the specified directory (e.g. a file renamed
+/// into it) to disk; a no-op on Windows.
+/// Return true in case of success, false otherwise.
+bool syncDirectory(const std::string& dir_path);
+
+}  // namespace Util
+}  // namespace PXPAgent
+
+#endif  // SRC_AGENT_UTIL_SYNC_FILE_HPP_
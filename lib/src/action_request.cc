@@ -1,17 +1,29 @@
 #include <pxp-agent/action_request.hpp>
+#include <pxp-agent/pxp_schemas.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>
+
+#include <leatherman/util/strings.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.action_request"
 #include <leatherman/logging/logging.hpp>
 
 #include <cassert>
+#include <utility>  // move
 
 namespace PXPAgent {
 
+namespace lth_util = leatherman::util;
+
 ActionRequest::ActionRequest(RequestType type,
                              const PCPClient::ParsedChunks& parsed_chunks)
         : type_ { type },
           notify_outcome_ { true },
+          accept_encoding_ { "" },
           parsed_chunks_ { parsed_chunks },
+          debug_ { nullptr },
+          timing_ { false },
+          timeline_ { std::make_shared<RequestTimeline>() },
           params_ { "{}" },
           params_txt_ { "" } {
     init();
@@ -21,12 +33,27 @@ ActionRequest::ActionRequest(RequestType type,
                              PCPClient::ParsedChunks&& parsed_chunks)
         : type_ { type },
           notify_outcome_ { true },
-          parsed_chunks_ { parsed_chunks },
+          accept_encoding_ { "" },
+          parsed_chunks_ { std::move(parsed_chunks) },
+          debug_ { nullptr },
+          timing_ { false },
+          timeline_ { std::make_shared<RequestTimeline>() },
           params_ { "{}" },
           params_txt_ { "" } {
     init();
 }
 
+std::string describeParsedChunks(const PCPClient::ParsedChunks& parsed_chunks) {
+    if (parsed_chunks.data_type != PCPClient::ContentType::Binary) {
+        return parsed_chunks.toString();
+    }
+
+    // NB: the raw bytes of binary data are not logged
+    return "ENVELOPE: " + parsed_chunks.envelope.toString()
+           + "\nDATA: " + std::to_string(parsed_chunks.binary_data.size())
+           + " bytes of binary data";
+}
+
 const RequestType& ActionRequest::type() const { return type_; }
 const std::string& ActionRequest::id() const { return id_; }
 const std::string& ActionRequest::sender() const{ return sender_; }
@@ -34,11 +61,27 @@ const std::string& ActionRequest::transactionId() const { return transaction_id_
 const std::string& ActionRequest::module() const { return module_; }
 const std::string& ActionRequest::action() const { return action_; }
 const bool& ActionRequest::notifyOutcome() const { return notify_outcome_; }
+const std::string& ActionRequest::acceptEncoding() const { return accept_encoding_; }
 
 const PCPClient::ParsedChunks& ActionRequest::parsedChunks() const {
     return parsed_chunks_;
 }
 
+const std::shared_ptr<const std::vector<lth_jc::JsonContainer>>&
+ActionRequest::debug() const {
+    return debug_;
+}
+
+bool ActionRequest::timing() const { return timing_; }
+
+const RequestTimeline& ActionRequest::timeline() const {
+    return *timeline_;
+}
+
+void ActionRequest::stamp(RequestTimeline::Event event) const {
+    timeline_->stamp(event);
+}
+
 const lth_jc::JsonContainer& ActionRequest::params() const {
     if (params_.empty() && parsed_chunks_.data.includes("params")) {
         params_ = parsed_chunks_.data.get<lth_jc::JsonContainer>("params");
@@ -48,11 +91,22 @@ const lth_jc::JsonContainer& ActionRequest::params() const {
 
 const std::string& ActionRequest::paramsTxt() const {
     if (params_txt_.empty()) {
-        params_txt_ = params().toString();
+        // NB: serialize the entry in place, without copying it
+        params_txt_ = parsed_chunks_.data.includes("params")
+                      ? parsed_chunks_.data.toString("params")
+                      : params().toString();
     }
     return params_txt_;
 }
 
+bool ActionRequest::hasBlob() const {
+    return parsed_chunks_.data_type == PCPClient::ContentType::Binary;
+}
+
+const std::string& ActionRequest::blob() const {
+    return parsed_chunks_.binary_data;
+}
+
 // Private interface
 
 void ActionRequest::init() {
@@ -60,10 +114,21 @@ void ActionRequest::init() {
     sender_ = parsed_chunks_.envelope.get<std::string>("sender");
 
     LOG_DEBUG("Validating %1% request %2% by %3%:\n%4%",
-              requestTypeNames[type_], id_, sender_, parsed_chunks_.toString());
+              requestTypeNames[type_], id_, sender_,
+              describeParsedChunks(parsed_chunks_));
 
     validateFormat();
 
+    if (parsed_chunks_.num_invalid_debug) {
+        LOG_WARNING("Message %1% contained %2% bad debug chunk%3%",
+                    id_, parsed_chunks_.num_invalid_debug,
+                    lth_util::plural(parsed_chunks_.num_invalid_debug));
+    }
+
+    debug_ = std::make_shared<const std::vector<lth_jc::JsonContainer>>(
+        std::move(parsed_chunks_.debug));
+    parsed_chunks_.debug.clear();
+
     transaction_id_ = parsed_chunks_.data.get<std::string>("transaction_id");
     module_ = parsed_chunks_.data.get<std::string>("module");
     action_ = parsed_chunks_.data.get<std::string>("action");
@@ -71,6 +136,14 @@ void ActionRequest::init() {
     if (type_ == RequestType::NonBlocking) {
         notify_outcome_ = parsed_chunks_.data.get<bool>("notify_outcome");
     }
+
+    if (parsed_chunks_.data.includes("accept_encoding")) {
+        accept_encoding_ = parsed_chunks_.data.get<std::string>("accept_encoding");
+    }
+
+    if (parsed_chunks_.data.includes("timing")) {
+        timing_ = parsed_chunks_.data.get<bool>("timing");
+    }
 }
 
 void ActionRequest::validateFormat() {
@@ -80,10 +153,45 @@ void ActionRequest::validateFormat() {
     if (parsed_chunks_.invalid_data) {
         throw ActionRequest::Error { "invalid data" };
     }
-    // NOTE(ale): currently, we don't support ContentType::Binary
-    if (parsed_chunks_.data_type != PCPClient::ContentType::Json) {
+    if (parsed_chunks_.data_type == PCPClient::ContentType::Binary) {
+        parseBinaryData();
+    } else if (parsed_chunks_.data_type != PCPClient::ContentType::Json) {
         throw ActionRequest::Error { "data is not in JSON format" };
     }
 }
 
+void ActionRequest::parseBinaryData() {
+    auto& binary_data = parsed_chunks_.binary_data;
+    auto header_end = binary_data.find('\n');
+
+    if (header_end == std::string::npos) {
+        throw ActionRequest::Error { "binary data without header" };
+    }
+
+    try {
+        parsed_chunks_.data = lth_jc::JsonContainer { binary_data.substr(0, header_end) };
+    } catch (lth_jc::data_error& e) {
+        throw ActionRequest::Error { "invalid binary data header" };
+    }
+
+    // NB: the PCP client validates JSON data only
+    PCPClient::Validator validator {};
+    auto schema_name = (type_ == RequestType::Blocking
+                        ? PXPSchemas::BLOCKING_REQUEST_TYPE
+                        : PXPSchemas::NON_BLOCKING_REQUEST_TYPE);
+    validator.registerSchema(type_ == RequestType::Blocking
+                             ? PXPSchemas::BlockingRequestSchema()
+                             : PXPSchemas::NonBlockingRequestSchema());
+
+    try {
+        validator.validate(parsed_chunks_.data, schema_name);
+    } catch (PCPClient::validation_error& e) {
+        throw ActionRequest::Error { std::string { "invalid binary data header: " }
+                                     + e.what() };
+    }
+
+    // NB: remove the header in place, without copying the blob again
+    binary_data.erase(0, header_end + 1);
+}
+
 }  // namespace PXPAgent
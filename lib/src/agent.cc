@@ -1,19 +1,34 @@
 #include <pxp-agent/agent.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
 
+#include <cpp-pcp-client/connector/errors.hpp>
 #include <cpp-pcp-client/protocol/schemas.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.agent"
 #include <leatherman/logging/logging.hpp>
 
+#include <algorithm>  // min
 #include <vector>
 
 namespace PXPAgent {
 
+namespace pcp_util = PCPClient::Util;
+
+// Interval between checks of the connection to the PCP broker
+static const uint32_t CONNECTION_CHECK_S { 15 };
+
+// Initial delay between the attempts to connect to the PCP broker;
+// it doubles after each failure, up to CONNECTION_CHECK_S
+static const uint32_t CONNECTION_BACKOFF_S { 1 };
+
 Agent::Agent(const Configuration::Agent& agent_configuration)
         try
             : connector_ptr_ { new PXPConnector(agent_configuration) },
-              request_processor_ { connector_ptr_, agent_configuration } {
+              request_processor_ { connector_ptr_, agent_configuration },
+              stopping_ { false },
+              stop_mutex_ {},
+              stop_cond_var_ {} {
 } catch (const PCPClient::connection_config_error& e) {
     throw Agent::WebSocketConfigurationError { e.what() };
 }
@@ -33,33 +48,85 @@ void Agent::start() {
             nonBlockingRequestCallback(parsed_chunks);
         });
 
+    connector_ptr_->registerMessageCallback(
+        PXPSchemas::BinaryBlockingRequestSchema(),
+        [this](const PCPClient::ParsedChunks& parsed_chunks) {
+            blockingRequestCallback(parsed_chunks);
+        });
+
+    connector_ptr_->registerMessageCallback(
+        PXPSchemas::BinaryNonBlockingRequestSchema(),
+        [this](const PCPClient::ParsedChunks& parsed_chunks) {
+            nonBlockingRequestCallback(parsed_chunks);
+        });
+
     connector_ptr_->registerMessageCallback(
         PCPClient::Protocol::TTLExpiredSchema(),
         [this](const PCPClient::ParsedChunks& parsed_chunks) {
             ttlExpiredCallback(parsed_chunks);
         });
 
-    try {
-        connector_ptr_->connect();
-    } catch (const PCPClient::connection_config_error& e) {
-        // Failed to configure WebSocket on our end
-        throw Agent::WebSocketConfigurationError { e.what() };
-    } catch (const PCPClient::connection_fatal_error& e) {
-        // Unexpected, as we didn't set max num retries
-        throw Agent::FatalError { e.what() };
+    if (!connectUntilStopped()) {
+        return;
     }
 
-    // The agent is now connected and the request handlers are set;
-    // we can now call the monitoring method that will block this
-    // thread of execution.
-    // Note that, in case the underlying connection drops, the
-    // connector will keep trying to re-establish it indefinitely
-    // (the max_connect_attempts is 0 by default).
-    try {
-        connector_ptr_->monitorConnection();
-    } catch (const PCPClient::connection_fatal_error& e) {
-        // Unexpected, as we didn't set max num retries
-        throw Agent::FatalError { e.what() };
+    // Take over the jobs that outlived a previous run, now that we
+    // can notify their requesters
+    request_processor_.adoptJobs();
+
+    // NB: the connection is monitored here, rather than by
+    // Connector::monitorConnection(), that returns only once the
+    // connector is destroyed, so that stop() can end this loop
+    while (!waitForStop(CONNECTION_CHECK_S)) {
+        if (!connector_ptr_->isConnected()) {
+            LOG_WARNING("The connection to the PCP broker was lost; "
+                        "reconnecting");
+
+            if (!connectUntilStopped()) {
+                return;
+            }
+        }
+    }
+}
+
+void Agent::stop() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { stop_mutex_ };
+    stopping_ = true;
+    stop_cond_var_.notify_all();
+}
+
+void Agent::drain(uint32_t timeout_s) {
+    request_processor_.drain(timeout_s);
+}
+
+bool Agent::waitForStop(uint32_t timeout_s) {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { stop_mutex_ };
+    stop_cond_var_.wait_for(the_lock, pcp_util::chrono::seconds(timeout_s),
+                            [this]() { return stopping_; });
+    return stopping_;
+}
+
+bool Agent::connectUntilStopped() {
+    auto backoff_s = CONNECTION_BACKOFF_S;
+
+    while (true) {
+        try {
+            // NB: a single attempt, so that stop() is not delayed
+            connector_ptr_->connect(1);
+            return true;
+        } catch (const PCPClient::connection_config_error& e) {
+            // Failed to configure WebSocket on our end
+            throw Agent::WebSocketConfigurationError { e.what() };
+        } catch (const PCPClient::connection_error& e) {
+            LOG_WARNING("Failed to connect to the PCP broker (%1%); will "
+                        "retry in %2% s", e.what(), backoff_s);
+        }
+
+        if (waitForStop(backoff_s)) {
+            return false;
+        }
+
+        backoff_s = std::min(backoff_s * 2, CONNECTION_CHECK_S);
     }
 }
 
@@ -0,0 +1,247 @@
+#include <pxp-agent/agent_metrics.hpp>
+
+#include <iomanip>  // setprecision
+#include <sstream>
+#include <vector>
+
+namespace PXPAgent {
+
+static double toMilliseconds(uint64_t duration_us) {
+    return static_cast<double>(duration_us) / 1000.0;
+}
+
+// Return the largest duration held by the specified bucket; the
+// durations are whole microseconds, so the exclusive upper bound of
+// the histogram is one past the inclusive one reported as le
+static uint64_t inclusiveBoundOf(size_t bucket) {
+    return Histogram::upperBoundOf(bucket) - 1;
+}
+
+static lth_jc::JsonContainer getLatencyReport(const Histogram& histogram) {
+    auto snapshot = histogram.snapshot();
+    lth_jc::JsonContainer report {};
+    report.set<int>("count", static_cast<int>(snapshot.count));
+    report.set<double>("sum_ms", toMilliseconds(snapshot.sum_us));
+    report.set<double>("max_ms", toMilliseconds(snapshot.max_us));
+    report.set<double>("p50_ms", toMilliseconds(snapshot.quantile(0.5)));
+    report.set<double>("p90_ms", toMilliseconds(snapshot.quantile(0.9)));
+    report.set<double>("p99_ms", toMilliseconds(snapshot.quantile(0.99)));
+
+    std::vector<lth_jc::JsonContainer> buckets {};
+
+    for (size_t bucket = 0; bucket < snapshot.counts.size(); bucket++) {
+        if (snapshot.counts[bucket] == 0) {
+            continue;
+        }
+
+        lth_jc::JsonContainer bucket_report {};
+        bucket_report.set<double>("le_ms",
+                                  toMilliseconds(inclusiveBoundOf(bucket)));
+        bucket_report.set<int>("count", static_cast<int>(snapshot.counts[bucket]));
+        buckets.push_back(std::move(bucket_report));
+    }
+
+    report.set<std::vector<lth_jc::JsonContainer>>("buckets", buckets);
+    return report;
+}
+
+static const std::string PROMETHEUS_PREFIX { "pxp_agent_" };
+
+static std::string escapeLabelValue(const std::string& value) {
+    std::string escaped {};
+
+    for (auto c : value) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+static double toSeconds(uint64_t duration_us) {
+    return static_cast<double>(duration_us) / 1000000.0;
+}
+
+static void writeMetadata(std::ostringstream& out,
+                          const std::string& metric,
+                          const std::string& type,
+                          const std::string& help) {
+    out << "# HELP " << metric << " " << help << "\n"
+        << "# TYPE " << metric << " " << type << "\n";
+}
+
+// Write the samples of a histogram; labels is either empty or a
+// comma separated list of label pairs
+static void writeHistogram(std::ostringstream& out,
+                           const std::string& metric,
+                           const std::string& labels,
+                           const Histogram& histogram) {
+    auto snapshot = histogram.snapshot();
+    auto separator = labels.empty() ? "" : ",";
+    uint64_t cumulative { 0 };
+
+    // NB: the exclusive upper bound of every fourth bucket is a power
+    // of 2; the last bucket also holds the durations above its bound
+    for (size_t bucket = 0; bucket < snapshot.counts.size() - 1; bucket++) {
+        cumulative += snapshot.counts[bucket];
+
+        if (bucket % 4 == 3) {
+            out << metric << "_bucket{" << labels << separator << "le=\""
+                << toSeconds(inclusiveBoundOf(bucket)) << "\"} "
+                << cumulative << "\n";
+        }
+    }
+
+    out << metric << "_bucket{" << labels << separator << "le=\"+Inf\"} "
+        << snapshot.count << "\n";
+
+    auto sample_labels = labels.empty() ? "" : "{" + labels + "}";
+    out << metric << "_sum" << sample_labels << " " << toSeconds(snapshot.sum_us)
+        << "\n"
+        << metric << "_count" << sample_labels << " " << snapshot.count << "\n";
+}
+
+AgentMetrics::AgentMetrics(const DispatchTable& dispatch_table)
+        : dispatch_table_ { dispatch_table },
+          gauges_ {},
+          counters_ {},
+          latencies_ {} {
+}
+
+void AgentMetrics::addGauge(const std::string& name, Gauge gauge) {
+    gauges_[name] = gauge;
+}
+
+void AgentMetrics::addCounter(const std::string& name, Gauge counter) {
+    counters_[name] = counter;
+}
+
+void AgentMetrics::addLatency(const std::string& name, const Histogram& histogram) {
+    latencies_[name] = &histogram;
+}
+
+lth_jc::JsonContainer AgentMetrics::getReport() const {
+    std::vector<lth_jc::JsonContainer> actions {};
+
+    for (const auto& handle : dispatch_table_.handles()) {
+        lth_jc::JsonContainer action {};
+        action.set<std::string>("module", handle->module_name);
+        action.set<std::string>("action", handle->action_name);
+        action.set<int>("requests", static_cast<int>(handle->stats.num_requests));
+        action.set<int>("failures", static_cast<int>(handle->stats.num_failures));
+
+        lth_jc::JsonContainer phases {};
+
+        for (size_t idx = 0; idx < DispatchTable::NUM_PHASES; idx++) {
+            auto phase = static_cast<DispatchTable::Phase>(idx);
+            phases.set<lth_jc::JsonContainer>(
+                DispatchTable::phaseName(phase),
+                getLatencyReport(handle->stats.latencies[idx]));
+        }
+
+        action.set<lth_jc::JsonContainer>("latencies", phases);
+        actions.push_back(std::move(action));
+    }
+
+    lth_jc::JsonContainer latencies {};
+
+    for (const auto& latency : latencies_) {
+        latencies.set<lth_jc::JsonContainer>(latency.first,
+                                             getLatencyReport(*latency.second));
+    }
+
+    lth_jc::JsonContainer counters {};
+
+    for (const auto& counter : counters_) {
+        counters.set<int>(counter.first, static_cast<int>(counter.second()));
+    }
+
+    lth_jc::JsonContainer gauges {};
+
+    for (const auto& gauge : gauges_) {
+        gauges.set<int>(gauge.first, static_cast<int>(gauge.second()));
+    }
+
+    lth_jc::JsonContainer report {};
+    report.set<std::vector<lth_jc::JsonContainer>>("actions", actions);
+    report.set<lth_jc::JsonContainer>("latencies", latencies);
+    report.set<lth_jc::JsonContainer>("counters", counters);
+    report.set<lth_jc::JsonContainer>("gauges", gauges);
+    return report;
+}
+
+std::string AgentMetrics::getPrometheusText() const {
+    std::ostringstream out {};
+    out << std::setprecision(9);
+    const auto& handles = dispatch_table_.handles();
+
+    auto labelsOf = [](const DispatchTable::Handle& handle) {
+        return "module=\"" + escapeLabelValue(handle.module_name)
+               + "\",action=\"" + escapeLabelValue(handle.action_name) + "\"";
+    };
+
+    auto requests_metric = PROMETHEUS_PREFIX + "requests_total";
+    writeMetadata(out, requests_metric, "counter",
+                  "Number of processed requests, by action");
+
+    for (const auto& handle : handles) {
+        out << requests_metric << "{" << labelsOf(*handle) << "} "
+            << handle->stats.num_requests << "\n";
+    }
+
+    auto failures_metric = PROMETHEUS_PREFIX + "request_failures_total";
+    writeMetadata(out, failures_metric, "counter",
+                  "Number of requests that failed to execute, by action");
+
+    for (const auto& handle : handles) {
+        out << failures_metric << "{" << labelsOf(*handle) << "} "
+            << handle->stats.num_failures << "\n";
+    }
+
+    auto phases_metric = PROMETHEUS_PREFIX + "phase_duration_seconds";
+    writeMetadata(out, phases_metric, "histogram",
+                  "Duration of the processing phases of requests, by action");
+
+    for (const auto& handle : handles) {
+        for (size_t idx = 0; idx < DispatchTable::NUM_PHASES; idx++) {
+            auto phase = static_cast<DispatchTable::Phase>(idx);
+            writeHistogram(out, phases_metric,
+                           labelsOf(*handle) + ",phase=\""
+                               + DispatchTable::phaseName(phase) + "\"",
+                           handle->stats.latencies[idx]);
+        }
+    }
+
+    for (const auto& latency : latencies_) {
+        auto metric = PROMETHEUS_PREFIX + latency.first + "_latency_seconds";
+        writeMetadata(out, metric, "histogram", "Latency of " + latency.first);
+        writeHistogram(out, metric, "", *latency.second);
+    }
+
+    for (const auto& counter : counters_) {
+        auto metric = PROMETHEUS_PREFIX + counter.first + "_total";
+        writeMetadata(out, metric, "counter", "Total " + counter.first);
+        out << metric << " " << counter.second() << "\n";
+    }
+
+    for (const auto& gauge : gauges_) {
+        auto metric = PROMETHEUS_PREFIX + gauge.first;
+        writeMetadata(out, metric, "gauge", "Current " + gauge.first);
+        out << metric << " " << gauge.second() << "\n";
+    }
+
+    return out.str();
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,736 @@
+#include <pxp-agent/compiled_schema.hpp>
+
+#include <algorithm>  // copy, find
+#include <cstring>    // strncmp
+#include <istream>
+#include <limits>
+
+namespace PXPAgent {
+
+static const std::vector<std::string> ANNOTATION_KEYWORDS {
+    "description", "title", "$schema", "id", "default" };
+
+// Max nesting level of the JSON text validated while being parsed
+static const size_t MAX_TEXT_DEPTH { 512 };
+
+// Size of the reads of JSON text validated from a stream
+static const size_t TEXT_BUFFER_SIZE { 64 * 1024 };
+
+static unsigned int typeBit(lth_jc::DataType type) {
+    switch (type) {
+        case lth_jc::DataType::Object:
+            return 1 << 0;
+        case lth_jc::DataType::Array:
+            return 1 << 1;
+        case lth_jc::DataType::String:
+            return 1 << 2;
+        case lth_jc::DataType::Int:
+            return 1 << 3;
+        case lth_jc::DataType::Double:
+            return 1 << 4;
+        case lth_jc::DataType::Bool:
+            return 1 << 5;
+        case lth_jc::DataType::Null:
+            return 1 << 6;
+    }
+
+    return 0;
+}
+
+static unsigned int typeBits(const std::string& type_name) {
+    if (type_name == "object") {
+        return typeBit(lth_jc::DataType::Object);
+    } else if (type_name == "array") {
+        return typeBit(lth_jc::DataType::Array);
+    } else if (type_name == "string") {
+        return typeBit(lth_jc::DataType::String);
+    } else if (type_name == "integer") {
+        return typeBit(lth_jc::DataType::Int);
+    } else if (type_name == "number") {
+        return typeBit(lth_jc::DataType::Int) | typeBit(lth_jc::DataType::Double);
+    } else if (type_name == "boolean") {
+        return typeBit(lth_jc::DataType::Bool);
+    } else if (type_name == "null") {
+        return typeBit(lth_jc::DataType::Null);
+    }
+
+    throw CompiledSchema::Unsupported { "unknown type '" + type_name + "'" };
+}
+
+static std::string joinPath(const std::vector<lth_jc::JsonContainerKey>& path) {
+    std::string joined {};
+
+    for (const auto& key : path) {
+        joined += (joined.empty() ? "" : ".") + key;
+    }
+
+    return joined;
+}
+
+// Recursive descent parser of JSON text that applies the checks to
+// the values being scanned; only the keys of the objects that have
+// checks are decoded, and nothing else is stored. The text is either
+// held in memory or read from a stream, one buffer at a time.
+// NB: a schema violation does not stop the scan, so that invalid JSON
+// is always reported as such
+struct CompiledSchema::TextScanner {
+    const std::vector<Check>& checks;
+    std::istream* stream;
+    std::string buffer;
+
+    /// Number of bytes scanned before the beginning of the buffer
+    size_t offset;
+
+    const char* begin;
+    const char* pos;
+    const char* end;
+    std::string parse_error;
+    std::string schema_error;
+    std::string key;
+
+    TextScanner(const std::vector<Check>& checks_, const std::string& json_txt)
+            : checks { checks_ },
+              stream { nullptr },
+              buffer {},
+              offset { 0 },
+              begin { json_txt.data() },
+              pos { json_txt.data() },
+              end { json_txt.data() + json_txt.size() },
+              parse_error {},
+              schema_error {},
+              key {} {
+    }
+
+    TextScanner(const std::vector<Check>& checks_, std::istream& json_stream)
+            : checks { checks_ },
+              stream { &json_stream },
+              buffer {},
+              offset { 0 },
+              begin { nullptr },
+              pos { nullptr },
+              end { nullptr },
+              parse_error {},
+              schema_error {},
+              key {} {
+    }
+
+    // Return true if at least num_bytes are left to scan, reading
+    // further text from the stream, if any, when needed
+    bool available(size_t num_bytes) {
+        if (static_cast<size_t>(end - pos) >= num_bytes) {
+            return true;
+        }
+
+        if (stream == nullptr || !*stream) {
+            return false;
+        }
+
+        // NB: the bytes left are moved to the beginning of the buffer
+        std::string left { pos, end };
+        offset += static_cast<size_t>(pos - begin);
+        buffer.resize(left.size() + TEXT_BUFFER_SIZE);
+        std::copy(left.begin(), left.end(), buffer.begin());
+        stream->read(&buffer[left.size()],
+                     static_cast<std::streamsize>(TEXT_BUFFER_SIZE));
+        buffer.resize(left.size() + static_cast<size_t>(stream->gcount()));
+
+        begin = buffer.data();
+        pos = begin;
+        end = begin + buffer.size();
+        return static_cast<size_t>(end - pos) >= num_bytes;
+    }
+
+    bool fail(const std::string& msg) {
+        parse_error = msg + " at offset "
+                      + std::to_string(offset + static_cast<size_t>(pos - begin));
+        return false;
+    }
+
+    void violation(const std::string& msg) {
+        if (schema_error.empty()) {
+            schema_error = msg;
+        }
+    }
+
+    void checkType(lth_jc::DataType type, unsigned int types, const Check* check) {
+        if (types != 0 && !(typeBit(type) & types)) {
+            violation(check == nullptr
+                      ? "invalid type of the document"
+                      : "invalid type of property '" + joinPath(check->path) + "'");
+        }
+    }
+
+    void skipWhitespace() {
+        while (available(1) && (*pos == ' ' || *pos == '\n'
+                             || *pos == '\r' || *pos == '\t')) {
+            pos++;
+        }
+    }
+
+    bool scanLiteral(const char* literal, size_t size) {
+        if (!available(size) || std::strncmp(pos, literal, size) != 0) {
+            return fail("invalid value");
+        }
+
+        pos += size;
+        return true;
+    }
+
+    bool scanHex(unsigned int& code) {
+        if (!available(4)) {
+            return fail("invalid unicode escape");
+        }
+
+        code = 0;
+
+        for (auto idx = 0; idx < 4; idx++, pos++) {
+            auto c = *pos;
+            code <<= 4;
+
+            if (c >= '0' && c <= '9') {
+                code |= static_cast<unsigned int>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code |= static_cast<unsigned int>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code |= static_cast<unsigned int>(c - 'A' + 10);
+            } else {
+                return fail("invalid unicode escape");
+            }
+        }
+
+        return true;
+    }
+
+    static void appendUtf8(unsigned int code, std::string& out) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    // Scan the string starting at the current quote; decode it into
+    // 'out', unless null
+    bool scanString(std::string* out) {
+        pos++;
+
+        while (available(1)) {
+            auto c = *pos++;
+
+            if (c == '"') {
+                return true;
+            }
+
+            if (static_cast<unsigned char>(c) < 0x20) {
+                pos--;
+                return fail("invalid character in string");
+            }
+
+            if (c != '\\') {
+                if (out != nullptr) {
+                    *out += c;
+                }
+                continue;
+            }
+
+            if (!available(1)) {
+                break;
+            }
+
+            switch (c = *pos++) {
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'n':
+                    c = '\n';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'u': {
+                    unsigned int code;
+
+                    if (!scanHex(code)) {
+                        return false;
+                    }
+
+                    if (code >= 0xD800 && code <= 0xDBFF) {
+                        unsigned int low;
+
+                        if (!available(2) || pos[0] != '\\' || pos[1] != 'u') {
+                            return fail("invalid unicode surrogate");
+                        }
+
+                        pos += 2;
+
+                        if (!scanHex(low)) {
+                            return false;
+                        }
+
+                        if (low < 0xDC00 || low > 0xDFFF) {
+                            return fail("invalid unicode surrogate");
+                        }
+
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    if (out != nullptr) {
+                        appendUtf8(code, *out);
+                    }
+                    continue;
+                }
+                default:
+                    pos--;
+                    return fail("invalid escape in string");
+            }
+
+            if (out != nullptr) {
+                *out += c;
+            }
+        }
+
+        return fail("unterminated string");
+    }
+
+    // NB: as for the parser used by JsonContainer, an integer that
+    // exceeds 64 bits is stored as a double
+    bool scanNumber(lth_jc::DataType& type) {
+        auto negative = (*pos == '-');
+        auto is_double = false;
+        uint64_t value { 0 };
+        uint64_t max_value { negative
+            ? static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + 1
+            : std::numeric_limits<uint64_t>::max() };
+
+        if (negative) {
+            pos++;
+        }
+
+        if (!available(1) || *pos < '0' || *pos > '9') {
+            return fail("invalid number");
+        }
+
+        if (*pos == '0') {
+            pos++;
+        } else {
+            while (available(1) && *pos >= '0' && *pos <= '9') {
+                auto digit = static_cast<uint64_t>(*pos++ - '0');
+
+                if (value > (max_value - digit) / 10) {
+                    is_double = true;
+                } else {
+                    value = value * 10 + digit;
+                }
+            }
+        }
+
+        if (available(1) && *pos == '.') {
+            is_double = true;
+            pos++;
+
+            if (!available(1) || *pos < '0' || *pos > '9') {
+                return fail("invalid number");
+            }
+
+            while (available(1) && *pos >= '0' && *pos <= '9') {
+                pos++;
+            }
+        }
+
+        if (available(1) && (*pos == 'e' || *pos == 'E')) {
+            is_double = true;
+            pos++;
+
+            if (available(1) && (*pos == '+' || *pos == '-')) {
+                pos++;
+            }
+
+            if (!available(1) || *pos < '0' || *pos > '9') {
+                return fail("invalid number");
+            }
+
+            while (available(1) && *pos >= '0' && *pos <= '9') {
+                pos++;
+            }
+        }
+
+        type = is_double ? lth_jc::DataType::Double : lth_jc::DataType::Int;
+        return true;
+    }
+
+    // Scan an object; the checks of its properties, if any, are in
+    // the [first, last) range
+    bool scanObject(size_t depth, size_t first, size_t last) {
+        // NB: the checks of the properties are siblings, each followed
+        // by the checks of its nested properties
+        std::vector<bool> found(last - first, false);
+
+        pos++;
+        skipWhitespace();
+
+        if (available(1) && *pos == '}') {
+            pos++;
+        } else {
+            while (true) {
+                if (!available(1) || *pos != '"') {
+                    return fail("missing object key");
+                }
+
+                key.clear();
+
+                if (!scanString(first < last ? &key : nullptr)) {
+                    return false;
+                }
+
+                skipWhitespace();
+
+                if (!available(1) || *pos != ':') {
+                    return fail("missing colon after object key");
+                }
+
+                pos++;
+                skipWhitespace();
+                auto idx = first;
+
+                while (idx < last && checks[idx].path.back() != key) {
+                    idx += 1 + checks[idx].num_nested;
+                }
+
+                if (idx < last) {
+                    const auto& check = checks[idx];
+                    found[idx - first] = true;
+
+                    if (!scanValue(depth + 1, check.types, &check,
+                                   idx + 1, idx + 1 + check.num_nested)) {
+                        return false;
+                    }
+                } else if (!scanValue(depth + 1, 0, nullptr, 0, 0)) {
+                    return false;
+                }
+
+                skipWhitespace();
+
+                if (available(1) && *pos == ',') {
+                    pos++;
+                    skipWhitespace();
+                } else if (available(1) && *pos == '}') {
+                    pos++;
+                    break;
+                } else {
+                    return fail("missing comma or closing brace in object");
+                }
+            }
+        }
+
+        for (auto idx = first; idx < last; idx += 1 + checks[idx].num_nested) {
+            if (checks[idx].required && !found[idx - first]) {
+                violation("missing required property '"
+                          + joinPath(checks[idx].path) + "'");
+            }
+        }
+
+        return true;
+    }
+
+    bool scanArray(size_t depth) {
+        pos++;
+        skipWhitespace();
+
+        if (available(1) && *pos == ']') {
+            pos++;
+            return true;
+        }
+
+        while (true) {
+            if (!scanValue(depth + 1, 0, nullptr, 0, 0)) {
+                return false;
+            }
+
+            skipWhitespace();
+
+            if (available(1) && *pos == ',') {
+                pos++;
+                skipWhitespace();
+            } else if (available(1) && *pos == ']') {
+                pos++;
+                return true;
+            } else {
+                return fail("missing comma or closing bracket in array");
+            }
+        }
+    }
+
+    // Scan a value, checking its type; if it's an object, the checks
+    // of its properties are in the [first, last) range
+    bool scanValue(size_t depth, unsigned int types, const Check* check,
+                   size_t first, size_t last) {
+        if (depth > MAX_TEXT_DEPTH) {
+            return fail("too many nesting levels");
+        }
+
+        if (!available(1)) {
+            return fail("missing value");
+        }
+
+        switch (*pos) {
+            case '{':
+                checkType(lth_jc::DataType::Object, types, check);
+                return scanObject(depth, first, last);
+            case '[':
+                checkType(lth_jc::DataType::Array, types, check);
+                return scanArray(depth);
+            case '"':
+                checkType(lth_jc::DataType::String, types, check);
+                return scanString(nullptr);
+            case 't':
+                checkType(lth_jc::DataType::Bool, types, check);
+                return scanLiteral("true", 4);
+            case 'f':
+                checkType(lth_jc::DataType::Bool, types, check);
+                return scanLiteral("false", 5);
+            case 'n':
+                checkType(lth_jc::DataType::Null, types, check);
+                return scanLiteral("null", 4);
+            default: {
+                lth_jc::DataType type;
+
+                if (*pos != '-' && (*pos < '0' || *pos > '9')) {
+                    return fail("invalid value");
+                }
+
+                if (!scanNumber(type)) {
+                    return false;
+                }
+
+                checkType(type, types, check);
+                return true;
+            }
+        }
+    }
+};
+
+CompiledSchema::CompiledSchema()
+        : root_types_ { typeBit(lth_jc::DataType::Object) },
+          checks_ {} {
+}
+
+CompiledSchema::CompiledSchema(const lth_jc::JsonContainer& schema)
+        : root_types_ { 0 },
+          checks_ {} {
+    try {
+        root_types_ = compileTypes(schema);
+        compileObject(schema, {});
+    } catch (const lth_jc::data_error& e) {
+        throw Unsupported { std::string("invalid schema: ") + e.what() };
+    }
+}
+
+void CompiledSchema::addConstraint(const std::string& property,
+                                   PCPClient::TypeConstraint type,
+                                   bool required) {
+    unsigned int types { 0 };
+
+    switch (type) {
+        case PCPClient::TypeConstraint::Object:
+            types = typeBit(lth_jc::DataType::Object);
+            break;
+        case PCPClient::TypeConstraint::Array:
+            types = typeBit(lth_jc::DataType::Array);
+            break;
+        case PCPClient::TypeConstraint::String:
+            types = typeBit(lth_jc::DataType::String);
+            break;
+        case PCPClient::TypeConstraint::Int:
+            types = typeBit(lth_jc::DataType::Int);
+            break;
+        case PCPClient::TypeConstraint::Bool:
+            types = typeBit(lth_jc::DataType::Bool);
+            break;
+        case PCPClient::TypeConstraint::Double:
+            types = typeBit(lth_jc::DataType::Double);
+            break;
+        case PCPClient::TypeConstraint::Null:
+            types = typeBit(lth_jc::DataType::Null);
+            break;
+        default:
+            // Any
+            break;
+    }
+
+    checks_.push_back(Check { { property }, types, required, 0 });
+}
+
+bool CompiledSchema::validate(const lth_jc::JsonContainer& data,
+                              std::string& error) const {
+    auto root_type = data.type();
+
+    if (root_types_ != 0 && !(typeBit(root_type) & root_types_)) {
+        error = "invalid type of the document";
+        return false;
+    }
+
+    if (root_type != lth_jc::DataType::Object) {
+        // NB: properties apply only to objects
+        return true;
+    }
+
+    size_t idx { 0 };
+
+    while (idx < checks_.size()) {
+        const auto& check = checks_[idx];
+
+        if (!data.includes(check.path)) {
+            if (check.required) {
+                error = "missing required property '" + joinPath(check.path) + "'";
+                return false;
+            }
+
+            idx += 1 + check.num_nested;
+            continue;
+        }
+
+        auto type = data.type(check.path);
+
+        if (check.types != 0 && !(typeBit(type) & check.types)) {
+            error = "invalid type of property '" + joinPath(check.path) + "'";
+            return false;
+        }
+
+        idx += (type == lth_jc::DataType::Object ? 1 : 1 + check.num_nested);
+    }
+
+    return true;
+}
+
+bool CompiledSchema::validate(const std::string& json_txt,
+                              std::string& error,
+                              bool& parse_error) const {
+    TextScanner scanner { checks_, json_txt };
+    return validate(scanner, error, parse_error);
+}
+
+bool CompiledSchema::validate(std::istream& json_stream,
+                              std::string& error,
+                              bool& parse_error) const {
+    TextScanner scanner { checks_, json_stream };
+    return validate(scanner, error, parse_error);
+}
+
+//
+// Private interface
+//
+
+bool CompiledSchema::validate(TextScanner& scanner,
+                              std::string& error,
+                              bool& parse_error) const {
+    scanner.skipWhitespace();
+
+    if (!scanner.available(1)) {
+        scanner.fail("empty document");
+    } else if (scanner.scanValue(0, root_types_, nullptr, 0, checks_.size())) {
+        scanner.skipWhitespace();
+
+        if (scanner.available(1)) {
+            scanner.fail("unexpected content after the document");
+        }
+    }
+
+    if (scanner.stream != nullptr && scanner.stream->bad()) {
+        scanner.parse_error = "failed to read the document";
+    }
+
+    parse_error = !scanner.parse_error.empty();
+    error = parse_error ? scanner.parse_error : scanner.schema_error;
+    return error.empty();
+}
+
+void CompiledSchema::compileObject(const lth_jc::JsonContainer& schema,
+                                   const std::vector<lth_jc::JsonContainerKey>& path) {
+    std::vector<std::string> required {};
+    std::vector<std::string> properties {};
+
+    for (const auto& keyword : schema.keys()) {
+        if (keyword == "required") {
+            required = schema.get<std::vector<std::string>>("required");
+        } else if (keyword == "properties") {
+            properties = schema.get<lth_jc::JsonContainer>("properties").keys();
+        } else if (keyword == "additionalProperties") {
+            // NB: 'true' is the default behaviour
+            if (schema.type(keyword) != lth_jc::DataType::Bool
+                    || !schema.get<bool>(keyword)) {
+                throw Unsupported { "unsupported keyword 'additionalProperties'" };
+            }
+        } else if (keyword != "type"
+                   && std::find(ANNOTATION_KEYWORDS.begin(),
+                                ANNOTATION_KEYWORDS.end(),
+                                keyword) == ANNOTATION_KEYWORDS.end()) {
+            throw Unsupported { "unsupported keyword '" + keyword + "'" };
+        }
+    }
+
+    for (const auto& property : properties) {
+        auto property_schema = schema.get<lth_jc::JsonContainer>(
+            std::vector<lth_jc::JsonContainerKey> { "properties", property });
+        auto property_path = path;
+        property_path.push_back(property);
+        auto is_required = std::find(required.begin(), required.end(), property)
+                           != required.end();
+        auto idx = checks_.size();
+
+        checks_.push_back(Check { property_path,
+                                  compileTypes(property_schema),
+                                  is_required,
+                                  0 });
+        compileObject(property_schema, property_path);
+        checks_[idx].num_nested = checks_.size() - idx - 1;
+    }
+
+    for (const auto& property : required) {
+        if (std::find(properties.begin(), properties.end(), property)
+                == properties.end()) {
+            auto property_path = path;
+            property_path.push_back(property);
+            checks_.push_back(Check { property_path, 0, true, 0 });
+        }
+    }
+}
+
+unsigned int CompiledSchema::compileTypes(const lth_jc::JsonContainer& schema) {
+    if (!schema.includes("type")) {
+        return 0;
+    }
+
+    if (schema.type("type") == lth_jc::DataType::String) {
+        return typeBits(schema.get<std::string>("type"));
+    }
+
+    unsigned int types { 0 };
+
+    for (const auto& type_name : schema.get<std::vector<std::string>>("type")) {
+        types |= typeBits(type_name);
+    }
+
+    return types;
+}
+
+}  // namespace PXPAgent
@@ -94,6 +94,10 @@ static const std::string DEFAULT_CONFIG_FILE {
 
 static const std::string AGENT_CLIENT_TYPE { "agent" };
 
+// Upper bound of response-batch-delay; responses must not be held back
+// for long
+static const int MAX_RESPONSE_BATCH_DELAY_MS { 1000 };
+
 //
 // Public interface
 //
@@ -266,7 +270,23 @@ const Configuration::Agent& Configuration::getAgentConfiguration() const {
         HW::GetFlag<std::string>("ssl-key"),
         HW::GetFlag<std::string>("spool-dir"),
         HW::GetFlag<std::string>("modules-config-dir"),
-        AGENT_CLIENT_TYPE };
+        AGENT_CLIENT_TYPE,
+        HW::GetFlag<int>("max-concurrent-jobs"),
+        HW::GetFlag<int>("max-queued-jobs"),
+        HW::GetFlag<double>("sender-rate-limit"),
+        HW::GetFlag<int>("sender-rate-burst"),
+        HW::GetFlag<int>("metadata-flush-delay"),
+        HW::GetFlag<int>("spool-archive-after"),
+        HW::GetFlag<int>("spool-archive-retention"),
+        HW::GetFlag<int>("outbound-queue-size"),
+        HW::GetFlag<int>("outbound-message-ttl"),
+        HW::GetFlag<int>("response-batch-delay"),
+        HW::GetFlag<int>("response-batch-size"),
+        HW::GetFlag<int>("result-compression-threshold"),
+        HW::GetFlag<int>("result-fragment-size"),
+        HW::GetFlag<std::string>("metrics-textfile"),
+        HW::GetFlag<int>("metrics-interval"),
+        HW::GetFlag<std::string>("metrics-socket") };
     return agent_configuration_;
 }
 
@@ -400,6 +420,186 @@ void Configuration::defineDefaultValues() {
                     Types::String,
                     DEFAULT_SPOOL_DIR) } });
 
+    defaults_.insert(
+        Option { "max-concurrent-jobs",
+                 Base_ptr { new Entry<int>(
+                    "max-concurrent-jobs",
+                    "",
+                    "Maximum number of non-blocking actions executing at "
+                    "once; further jobs are queued and served fairly among "
+                    "requesters. Defaults to 0 (no limit)",
+                    Types::Integer,
+                    0) } });
+
+    defaults_.insert(
+        Option { "max-queued-jobs",
+                 Base_ptr { new Entry<int>(
+                    "max-queued-jobs",
+                    "",
+                    "Maximum number of non-blocking actions waiting for "
+                    "max-concurrent-jobs; further requests are rejected. "
+                    "Defaults to 1000 (0 means no limit)",
+                    Types::Integer,
+                    1000) } });
+
+    defaults_.insert(
+        Option { "sender-rate-limit",
+                 Base_ptr { new Entry<double>(
+                    "sender-rate-limit",
+                    "",
+                    "Maximum number of requests per second accepted from a "
+                    "single requester. Defaults to 0 (no limit)",
+                    Types::Double,
+                    0.0) } });
+
+    defaults_.insert(
+        Option { "sender-rate-burst",
+                 Base_ptr { new Entry<int>(
+                    "sender-rate-burst",
+                    "",
+                    "Number of requests a single requester can send in a "
+                    "burst when sender-rate-limit is set. Defaults to 10",
+                    Types::Integer,
+                    10) } });
+
+    defaults_.insert(
+        Option { "metadata-flush-delay",
+                 Base_ptr { new Entry<int>(
+                    "metadata-flush-delay",
+                    "",
+                    "Maximum number of milliseconds the metadata updates of "
+                    "non-blocking actions can be delayed to be written in "
+                    "groups. Defaults to 10",
+                    Types::Integer,
+                    10) } });
+
+    defaults_.insert(
+        Option { "spool-archive-after",
+                 Base_ptr { new Entry<int>(
+                    "spool-archive-after",
+                    "",
+                    "Number of minutes after which the results of completed "
+                    "non-blocking actions are packed into the spool archive. "
+                    "Defaults to 0 (disabled)",
+                    Types::Integer,
+                    0) } });
+
+    defaults_.insert(
+        Option { "spool-archive-retention",
+                 Base_ptr { new Entry<int>(
+                    "spool-archive-retention",
+                    "",
+                    "Number of days after which the spool archive segments "
+                    "are removed. Defaults to 0 (kept forever)",
+                    Types::Integer,
+                    0) } });
+
+    defaults_.insert(
+        Option { "outbound-queue-size",
+                 Base_ptr { new Entry<int>(
+                    "outbound-queue-size",
+                    "",
+                    "Maximum size, in MiB, of the responses waiting to be "
+                    "sent to the broker. Defaults to 64; 0 means no limit",
+                    Types::Integer,
+                    64) } });
+
+    defaults_.insert(
+        Option { "outbound-message-ttl",
+                 Base_ptr { new Entry<int>(
+                    "outbound-message-ttl",
+                    "",
+                    "Number of seconds after which a response that could not "
+                    "be sent to the broker is dropped. Defaults to 900; 0 "
+                    "means responses never expire",
+                    Types::Integer,
+                    900) } });
+
+    defaults_.insert(
+        Option { "response-batch-delay",
+                 Base_ptr { new Entry<int>(
+                    "response-batch-delay",
+                    "",
+                    "Number of milliseconds a non-blocking or provisional "
+                    "response waits for further responses to the same "
+                    "requester, to be sent as a single batch; at most 1000. "
+                    "Defaults to 0 (no batching)",
+                    Types::Integer,
+                    0) } });
+
+    defaults_.insert(
+        Option { "response-batch-size",
+                 Base_ptr { new Entry<int>(
+                    "response-batch-size",
+                    "",
+                    "Maximum number of responses in a batch, when "
+                    "response-batch-delay is set. Defaults to 50",
+                    Types::Integer,
+                    50) } });
+
+    defaults_.insert(
+        Option { "result-compression-threshold",
+                 Base_ptr { new Entry<int>(
+                    "result-compression-threshold",
+                    "",
+                    "Size, in KiB, above which the results are compressed, "
+                    "for requests that accept it. Defaults to 64; 0 disables "
+                    "compression",
+                    Types::Integer,
+                    64) } });
+
+    defaults_.insert(
+        Option { "result-fragment-size",
+                 Base_ptr { new Entry<int>(
+                    "result-fragment-size",
+                    "",
+                    "Size, in KiB, of the fragments the results of "
+                    "non-blocking actions larger than it are sent in. "
+                    "Defaults to 0 (results are never fragmented)",
+                    Types::Integer,
+                    0) } });
+
+    defaults_.insert(
+        Option { "metrics-textfile",
+                 Base_ptr { new Entry<std::string>(
+                    "metrics-textfile",
+                    "",
+                    "File the metrics are periodically written to, in the "
+                    "Prometheus text format. Defaults to none",
+                    Types::String,
+                    "") } });
+
+    defaults_.insert(
+        Option { "metrics-interval",
+                 Base_ptr { new Entry<int>(
+                    "metrics-interval",
+                    "",
+                    "Number of seconds between writes of the metrics "
+                    "textfile. Defaults to 60",
+                    Types::Integer,
+                    60) } });
+
+    defaults_.insert(
+        Option { "metrics-socket",
+                 Base_ptr { new Entry<std::string>(
+                    "metrics-socket",
+                    "",
+                    "Unix domain socket the metrics are served on, in the "
+                    "Prometheus text format. Defaults to none",
+                    Types::String,
+                    "") } });
+
+    defaults_.insert(
+        Option { "drain-timeout",
+                 Base_ptr { new Entry<int>(
+                    "drain-timeout",
+                    "",
+                    "When stopping, number of seconds to wait for the running "
+                    "non-blocking actions to complete before flagging them as "
+                    "orphaned. Defaults to 3",
+                    Types::Integer,
+                    3) } });
+
     defaults_.insert(
         Option { "foreground",
                  Base_ptr { new Entry<bool>(
@@ -651,6 +851,88 @@ void Configuration::validateAndNormalizeConfiguration() {
         HW::SetFlag<std::string>("spool-dir", spool_dir_path.string());
     }
 
+    if (HW::GetFlag<int>("max-concurrent-jobs") < 0) {
+        throw Configuration::Error { "max-concurrent-jobs must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("max-queued-jobs") < 0) {
+        throw Configuration::Error { "max-queued-jobs must not be negative" };
+    }
+
+    if (HW::GetFlag<double>("sender-rate-limit") < 0) {
+        throw Configuration::Error { "sender-rate-limit must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("sender-rate-burst") < 1) {
+        throw Configuration::Error { "sender-rate-burst must be positive" };
+    }
+
+    if (HW::GetFlag<int>("metadata-flush-delay") < 0) {
+        throw Configuration::Error { "metadata-flush-delay must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("spool-archive-after") < 0) {
+        throw Configuration::Error { "spool-archive-after must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("spool-archive-retention") < 0) {
+        throw Configuration::Error { "spool-archive-retention must not be "
+                                     "negative" };
+    }
+
+    if (HW::GetFlag<int>("outbound-queue-size") < 0) {
+        throw Configuration::Error { "outbound-queue-size must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("outbound-message-ttl") < 0) {
+        throw Configuration::Error { "outbound-message-ttl must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("response-batch-delay") < 0) {
+        throw Configuration::Error { "response-batch-delay must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("response-batch-delay") > MAX_RESPONSE_BATCH_DELAY_MS) {
+        throw Configuration::Error {
+            "response-batch-delay must not exceed "
+            + std::to_string(MAX_RESPONSE_BATCH_DELAY_MS) + " ms" };
+    }
+
+    if (HW::GetFlag<int>("response-batch-size") < 1) {
+        throw Configuration::Error { "response-batch-size must be positive" };
+    }
+
+    if (HW::GetFlag<int>("result-compression-threshold") < 0) {
+        throw Configuration::Error {
+            "result-compression-threshold must not be negative" };
+    }
+
+    if (HW::GetFlag<int>("result-fragment-size") < 0) {
+        throw Configuration::Error { "result-fragment-size must not be negative" };
+    }
+
+    if (!HW::GetFlag<std::string>("metrics-textfile").empty()) {
+        HW::SetFlag<std::string>("metrics-textfile", lth_file::tilde_expand(
+            HW::GetFlag<std::string>("metrics-textfile")));
+    }
+
+    if (HW::GetFlag<int>("metrics-interval") < 1) {
+        throw Configuration::Error { "metrics-interval must be positive" };
+    }
+
+    if (!HW::GetFlag<std::string>("metrics-socket").empty()) {
+#ifdef _WIN32
+        throw Configuration::Error { "metrics-socket is not supported on Windows" };
+#else
+        HW::SetFlag<std::string>("metrics-socket", lth_file::tilde_expand(
+            HW::GetFlag<std::string>("metrics-socket")));
+#endif
+    }
+
+    if (HW::GetFlag<int>("drain-timeout") < 0) {
+        throw Configuration::Error { "drain-timeout must not be negative" };
+    }
+
 #ifndef _WIN32
     if (!HW::GetFlag<bool>("foreground")) {
         auto pid_file = lth_file::tilde_expand(HW::GetFlag<std::string>("pidfile"));
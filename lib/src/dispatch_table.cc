@@ -0,0 +1,138 @@
+#include <pxp-agent/dispatch_table.hpp>
+
+#include <array>
+#include <functional>  // hash
+
+namespace PXPAgent {
+
+const size_t DispatchTable::NUM_PHASES;
+
+static const std::array<std::string, DispatchTable::NUM_PHASES> PHASE_NAMES {
+    { "validation", "queue_wait", "spawn", "execution", "send" } };
+
+const std::string& DispatchTable::phaseName(Phase phase) {
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+//
+// Handle
+//
+
+DispatchTable::Handle::Handle(std::shared_ptr<Module> module_ptr_,
+                              const std::string& action_name_)
+        : module_ptr { module_ptr_ },
+          module_name { module_ptr_->module_name },
+          action_name { action_name_ },
+          blocking_only { module_ptr_->type() == Module::Type::Internal },
+          input_schema { nullptr },
+          stats {} {
+    auto schema_it = module_ptr->compiled_input_schemas_.find(action_name);
+
+    if (schema_it != module_ptr->compiled_input_schemas_.end()) {
+        input_schema = &schema_it->second;
+    }
+}
+
+void DispatchTable::Handle::validateInput(const lth_jc::JsonContainer& params) const {
+    Module::validateWith(input_schema, module_ptr->input_validator_, params,
+                         action_name);
+}
+
+void DispatchTable::Handle::recordRequest(bool succeeded, uint64_t duration_ms) {
+    stats.num_requests++;
+    stats.total_duration_ms += duration_ms;
+
+    if (!succeeded) {
+        stats.num_failures++;
+    }
+}
+
+void DispatchTable::Handle::recordPhase(Phase phase, uint64_t duration_us) {
+    stats.latencies[static_cast<size_t>(phase)].record(duration_us);
+}
+
+//
+// DispatchTable
+//
+
+DispatchTable::DispatchTable()
+        : handles_ {},
+          slots_ {},
+          mask_ { 0 } {
+}
+
+DispatchTable::DispatchTable(
+        const std::map<std::string, std::shared_ptr<Module>>& modules)
+        : handles_ {},
+          slots_ {},
+          mask_ { 0 } {
+    for (const auto& module : modules) {
+        for (const auto& action_name : module.second->actions) {
+            handles_.push_back(std::make_shared<Handle>(module.second,
+                                                        action_name));
+        }
+    }
+
+    size_t num_slots { 1 };
+
+    while (num_slots < 2 * handles_.size()) {
+        num_slots <<= 1;
+    }
+
+    slots_.resize(num_slots);
+    mask_ = num_slots - 1;
+
+    for (const auto& handle : handles_) {
+        auto hash = hashOf(handle->module_name, handle->action_name);
+        auto idx = hash & mask_;
+
+        // NB: a module lists each action once, so there's no need to
+        // check for duplicates
+        while (slots_[idx].handle) {
+            idx = (idx + 1) & mask_;
+        }
+
+        slots_[idx] = Slot { hash, handle };
+    }
+}
+
+std::shared_ptr<DispatchTable::Handle> DispatchTable::find(
+        const std::string& module_name,
+        const std::string& action_name) const {
+    if (slots_.empty()) {
+        return nullptr;
+    }
+
+    auto hash = hashOf(module_name, action_name);
+
+    // NB: the table is never full, so an empty slot ends the probing
+    for (auto idx = hash & mask_; slots_[idx].handle; idx = (idx + 1) & mask_) {
+        const auto& slot = slots_[idx];
+
+        if (slot.hash == hash
+                && slot.handle->action_name == action_name
+                && slot.handle->module_name == module_name) {
+            return slot.handle;
+        }
+    }
+
+    return nullptr;
+}
+
+const std::vector<std::shared_ptr<DispatchTable::Handle>>&
+DispatchTable::handles() const {
+    return handles_;
+}
+
+//
+// Private interface
+//
+
+size_t DispatchTable::hashOf(const std::string& module_name,
+                             const std::string& action_name) {
+    std::hash<std::string> hasher {};
+    auto hash = hasher(module_name);
+    return hash ^ (hasher(action_name) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+}  // namespace PXPAgent
@@ -1,4 +1,7 @@
 #include <pxp-agent/external_module.hpp>
+#include <pxp-agent/spool_layout.hpp>
+#include <pxp-agent/output_compressor.hpp>
+#include <pxp-agent/util/process.hpp>
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.external_module"
 #include <leatherman/logging/logging.hpp>
@@ -11,6 +14,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include <atomic>
+#include <fstream>
 #include <memory>  // shared_ptr
 
 // TODO(ale): disable assert() once we're confident with the code...
@@ -27,11 +31,85 @@ static const std::string ACTION_SCHEMA_NAME { "action_metadata" };
 static const std::string METADATA_CONFIGURATION_ENTRY { "configuration" };
 static const std::string METADATA_ACTIONS_ENTRY { "actions" };
 
+// Frame of the module input; see getRequestInput()
+static const std::string INPUT_PARAMS_PREFIX { "{\"params\":" };
+static const std::string INPUT_CONFIG_PREFIX { ",\"config\":" };
+static const std::string INPUT_SUFFIX { "}" };
+
+#ifndef _WIN32
+// Shell command used to execute non-blocking actions; the positional
+// parameters are the module path, the action and the exit code file
+static const std::string NON_BLOCKING_WRAPPER {
+    "\"$0\" \"$1\"; rc=$?; echo $rc > \"$2\"; exit $rc" };
+#endif
+
 namespace fs = boost::filesystem;
 namespace HW = HorseWhisperer;
 namespace lth_exec = leatherman::execution;
 namespace lth_file = leatherman::file_util;
 
+// The JSON input of the request, for logging; the blob, if any, is
+// described by its size, rather than dumped
+static std::string describeInput(const ActionRequest& request,
+                                 const std::string& input_txt) {
+    if (!request.hasBlob()) {
+        return input_txt;
+    }
+
+    auto blob_size = request.blob().size();
+    return input_txt.substr(0, input_txt.size() - blob_size - 1)
+           + " (followed by a blob of " + std::to_string(blob_size) + " bytes)";
+}
+
+// Whether the results of the non-blocking request, stored in the
+// output file, will be sent in fragments (see result-fragment-size)
+static bool isFragmented(const ActionRequest& request,
+                         const std::string& out_file) {
+    // HERE(ale): using HW instead of Configuration to ease unit tests
+    auto fragment_size =
+        static_cast<uintmax_t>(HW::GetFlag<int>("result-fragment-size")) * 1024;
+
+    if (!request.notifyOutcome() || fragment_size == 0) {
+        return false;
+    }
+
+    boost::system::error_code ec;
+    auto size = fs::file_size(out_file, ec);
+    return !ec && size > fragment_size;
+}
+
+static void readErrorFile(const ActionRequest& request,
+                          const std::string& err_file,
+                          std::string& err_txt) {
+    // NB: the output files of completed jobs may be compressed
+    if (OutputCompressor::exists(err_file)) {
+        if (!OutputCompressor::read(err_file, err_txt)) {
+            LOG_ERROR("Failed to read error file '%1%' of '%2% %3%'; will "
+                      "continue processing the output",
+                      err_file, request.module(), request.action());
+        } else {
+            LOG_TRACE("Successfully read error file '%1%'", err_file);
+        }
+    }
+}
+
+static void throwInvalidOutput(const std::string& module_name,
+                               const std::string& action_name,
+                               bool parse_error,
+                               const std::string& error,
+                               const std::string& err_txt) {
+    LOG_ERROR("'%1% %2%' output is not %3%: %4%", module_name,
+              action_name, (parse_error ? "valid JSON" : "a valid result"),
+              error);
+    std::string err_msg { "'" + module_name + " " + action_name + "' "
+                          + (parse_error ? "returned invalid JSON"
+                                         : "returned an invalid result") };
+    if (!err_txt.empty()) {
+        err_msg += " - stderr: " + err_txt;
+    }
+    throw Module::ProcessingError { err_msg };
+}
+
 //
 // Free functions
 //
@@ -68,7 +146,8 @@ PCPClient::Validator getMetadataValidator() {
 ExternalModule::ExternalModule(const std::string& path,
                                const lth_jc::JsonContainer& config)
         : path_ { path },
-          config_ { config } {
+          config_ { config },
+          config_txt_ { config.toString() } {
     fs::path module_path { path };
     module_name = module_path.stem().string();
     auto metadata = getMetadata();
@@ -92,7 +171,8 @@ ExternalModule::ExternalModule(const std::string& path,
 
 ExternalModule::ExternalModule(const std::string& path)
         : path_ { path },
-          config_ { "{}" } {
+          config_ { "{}" },
+          config_txt_ { "{}" } {
     fs::path module_path { path };
     module_name = module_path.stem().string();
     auto metadata = getMetadata();
@@ -125,20 +205,12 @@ void ExternalModule::readNonBlockingOutcome(const ActionRequest& request,
                                             const std::string& err_file,
                                             std::string& out_txt,
                                             std::string& err_txt) {
-    if (fs::exists(err_file)) {
-        if (!lth_file::read(err_file, err_txt)) {
-            LOG_ERROR("Failed to read error file '%1%' of '%2% %3%'; will "
-                      "continue processing the output",
-                      err_file, request.module(), request.action());
-        } else {
-            LOG_TRACE("Successfully read error file '%1%'", err_file);
-        }
-    }
+    readErrorFile(request, err_file, err_txt);
 
-    if (!fs::exists(out_file)) {
+    if (!OutputCompressor::exists(out_file)) {
         LOG_DEBUG("Output file '%1%' of '%2% %3%' does not exist",
                   out_file, request.module(), request.action());
-    } else if (!lth_file::read(out_file, out_txt)) {
+    } else if (!OutputCompressor::read(out_file, out_txt)) {
         LOG_ERROR("Failed to read output file '%1%' of '%2% %3%'",
                   out_file, request.module(), request.action());
         throw Module::ProcessingError { "failed to read" };
@@ -208,6 +280,20 @@ void ExternalModule::registerActions(const lth_jc::JsonContainer& metadata) {
     }
 }
 
+// Compile the schema of the action, if supported; otherwise the
+// action will be validated by the registered validator
+void ExternalModule::compileSchema(std::map<std::string, CompiledSchema>& schemas,
+                                   const std::string& action_name,
+                                   const lth_jc::JsonContainer& schema) {
+    try {
+        schemas.emplace(action_name, CompiledSchema { schema });
+    } catch (CompiledSchema::Unsupported& e) {
+        LOG_DEBUG("Cannot compile a schema of action '%1% %2%' (%3%); it will "
+                  "be validated by walking the schema", module_name,
+                  action_name, e.what());
+    }
+}
+
 // Register the specified action after ensuring that the input and
 // output schemas are valid JSON (i.e. we can instantiate Schema).
 void ExternalModule::registerAction(const lth_jc::JsonContainer& action) {
@@ -227,6 +313,8 @@ void ExternalModule::registerAction(const lth_jc::JsonContainer& action) {
         actions.push_back(action_name);
         input_validator_.registerSchema(input_schema);
         output_validator_.registerSchema(output_schema);
+        compileSchema(compiled_input_schemas_, action_name, input_schema_json);
+        compileSchema(compiled_output_schemas_, action_name, output_schema_json);
     } catch (PCPClient::schema_error& e) {
         LOG_ERROR("Failed to parse metadata schemas of action '%1% %2%': %3%",
                   module_name, action_name, e.what());
@@ -243,10 +331,43 @@ void ExternalModule::registerAction(const lth_jc::JsonContainer& action) {
 }
 
 std::string ExternalModule::getRequestInput(const ActionRequest& request) {
-    lth_jc::JsonContainer request_input {};
-    request_input.set<lth_jc::JsonContainer>("params", request.params());
-    request_input.set<lth_jc::JsonContainer>("config", config_);
-    return request_input.toString();
+    // NB: paramsTxt() is cached by the request; it may have been
+    // already serialized to store the job metadata
+    const auto& params_txt = request.paramsTxt();
+    std::string input_txt {};
+    input_txt.reserve(INPUT_PARAMS_PREFIX.size() + params_txt.size()
+                      + INPUT_CONFIG_PREFIX.size() + config_txt_.size()
+                      + INPUT_SUFFIX.size()
+                      + (request.hasBlob() ? 1 + request.blob().size() : 0));
+    input_txt.append(INPUT_PARAMS_PREFIX)
+             .append(params_txt)
+             .append(INPUT_CONFIG_PREFIX)
+             .append(config_txt_)
+             .append(INPUT_SUFFIX);
+
+    if (request.hasBlob()) {
+        // NB: the serialized JSON input has no newlines; the blob is
+        // copied, as the whole input is written to stdin at once
+        input_txt.append("\n").append(request.blob());
+    }
+
+    return input_txt;
+}
+
+void ExternalModule::logExitStatus(const std::string& action_name,
+                                   int exit_code,
+                                   const std::string& err_txt) {
+    if (exit_code != EXIT_SUCCESS) {
+        if (!err_txt.empty()) {
+            LOG_ERROR("'%1% %2%' failure, returned %3%; error: %4%",
+                      module_name, action_name, exit_code, err_txt);
+        } else {
+            LOG_ERROR("'%1% %2%' failure, returned %3%",
+                      module_name, action_name, exit_code);
+        }
+    } else if (!err_txt.empty()) {
+        LOG_WARNING("'%1% %2%' error: %3%", module_name, action_name, err_txt);
+    }
 }
 
 ActionOutcome ExternalModule::processRequestOutcome(const ActionRequest& request,
@@ -261,22 +382,40 @@ ActionOutcome ExternalModule::processRequestOutcome(const ActionRequest& request
         LOG_DEBUG("'%1% %2%' output: %3%", module_name, action_name, out_txt);
     }
 
-    if (exit_code != EXIT_SUCCESS) {
-        if (!err_txt.empty()) {
-            LOG_ERROR("'%1% %2%' failure, returned %3%; error: %4%",
-                      module_name, action_name, exit_code, err_txt);
-        } else {
-            LOG_ERROR("'%1% %2%' failure, returned %3%",
-                      module_name, action_name, exit_code);
+    logExitStatus(action_name, exit_code, err_txt);
+
+    auto schema_it = compiled_output_schemas_.find(action_name);
+    auto validated = false;
+
+    if (schema_it != compiled_output_schemas_.end()) {
+        // Parse and validate the output with a single pass over it
+        std::string error;
+        bool parse_error { false };
+        validated = schema_it->second.validate(out_txt, error, parse_error);
+
+        if (!validated) {
+            throwInvalidOutput(module_name, action_name, parse_error, error,
+                               err_txt);
         }
-    } else if (!err_txt.empty()) {
-        LOG_WARNING("'%1% %2%' error: %3%", module_name, action_name, err_txt);
     }
 
     try {
-        // Ensure output format is valid JSON by instantiating JsonContainer
-        lth_jc::JsonContainer results { out_txt };
-        return ActionOutcome { exit_code, err_txt, out_txt, results };
+        lth_jc::JsonContainer results {};
+
+        // NB: once validated, the output of a non-blocking action is
+        // parsed only if it will be sent to the requester; otherwise
+        // it is retrieved from the spool by the status queries
+        if (!validated
+                || request.type() == RequestType::Blocking
+                || request.notifyOutcome()) {
+            // Ensure output format is valid JSON by instantiating JsonContainer
+            results = lth_jc::JsonContainer { out_txt };
+        }
+
+        ActionOutcome outcome { exit_code, std::move(err_txt),
+                                std::move(out_txt), std::move(results) };
+        outcome.validated = validated;
+        return outcome;
     } catch (lth_jc::data_parse_error& e) {
         LOG_ERROR("'%1% %2%' output is not valid JSON: %3%",
                   module_name, action_name, e.what());
@@ -289,6 +428,38 @@ ActionOutcome ExternalModule::processRequestOutcome(const ActionRequest& request
     }
 }
 
+ActionOutcome ExternalModule::processFragmentedOutcome(const ActionRequest& request,
+                                                       int exit_code,
+                                                       const std::string& out_file,
+                                                       std::string& err_txt,
+                                                       const CompiledSchema& schema) {
+    auto action_name = request.action();
+    logExitStatus(action_name, exit_code, err_txt);
+
+    std::ifstream out_stream { out_file, std::ios::in | std::ios::binary };
+
+    if (!out_stream) {
+        LOG_ERROR("Failed to read output file '%1%' of '%2% %3%'",
+                  out_file, module_name, action_name);
+        throw Module::ProcessingError { "failed to read" };
+    }
+
+    std::string error;
+    bool parse_error { false };
+
+    if (!schema.validate(out_stream, error, parse_error)) {
+        throwInvalidOutput(module_name, action_name, parse_error, error, err_txt);
+    }
+
+    LOG_DEBUG("'%1% %2%' output is valid; it will be sent in fragments from "
+              "'%3%'", module_name, action_name, out_file);
+    ActionOutcome outcome { exit_code, std::move(err_txt), std::string {},
+                            lth_jc::JsonContainer {} };
+    outcome.validated = true;
+    outcome.fragmented = true;
+    return outcome;
+}
+
 ActionOutcome ExternalModule::callBlockingAction(const ActionRequest& request) {
     auto action_name = request.action();
     auto input_txt = getRequestInput(request);
@@ -296,7 +467,7 @@ ActionOutcome ExternalModule::callBlockingAction(const ActionRequest& request) {
     LOG_INFO("Executing '%1% %2%' (blocking request), transaction id %3%",
              module_name, action_name, request.transactionId());
     LOG_TRACE("Blocking request %1% input: %2%",
-              request.transactionId(), input_txt);
+              request.transactionId(), describeInput(request, input_txt));
 
     auto exec = lth_exec::execute(
 #ifdef _WIN32
@@ -306,10 +477,15 @@ ActionOutcome ExternalModule::callBlockingAction(const ActionRequest& request) {
 #endif
         input_txt,  // input
         std::map<std::string, std::string>(),  // environment
+        [&request](size_t) {
+            request.stamp(RequestTimeline::Event::Spawned);
+        },          // pid callback
         0,          // timeout
         { lth_exec::execution_options::merge_environment });  // options
 
-    return processRequestOutcome(request, exec.exit_code, exec.output, exec.error);
+    request.stamp(RequestTimeline::Event::Exited);
+    return processRequestOutcome(request, exec.exit_code,
+                                 exec.output, exec.error);
 }
 
 ActionOutcome ExternalModule::callNonBlockingAction(const ActionRequest& request) {
@@ -317,8 +493,9 @@ ActionOutcome ExternalModule::callNonBlockingAction(const ActionRequest& request
     auto input_txt = getRequestInput(request);
 
     // HERE(ale): using HW instead of Configuration to ease unit tests
-    auto results_dir_path = fs::path(HW::GetFlag<std::string>("spool-dir"))
-                            / request.transactionId();
+    fs::path results_dir_path {
+        SpoolLayout::getJobDir(HW::GetFlag<std::string>("spool-dir"),
+                               request.transactionId()) };
     auto out_file = (results_dir_path / "stdout").string();
     auto err_file = (results_dir_path / "stderr").string();
 
@@ -326,28 +503,58 @@ ActionOutcome ExternalModule::callNonBlockingAction(const ActionRequest& request
              "be stored in %3%), transaction id %4%", module_name, action_name,
              results_dir_path.string(), request.transactionId());
     LOG_TRACE("Non-blocking request %1% input: %2%",
-              request.transactionId(), input_txt);
+              request.transactionId(), describeInput(request, input_txt));
+
+#ifndef _WIN32
+    // Execute the module through a shell that stores its exit code
+    // on file, so that a pxp-agent restarted while the job is
+    // running can adopt it (see SpoolRecovery); the stored PID is
+    // the one of the wrapper shell
+    auto exitcode_file = (results_dir_path / "exitcode").string();
+#endif
 
     auto exec = lth_exec::execute(
 #ifdef _WIN32
         "cmd.exe", { "/c", path_, action_name },
 #else
-        path_, { action_name },
+        "/bin/sh", { "-c", NON_BLOCKING_WRAPPER,
+                     path_, action_name, exitcode_file },
 #endif
         input_txt,  // input
         out_file,   // out file
         err_file,   // err file
         std::map<std::string, std::string>(),  // environment
-        [results_dir_path](size_t pid) {
+        [results_dir_path, &request](size_t pid) {
+            request.stamp(RequestTimeline::Event::Spawned);
+
+            // NB: the start time of the process is stored after the
+            // PID, so that a recycled PID is not mistaken for it
             auto pid_file = (results_dir_path / "pid").string();
-            lth_file::atomic_write_to_file(std::to_string(pid) + "\n", pid_file);
+            auto start_time = Util::getProcessStartTime(static_cast<int>(pid));
+            lth_file::atomic_write_to_file(std::to_string(pid) + "\n"
+                                           + std::to_string(start_time) + "\n",
+                                           pid_file);
         },          // pid callback
         0,          // timeout
         { lth_exec::execution_options::merge_environment });  // options
 
-    // Stdout / stderr output is on file; read it
+    request.stamp(RequestTimeline::Event::Exited);
+
     std::string out_txt;
     std::string err_txt;
+    auto schema_it = compiled_output_schemas_.find(action_name);
+
+    // NB: results that will be sent in fragments are validated while
+    // being read, so that they are never held in memory in full; that
+    // requires the output schema to be compiled
+    if (schema_it != compiled_output_schemas_.end()
+            && isFragmented(request, out_file)) {
+        readErrorFile(request, err_file, err_txt);
+        return processFragmentedOutcome(request, exec.exit_code, out_file,
+                                        err_txt, schema_it->second);
+    }
+
+    // Stdout / stderr output is on file; read it
     readNonBlockingOutcome(request, out_file, err_file, out_txt, err_txt);
 
     return processRequestOutcome(request, exec.exit_code, out_txt, err_txt);
@@ -0,0 +1,99 @@
+#include <pxp-agent/histogram.hpp>
+
+#include <algorithm>   // max
+#include <functional>  // hash
+#include <thread>
+
+namespace PXPAgent {
+
+const size_t Histogram::NUM_BUCKETS;
+const size_t Histogram::NUM_SHARDS;
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+    uint64_t cumulative { 0 };
+
+    for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+        cumulative += counts[bucket];
+
+        if (cumulative > rank || cumulative == count) {
+            return std::min(upperBoundOf(bucket), max_us);
+        }
+    }
+
+    return max_us;
+}
+
+Histogram::Histogram()
+        : shards_ {} {
+    for (auto& shard : shards_) {
+        for (auto& count : shard.counts) {
+            count.store(0);
+        }
+
+        shard.sum_us.store(0);
+        shard.max_us.store(0);
+    }
+}
+
+void Histogram::record(uint64_t duration_us) {
+    auto& shard = shards_[std::hash<std::thread::id>()(std::this_thread::get_id())
+                          % NUM_SHARDS];
+    shard.counts[bucketOf(duration_us)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_us.fetch_add(duration_us, std::memory_order_relaxed);
+    auto max_us = shard.max_us.load(std::memory_order_relaxed);
+
+    while (duration_us > max_us
+            && !shard.max_us.compare_exchange_weak(max_us, duration_us,
+                                                   std::memory_order_relaxed)) {
+    }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot { 0, 0, 0, std::vector<uint64_t>(NUM_BUCKETS, 0) };
+
+    for (const auto& shard : shards_) {
+        for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            auto count = shard.counts[bucket].load(std::memory_order_relaxed);
+            snapshot.counts[bucket] += count;
+            snapshot.count += count;
+        }
+
+        snapshot.sum_us += shard.sum_us.load(std::memory_order_relaxed);
+        snapshot.max_us = std::max(snapshot.max_us,
+                                   shard.max_us.load(std::memory_order_relaxed));
+    }
+
+    return snapshot;
+}
+
+size_t Histogram::bucketOf(uint64_t duration_us) {
+    if (duration_us < 4) {
+        return static_cast<size_t>(duration_us);
+    }
+
+    size_t msb { 2 };
+
+    while (msb < 63 && (duration_us >> (msb + 1)) != 0) {
+        msb++;
+    }
+
+    auto sub_bucket = static_cast<size_t>((duration_us >> (msb - 2)) & 3);
+    return std::min(4 * (msb - 1) + sub_bucket, NUM_BUCKETS - 1);
+}
+
+uint64_t Histogram::upperBoundOf(size_t bucket) {
+    if (bucket < 4) {
+        return bucket + 1;
+    }
+
+    auto msb = bucket / 4 + 1;
+    auto sub_bucket = bucket % 4;
+    return static_cast<uint64_t>(5 + sub_bucket) << (msb - 2);
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,415 @@
+#include <pxp-agent/job_archive.hpp>
+#include <pxp-agent/output_compressor.hpp>
+#include <pxp-agent/spool_layout.hpp>
+#include <pxp-agent/util/sync_file.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/util/strings.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.job_archive"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>  // max
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+static const std::string ARCHIVE_DIR_NAME { "archive" };
+static const std::string SEGMENT_PREFIX { "segment-" };
+static const std::string INDEX_SUFFIX { ".idx" };
+
+// Read the whole file, in binary mode; throw a JobArchive::Error in
+// case of failure
+static std::string readBinary(const std::string& file_path) {
+    std::ifstream in { file_path, std::ios::in | std::ios::binary };
+
+    if (!in) {
+        throw JobArchive::Error { "failed to open " + file_path };
+    }
+
+    std::ostringstream content {};
+    content << in.rdbuf();
+    return content.str();
+}
+
+// Read the specified output stream of the job, as stored in the
+// spool; set the 'compressed' flag accordingly
+static std::string readStoredOutput(const fs::path& file_path, bool& compressed) {
+    auto compressed_path = file_path.string() + COMPRESSED_FILE_SUFFIX;
+    compressed = fs::exists(compressed_path);
+
+    if (compressed) {
+        return readBinary(compressed_path);
+    }
+
+    return fs::exists(file_path) ? readBinary(file_path.string()) : "";
+}
+
+static void writeAll(std::FILE* file, const std::string& data,
+                     const std::string& file_path) {
+    if (std::fwrite(data.data(), 1, data.size(), file) != data.size()) {
+        std::fclose(file);
+        throw JobArchive::Error { "failed to write " + file_path };
+    }
+}
+
+JobArchive::JobArchive(const std::string& spool_dir,
+                       uint32_t archive_after_s,
+                       uint32_t retention_s,
+                       uint64_t max_segment_size,
+                       std::shared_ptr<JobIndex> job_index_ptr)
+        : spool_dir_ { spool_dir },
+          archive_dir_ { (fs::path(spool_dir) / ARCHIVE_DIR_NAME).string() },
+          archive_after_s_ { archive_after_s },
+          retention_s_ { retention_s },
+          max_segment_size_ { max_segment_size },
+          job_index_ptr_ { job_index_ptr },
+          index_ {},
+          current_segment_ { 1 },
+          stopping_ { false },
+          writer_mutex_ {},
+          mutex_ {},
+          cond_var_ {},
+          maintenance_thread_ {} {
+    loadIndex();
+
+    if (archive_after_s_ > 0) {
+        maintenance_thread_ = pcp_util::thread(&JobArchive::maintenanceTask, this);
+    }
+}
+
+JobArchive::~JobArchive() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        cond_var_.notify_one();
+    }
+
+    if (maintenance_thread_.joinable()) {
+        maintenance_thread_.join();
+    }
+}
+
+bool JobArchive::find(const std::string& job_id, Record& record) {
+    Location location;
+
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        auto location_it = index_.find(job_id);
+
+        if (location_it == index_.end()) {
+            return false;
+        }
+
+        location = location_it->second;
+    }
+
+    // NB: records are never modified once indexed; the segment may
+    // only be removed in the meantime, if expired
+    auto segment_path = getSegmentPath(location.segment);
+    std::ifstream in { segment_path, std::ios::in | std::ios::binary };
+    in.seekg(static_cast<std::streamoff>(location.offset));
+    std::string header;
+
+    if (!in || !std::getline(in, header)) {
+        throw Error { "failed to read the record of job " + job_id
+                      + " from " + segment_path };
+    }
+
+    std::istringstream header_stream { header };
+    size_t metadata_size, out_size, err_size;
+    bool out_compressed, err_compressed;
+    std::string record_job_id;
+    header_stream >> metadata_size >> out_size >> out_compressed
+                  >> err_size >> err_compressed;
+    header_stream.ignore(1);
+    std::getline(header_stream, record_job_id);
+
+    if (!header_stream || record_job_id != job_id) {
+        throw Error { "invalid record of job " + job_id + " in " + segment_path };
+    }
+
+    auto readBlob = [&in](size_t size) {
+        std::string blob(size, '\0');
+        in.read(&blob[0], static_cast<std::streamsize>(size));
+        return blob;
+    };
+
+    record.metadata = readBlob(metadata_size);
+    record.stdout_txt = readBlob(out_size);
+    record.stderr_txt = readBlob(err_size);
+
+    if (!in) {
+        throw Error { "truncated record of job " + job_id + " in " + segment_path };
+    }
+
+    try {
+        if (out_compressed) {
+            record.stdout_txt = OutputCompressor::decompress(record.stdout_txt);
+        }
+
+        if (err_compressed) {
+            record.stderr_txt = OutputCompressor::decompress(record.stderr_txt);
+        }
+    } catch (const std::exception& e) {
+        throw Error { "failed to decompress the output of job " + job_id
+                      + ": " + e.what() };
+    }
+
+    return true;
+}
+
+void JobArchive::pack(const std::string& job_dir) {
+    fs::path job_path { job_dir };
+    auto job_id = job_path.filename().string();
+    bool out_compressed, err_compressed;
+    std::string metadata, out, err;
+
+    try {
+        metadata = readBinary((job_path / "metadata").string());
+        out = readStoredOutput(job_path / "stdout", out_compressed);
+        err = readStoredOutput(job_path / "stderr", err_compressed);
+    } catch (const fs::filesystem_error& e) {
+        throw Error { e.what() };
+    }
+
+    std::string header { std::to_string(metadata.size()) + " "
+                         + std::to_string(out.size()) + " "
+                         + (out_compressed ? "1 " : "0 ")
+                         + std::to_string(err.size()) + " "
+                         + (err_compressed ? "1 " : "0 ")
+                         + job_id + "\n" };
+
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { writer_mutex_ };
+
+        try {
+            if (!fs::exists(archive_dir_)) {
+                fs::create_directories(archive_dir_);
+            }
+
+            auto current_path = getSegmentPath(current_segment_);
+            if (fs::exists(current_path)
+                    && fs::file_size(current_path) >= max_segment_size_) {
+                current_segment_++;
+                LOG_DEBUG("Starting archive segment %1%", current_segment_);
+            }
+        } catch (const fs::filesystem_error& e) {
+            throw Error { e.what() };
+        }
+
+        auto segment_path = getSegmentPath(current_segment_);
+        auto segment_file = std::fopen(segment_path.data(), "ab");
+
+        if (segment_file == nullptr) {
+            throw Error { "failed to open " + segment_path };
+        }
+
+        std::fseek(segment_file, 0, SEEK_END);
+        auto offset = static_cast<uint64_t>(std::ftell(segment_file));
+
+        writeAll(segment_file, header, segment_path);
+        writeAll(segment_file, metadata, segment_path);
+        writeAll(segment_file, out, segment_path);
+        writeAll(segment_file, err, segment_path);
+
+        auto synced = Util::syncFile(segment_file);
+        std::fclose(segment_file);
+
+        if (!synced) {
+            throw Error { "failed to sync " + segment_path };
+        }
+
+        // NB: a record is valid only once indexed
+        auto index_path = segment_path + INDEX_SUFFIX;
+        auto index_file = std::fopen(index_path.data(), "ab");
+
+        if (index_file == nullptr) {
+            throw Error { "failed to open " + index_path };
+        }
+
+        writeAll(index_file, std::to_string(offset) + " " + job_id + "\n",
+                 index_path);
+        synced = Util::syncFile(index_file);
+        std::fclose(index_file);
+
+        if (!synced) {
+            throw Error { "failed to sync " + index_path };
+        }
+
+        pcp_util::lock_guard<pcp_util::mutex> index_lock { mutex_ };
+        index_[job_id] = Location { current_segment_, offset };
+    }
+
+    // NB: from now on, the job is found in the archive
+    if (job_index_ptr_) {
+        job_index_ptr_->remove(job_id);
+    }
+
+    boost::system::error_code ec;
+    fs::remove_all(job_path, ec);
+
+    if (ec) {
+        LOG_WARNING("Failed to remove the results directory of archived job "
+                    "%1%: %2%", job_id, ec.message());
+    }
+}
+
+unsigned int JobArchive::packCompletedJobs(std::time_t modified_before) {
+    unsigned int num_packed { 0 };
+
+    for (const auto& job_dir : SpoolLayout::listJobDirs(spool_dir_)) {
+        auto metadata_path = fs::path(job_dir) / "metadata";
+
+        try {
+            if (!fs::exists(metadata_path)
+                    || fs::last_write_time(metadata_path) >= modified_before
+                    || !lth_jc::JsonContainer(readBinary(metadata_path.string()))
+                            .get<bool>("completed")) {
+                continue;
+            }
+
+            pack(job_dir);
+            num_packed++;
+        } catch (const std::exception& e) {
+            LOG_WARNING("Failed to archive the job in %1%: %2%", job_dir, e.what());
+        }
+    }
+
+    if (num_packed > 0) {
+        LOG_INFO("Archived %1% completed job%2%",
+                 num_packed, lth_util::plural(num_packed));
+    }
+
+    return num_packed;
+}
+
+unsigned int JobArchive::removeSegments(std::time_t written_before) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { writer_mutex_ };
+    unsigned int num_removed { 0 };
+
+    // NB: the current segment is never removed
+    for (uint32_t segment = 1; segment < current_segment_; segment++) {
+        auto segment_path = getSegmentPath(segment);
+        boost::system::error_code ec;
+
+        if (!fs::exists(segment_path, ec)
+                || fs::last_write_time(segment_path, ec) >= written_before
+                || ec) {
+            continue;
+        }
+
+        {
+            // NB: the records are no longer found before being removed
+            pcp_util::lock_guard<pcp_util::mutex> index_lock { mutex_ };
+
+            for (auto it = index_.begin(); it != index_.end();) {
+                if (it->second.segment == segment) {
+                    it = index_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        fs::remove(segment_path + INDEX_SUFFIX, ec);
+        fs::remove(segment_path, ec);
+        num_removed++;
+    }
+
+    if (num_removed > 0) {
+        LOG_INFO("Removed %1% expired archive segment%2%",
+                 num_removed, lth_util::plural(num_removed));
+    }
+
+    return num_removed;
+}
+
+//
+// Private interface
+//
+
+std::string JobArchive::getSegmentPath(uint32_t segment) const {
+    char buffer[11];
+    std::snprintf(buffer, sizeof(buffer), "%010u", segment);
+    return (fs::path(archive_dir_) / (SEGMENT_PREFIX + buffer)).string();
+}
+
+void JobArchive::loadIndex() {
+    if (!fs::is_directory(archive_dir_)) {
+        return;
+    }
+
+    fs::directory_iterator end;
+
+    try {
+        for (auto f = fs::directory_iterator(archive_dir_); f != end; ++f) {
+            auto file_name = f->path().filename().string();
+
+            if (file_name.find(SEGMENT_PREFIX) != 0
+                    || f->path().extension().string() != INDEX_SUFFIX) {
+                continue;
+            }
+
+            auto segment = static_cast<uint32_t>(std::stoul(
+                f->path().stem().string().substr(SEGMENT_PREFIX.size())));
+            std::istringstream lines { readBinary(f->path().string()) };
+            uint64_t offset;
+            std::string job_id;
+
+            while (lines >> offset) {
+                lines.ignore(1);
+                if (!std::getline(lines, job_id)) {
+                    break;
+                }
+                index_[job_id] = Location { segment, offset };
+            }
+
+            current_segment_ = std::max(current_segment_, segment);
+        }
+    } catch (const std::exception& e) {
+        throw Error { std::string("failed to load the archive index: ") + e.what() };
+    }
+
+    LOG_DEBUG("Loaded the archive index; %1% archived job%2%",
+              index_.size(), lth_util::plural(index_.size()));
+}
+
+void JobArchive::maintenanceTask() {
+    while (true) {
+        {
+            pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+            auto deadline = pcp_util::chrono::system_clock::now()
+                            + pcp_util::chrono::seconds(ARCHIVE_CHECK_INTERVAL_S);
+
+            while (!stopping_ && pcp_util::chrono::system_clock::now() < deadline) {
+                cond_var_.wait_until(the_lock, deadline);
+            }
+
+            if (stopping_) {
+                return;
+            }
+        }
+
+        auto now = std::time(nullptr);
+        packCompletedJobs(now - archive_after_s_);
+
+        if (retention_s_ > 0) {
+            removeSegments(now - retention_s_);
+        }
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,39 @@
+#include <pxp-agent/job_index.hpp>
+
+namespace PXPAgent {
+
+namespace pcp_util = PCPClient::Util;
+
+JobIndex::JobIndex()
+        : entries_ {},
+          mutex_ {} {
+}
+
+void JobIndex::set(const std::string& job_id, const std::string& job_dir) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    entries_[job_id] = Entry { job_dir };
+}
+
+void JobIndex::remove(const std::string& job_id) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    entries_.erase(job_id);
+}
+
+bool JobIndex::find(const std::string& job_id, Entry& entry) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto entry_it = entries_.find(job_id);
+
+    if (entry_it == entries_.end()) {
+        return false;
+    }
+
+    entry = entry_it->second;
+    return true;
+}
+
+size_t JobIndex::size() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return entries_.size();
+}
+
+}  // namespace PXPAgent
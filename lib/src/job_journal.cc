@@ -0,0 +1,362 @@
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/util/sync_file.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/strings.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.job_journal"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <sstream>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+static const std::string ACCEPTED { "accepted" };
+static const std::string STARTED { "started" };
+static const std::string COMPLETED { "completed" };
+static const std::string FAILED { "failed" };
+
+static std::string checksum(const std::string& txt) {
+    boost::crc_32_type crc {};
+    crc.process_bytes(txt.data(), txt.size());
+    char buffer[9];
+    std::snprintf(buffer, sizeof(buffer), "%08x",
+                  static_cast<unsigned int>(crc.checksum()));
+    return std::string { buffer };
+}
+
+JobJournal::JobJournal(const std::string& file_path)
+        : file_path_ { file_path },
+          file_ { nullptr },
+          interrupted_jobs_ {},
+          live_records_ {},
+          num_appended_records_ { 0 },
+          pending_records_ {},
+          pending_callbacks_ {},
+          writing_ { false },
+          stopping_ { false },
+          mutex_ {},
+          writer_cond_var_ {},
+          batch_cond_var_ {},
+          writer_thread_ {} {
+    try {
+        auto parent_path = fs::path(file_path_).parent_path();
+        if (!parent_path.empty() && !fs::exists(parent_path)) {
+            fs::create_directories(parent_path);
+        }
+    } catch (const fs::filesystem_error& e) {
+        throw Error { std::string("failed to create the journal directory: ")
+                      + e.what() };
+    }
+
+    replay();
+
+    // Compact the file, so that it contains only the jobs to be failed
+    std::vector<std::string> live_records {};
+    for (const auto& job : live_records_) {
+        live_records.push_back(job.second);
+    }
+
+    if (!rewrite(live_records)) {
+        throw Error { "failed to open the journal file " + file_path_ };
+    }
+
+    writer_thread_ = pcp_util::thread(&JobJournal::writerTask, this);
+}
+
+JobJournal::~JobJournal() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        writer_cond_var_.notify_one();
+    }
+
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+}
+
+std::vector<JobJournal::Entry> JobJournal::getInterruptedJobs() const {
+    return interrupted_jobs_;
+}
+
+void JobJournal::logAccepted(const ActionRequest& request, Callback on_durable) {
+    lth_jc::JsonContainer record {};
+    record.set<std::string>("job_id", request.transactionId());
+    record.set<std::string>("state", ACCEPTED);
+    record.set<std::string>("requester", request.sender());
+    record.set<std::string>("request_id", request.id());
+    record.set<std::string>("module", request.module());
+    record.set<std::string>("action", request.action());
+    record.set<bool>("notify_outcome",
+                     request.parsedChunks().data.get<bool>("notify_outcome"));
+
+    append(request.transactionId(), ACCEPTED, record.toString(),
+           std::move(on_durable));
+}
+
+void JobJournal::logStarted(const std::string& job_id) {
+    lth_jc::JsonContainer record {};
+    record.set<std::string>("job_id", job_id);
+    record.set<std::string>("state", STARTED);
+    append(job_id, STARTED, record.toString());
+}
+
+void JobJournal::logCompleted(const std::string& job_id) {
+    lth_jc::JsonContainer record {};
+    record.set<std::string>("job_id", job_id);
+    record.set<std::string>("state", COMPLETED);
+    append(job_id, COMPLETED, record.toString());
+}
+
+void JobJournal::logFailed(const std::string& job_id) {
+    lth_jc::JsonContainer record {};
+    record.set<std::string>("job_id", job_id);
+    record.set<std::string>("state", FAILED);
+    append(job_id, FAILED, record.toString());
+}
+
+void JobJournal::flush() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    while (writing_ || !pending_records_.empty()) {
+        batch_cond_var_.wait(the_lock);
+    }
+}
+
+//
+// Private interface
+//
+
+void JobJournal::replay() {
+    if (!fs::exists(file_path_)) {
+        return;
+    }
+
+    std::string content;
+    if (!lth_file::read(file_path_, content)) {
+        throw Error { "failed to read the journal file " + file_path_ };
+    }
+
+    std::vector<std::string> job_ids {};
+    std::map<std::string, std::pair<Entry, std::string>> jobs {};
+    std::istringstream lines { content };
+    std::string line;
+    unsigned int num_records { 0 };
+
+    while (std::getline(lines, line)) {
+        auto separator = line.find(' ');
+        std::string state {};
+
+        try {
+            if (separator == std::string::npos) {
+                throw Error { "missing checksum" };
+            }
+
+            auto txt = line.substr(separator + 1);
+            if (checksum(txt) != line.substr(0, separator)) {
+                throw Error { "checksum mismatch" };
+            }
+
+            lth_jc::JsonContainer record { txt };
+            auto job_id = record.get<std::string>("job_id");
+            state = record.get<std::string>("state");
+
+            if (state == ACCEPTED) {
+                Entry entry { job_id,
+                              record.get<std::string>("requester"),
+                              record.get<std::string>("request_id"),
+                              record.get<std::string>("module"),
+                              record.get<std::string>("action"),
+                              record.get<bool>("notify_outcome") };
+                job_ids.push_back(job_id);
+                jobs[job_id] = std::make_pair(entry, state);
+                live_records_[job_id] = line + "\n";
+            } else {
+                if (jobs.find(job_id) != jobs.end()) {
+                    jobs[job_id].second = state;
+                }
+
+                // NB: same rule as append()
+                live_records_.erase(job_id);
+            }
+        } catch (const std::exception& e) {
+            // Most likely a record truncated by a crash; the following
+            // ones cannot be trusted
+            LOG_WARNING("Ignoring record %1% of the journal file %2% and the "
+                        "following ones: %3%", num_records + 1, file_path_, e.what());
+            break;
+        }
+
+        num_records++;
+    }
+
+    for (const auto& job_id : job_ids) {
+        if (jobs[job_id].second == ACCEPTED) {
+            interrupted_jobs_.push_back(jobs[job_id].first);
+        }
+    }
+
+    LOG_DEBUG("Replayed %1% journal record%2%; %3% job%4% accepted by the "
+              "previous run were not started", num_records,
+              lth_util::plural(num_records), interrupted_jobs_.size(),
+              lth_util::plural(interrupted_jobs_.size()));
+}
+
+void JobJournal::append(const std::string& job_id,
+                        const std::string& state,
+                        const std::string& record,
+                        Callback on_durable) {
+    auto line = checksum(record) + " " + record + "\n";
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+
+    pending_records_.push_back(line);
+    num_appended_records_++;
+
+    if (on_durable) {
+        pending_callbacks_.push_back(std::move(on_durable));
+    }
+
+    // Started jobs are taken over by SpoolRecovery; there's no need
+    // to keep their records once compacted
+    if (state == ACCEPTED) {
+        live_records_[job_id] = line;
+    } else {
+        live_records_.erase(job_id);
+    }
+
+    writer_cond_var_.notify_one();
+}
+
+void JobJournal::writerTask() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    while (true) {
+        while (!stopping_ && pending_records_.empty()) {
+            writer_cond_var_.wait(the_lock);
+        }
+
+        if (pending_records_.empty()) {
+            // Stopping and all records have been written
+            break;
+        }
+
+        // The records queued while writing will form the next batch
+        std::vector<std::string> records {};
+        records.swap(pending_records_);
+        std::vector<Callback> callbacks {};
+        callbacks.swap(pending_callbacks_);
+        writing_ = true;
+        bool compact { num_appended_records_ >= JOURNAL_COMPACTION_THRESHOLD };
+
+        if (compact) {
+            // NB: the live records already account for this batch
+            records.clear();
+            for (const auto& job : live_records_) {
+                records.push_back(job.second);
+            }
+            num_appended_records_ = 0;
+        }
+
+        the_lock.unlock();
+        auto ok = compact ? rewrite(records) : writeRecords(records);
+        the_lock.lock();
+
+        if (!ok) {
+            LOG_ERROR("Failed to write %1% record%2% to the journal file %3%",
+                      records.size(), lth_util::plural(records.size()),
+                      file_path_);
+            // A record may have been partially written; rewrite the
+            // whole file with the next batch
+            num_appended_records_ = JOURNAL_COMPACTION_THRESHOLD;
+        }
+
+        // NB: the callbacks may append records
+        the_lock.unlock();
+        for (const auto& callback : callbacks) {
+            try {
+                callback(ok);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failure while notifying a journal record: %1%",
+                          e.what());
+            }
+        }
+        the_lock.lock();
+
+        writing_ = false;
+        batch_cond_var_.notify_all();
+    }
+}
+
+bool JobJournal::writeRecords(const std::vector<std::string>& records) {
+    if (file_ == nullptr) {
+        file_ = std::fopen(file_path_.data(), "ab");
+        if (file_ == nullptr) {
+            return false;
+        }
+    }
+
+    for (const auto& record : records) {
+        if (std::fwrite(record.data(), 1, record.size(), file_) != record.size()) {
+            return false;
+        }
+    }
+
+    return Util::syncFile(file_);
+}
+
+bool JobJournal::rewrite(const std::vector<std::string>& records) {
+    auto tmp_path = file_path_ + ".tmp";
+    auto tmp_file = std::fopen(tmp_path.data(), "wb");
+
+    if (tmp_file == nullptr) {
+        return false;
+    }
+
+    bool ok { true };
+    for (const auto& record : records) {
+        if (std::fwrite(record.data(), 1, record.size(), tmp_file)
+                != record.size()) {
+            ok = false;
+            break;
+        }
+    }
+
+    ok = ok && Util::syncFile(tmp_file);
+    std::fclose(tmp_file);
+    boost::system::error_code ec;
+
+    if (ok) {
+        fs::rename(tmp_path, file_path_, ec);
+        ok = !ec;
+    }
+
+    if (!ok) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+
+    file_ = std::fopen(file_path_.data(), "ab");
+    return file_ != nullptr;
+}
+
+}  // namespace PXPAgent
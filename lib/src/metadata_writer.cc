@@ -0,0 +1,213 @@
+#include <pxp-agent/metadata_writer.hpp>
+#include <pxp-agent/util/sync_file.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/strings.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.metadata_writer"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cstdio>
+#include <utility>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+MetadataWriter::MetadataWriter(uint32_t max_delay_ms)
+        : max_delay_ms_ { max_delay_ms },
+          pending_ {},
+          in_flight_ {},
+          num_written_batches_ { 0 },
+          num_flush_requests_ { 0 },
+          stopping_ { false },
+          mutex_ {},
+          writer_cond_var_ {},
+          flushed_cond_var_ {},
+          writer_thread_ { &MetadataWriter::writerTask, this } {
+}
+
+MetadataWriter::~MetadataWriter() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        writer_cond_var_.notify_one();
+    }
+
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+}
+
+void MetadataWriter::write(const std::string& file_path,
+                           const std::string& content,
+                           Callback on_written) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto& update = pending_[file_path];
+    update.content = content;
+
+    if (on_written) {
+        update.callbacks.push_back(std::move(on_written));
+    }
+
+    writer_cond_var_.notify_one();
+}
+
+bool MetadataWriter::read(const std::string& file_path, std::string& content) {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        auto update_it = pending_.find(file_path);
+
+        if (update_it != pending_.end()) {
+            content = update_it->second.content;
+            return true;
+        }
+
+        update_it = in_flight_.find(file_path);
+
+        if (update_it != in_flight_.end()) {
+            content = update_it->second.content;
+            return true;
+        }
+    }
+
+    return lth_file::read(file_path, content);
+}
+
+void MetadataWriter::flush() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+    num_flush_requests_++;
+    writer_cond_var_.notify_one();
+
+    while (!pending_.empty() || !in_flight_.empty()) {
+        flushed_cond_var_.wait(the_lock);
+    }
+
+    num_flush_requests_--;
+}
+
+uint32_t MetadataWriter::getNumWrittenBatches() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return num_written_batches_;
+}
+
+//
+// Private interface
+//
+
+void MetadataWriter::writerTask() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    while (true) {
+        while (!stopping_ && pending_.empty()) {
+            writer_cond_var_.wait(the_lock);
+        }
+
+        if (pending_.empty()) {
+            // Stopping and all updates have been written
+            break;
+        }
+
+        if (max_delay_ms_ > 0) {
+            // Give other updates the chance to join the batch
+            auto deadline = pcp_util::chrono::system_clock::now()
+                            + pcp_util::chrono::milliseconds(max_delay_ms_);
+
+            while (!stopping_ && num_flush_requests_ == 0
+                    && pcp_util::chrono::system_clock::now() < deadline) {
+                writer_cond_var_.wait_until(the_lock, deadline);
+            }
+        }
+
+        // NB: in_flight_ is modified only by this thread, so it can
+        // be accessed without holding the lock while writing
+        in_flight_.swap(pending_);
+        the_lock.unlock();
+        auto failed = writeBatch(in_flight_);
+
+        if (!failed.empty()) {
+            LOG_ERROR("Failed to write %1% metadata file%2% out of %3%",
+                      failed.size(), lth_util::plural(failed.size()),
+                      in_flight_.size());
+        }
+
+        for (const auto& update : in_flight_) {
+            auto written = failed.find(update.first) == failed.end();
+
+            for (const auto& callback : update.second.callbacks) {
+                try {
+                    callback(written);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Failure while notifying the update of %1%: %2%",
+                              update.first, e.what());
+                }
+            }
+        }
+
+        the_lock.lock();
+        in_flight_.clear();
+        num_written_batches_++;
+        flushed_cond_var_.notify_all();
+    }
+}
+
+std::set<std::string> MetadataWriter::writeBatch(
+        const std::map<std::string, Update>& batch) {
+    std::set<std::string> failed {};
+    std::set<std::string> dirs {};
+
+    for (const auto& update : batch) {
+        const auto& content = update.second.content;
+        auto tmp_path = update.first + ".tmp";
+        auto tmp_file = std::fopen(tmp_path.data(), "wb");
+
+        if (tmp_file == nullptr) {
+            LOG_DEBUG("Failed to open %1%", tmp_path);
+            failed.insert(update.first);
+            continue;
+        }
+
+        // NB: the file is renamed only once its content is on disk,
+        // so that a metadata file is never replaced by an incomplete one
+        auto ok = std::fwrite(content.data(), 1, content.size(), tmp_file)
+                  == content.size();
+        ok = ok && Util::syncFile(tmp_file);
+        ok = (std::fclose(tmp_file) == 0) && ok;
+        boost::system::error_code ec;
+
+        if (ok) {
+            fs::rename(tmp_path, update.first, ec);
+        }
+
+        if (!ok || ec) {
+            LOG_DEBUG("Failed to write %1%%2%", update.first,
+                      ec ? ": " + ec.message() : "");
+            fs::remove(tmp_path, ec);
+            failed.insert(update.first);
+            continue;
+        }
+
+        dirs.insert(fs::path(update.first).parent_path().string());
+    }
+
+    // A single sync of each directory, for the renames of the batch
+    for (const auto& dir : dirs) {
+        if (!Util::syncDirectory(dir)) {
+            LOG_WARNING("Failed to sync the metadata directory %1%", dir);
+        }
+    }
+
+    LOG_TRACE("Wrote a batch of %1% metadata file%2%", batch.size(),
+              lth_util::plural(batch.size()));
+    return failed;
+}
+
+}  // namespace PXPAgent
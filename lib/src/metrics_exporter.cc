@@ -0,0 +1,269 @@
+#include <pxp-agent/metrics_exporter.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.metrics_exporter"
+#include <leatherman/logging/logging.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>      // strerror
+#include <fcntl.h>      // fcntl()
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>     // close(), unlink()
+#endif
+
+namespace PXPAgent {
+
+namespace lth_file = leatherman::file_util;
+namespace pcp_util = PCPClient::Util;
+namespace pcp_chrono = PCPClient::Util::chrono;
+
+// Interval between checks of the stop flag, while serving the socket
+static const uint32_t METRICS_POLL_INTERVAL_MS { 250 };
+
+// Time the exporter waits for a client to send its request, and then
+// to read the response, so that a stuck client cannot hold the thread
+static const uint32_t METRICS_CLIENT_TIMEOUT_MS { 1000 };
+
+#ifndef _WIN32
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// NB: where not available, send() may block after a successful poll,
+// until the client reads
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+
+static int listenOn(const std::string& socket_path) {
+    sockaddr_un address {};
+
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw MetricsExporter::Error { "the socket path '" + socket_path
+                                       + "' is too long" };
+    }
+
+    struct stat file_stat;
+
+    if (::lstat(socket_path.c_str(), &file_stat) == 0) {
+        if (!S_ISSOCK(file_stat.st_mode)) {
+            throw MetricsExporter::Error { "'" + socket_path
+                                           + "' exists and is not a socket" };
+        }
+
+        // NB: left over by a previous run
+        ::unlink(socket_path.c_str());
+    }
+
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        throw MetricsExporter::Error { std::string { "failed to create the socket: " }
+                                       + std::strerror(errno) };
+    }
+
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(fd, SOMAXCONN) != 0) {
+        auto error = std::strerror(errno);
+        ::close(fd);
+        throw MetricsExporter::Error { "failed to listen on '" + socket_path
+                                       + "': " + error };
+    }
+
+    return fd;
+}
+
+// Write the text within the specified time; the socket is polled, so
+// that a client that does not read cannot block the exporter
+static void writeAll(int fd, const std::string& text, uint32_t timeout_ms) {
+    auto deadline = pcp_chrono::steady_clock::now()
+                    + pcp_chrono::milliseconds(timeout_ms);
+    size_t written { 0 };
+
+    while (written < text.size()) {
+        auto remaining_ms = pcp_chrono::duration_cast<pcp_chrono::milliseconds>(
+            deadline - pcp_chrono::steady_clock::now()).count();
+        pollfd client { fd, POLLOUT, 0 };
+
+        if (remaining_ms <= 0
+                || ::poll(&client, 1, static_cast<int>(remaining_ms)) == 0) {
+            throw MetricsExporter::Error { "timed out while writing" };
+        }
+
+        auto n = ::send(fd, text.data() + written, text.size() - written,
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+
+        if (n <= 0) {
+            throw MetricsExporter::Error { std::string { "failed to write: " }
+                                           + std::strerror(errno) };
+        }
+
+        written += static_cast<size_t>(n);
+    }
+}
+
+#endif  // _WIN32
+
+MetricsExporter::MetricsExporter(std::shared_ptr<AgentMetrics> metrics_ptr,
+                                 const std::string& textfile_path,
+                                 uint32_t interval_s,
+                                 const std::string& socket_path)
+        : metrics_ptr_ { metrics_ptr },
+          textfile_path_ { textfile_path },
+          interval_s_ { interval_s },
+          socket_path_ { socket_path },
+          socket_fd_ { -1 },
+          stopping_ { false },
+          mutex_ {},
+          cond_var_ {},
+          exporter_thread_ {} {
+    if (!socket_path_.empty()) {
+#ifdef _WIN32
+        throw Error { "serving the metrics on a socket is not supported on "
+                      "Windows" };
+#else
+        socket_fd_ = listenOn(socket_path_);
+        LOG_INFO("Serving the metrics on %1%", socket_path_);
+#endif
+    }
+
+    if (!textfile_path_.empty() || socket_fd_ >= 0) {
+        exporter_thread_ = pcp_util::thread(&MetricsExporter::exporterTask, this);
+    }
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        cond_var_.notify_one();
+    }
+
+    if (exporter_thread_.joinable()) {
+        exporter_thread_.join();
+    }
+
+#ifndef _WIN32
+    if (socket_fd_ >= 0) {
+        ::close(socket_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+#endif
+}
+
+void MetricsExporter::writeTextfile() {
+    try {
+        lth_file::atomic_write_to_file(metrics_ptr_->getPrometheusText(),
+                                       textfile_path_);
+    } catch (const std::exception& e) {
+        throw Error { "failed to write '" + textfile_path_ + "': " + e.what() };
+    }
+}
+
+//
+// Private interface
+//
+
+void MetricsExporter::exporterTask() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+    auto next_write = pcp_util::chrono::system_clock::now();
+
+    while (!stopping_) {
+        if (!textfile_path_.empty()
+                && pcp_util::chrono::system_clock::now() >= next_write) {
+            the_lock.unlock();
+
+            try {
+                writeTextfile();
+            } catch (const Error& e) {
+                LOG_WARNING("Failed to export the metrics: %1%", e.what());
+            }
+
+            the_lock.lock();
+            next_write = pcp_util::chrono::system_clock::now()
+                         + pcp_util::chrono::seconds(interval_s_);
+            continue;
+        }
+
+        if (socket_fd_ >= 0) {
+            // NB: the stop flag is checked between polls
+            the_lock.unlock();
+            serveClient(METRICS_POLL_INTERVAL_MS);
+            the_lock.lock();
+        } else {
+            cond_var_.wait_until(the_lock, next_write);
+        }
+    }
+}
+
+#ifdef _WIN32
+
+void MetricsExporter::serveClient(uint32_t) {
+}
+
+#else
+
+void MetricsExporter::serveClient(uint32_t timeout_ms) {
+    pollfd listening { socket_fd_, POLLIN, 0 };
+
+    if (::poll(&listening, 1, static_cast<int>(timeout_ms)) <= 0) {
+        return;
+    }
+
+    auto client_fd = ::accept(socket_fd_, nullptr, nullptr);
+
+    if (client_fd < 0) {
+        LOG_DEBUG("Failed to accept a metrics client: %1%", std::strerror(errno));
+        return;
+    }
+
+    try {
+        // NB: the request is not parsed; only its method matters
+        std::string request {};
+        pollfd client { client_fd, POLLIN, 0 };
+
+        if (::poll(&client, 1, static_cast<int>(METRICS_CLIENT_TIMEOUT_MS)) > 0) {
+            char buffer[1024];
+            auto n = ::recv(client_fd, buffer, sizeof(buffer), 0);
+
+            if (n > 0) {
+                request.assign(buffer, static_cast<size_t>(n));
+            }
+        }
+
+        auto text = metrics_ptr_->getPrometheusText();
+
+        if (request.compare(0, 4, "GET ") == 0) {
+            text = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + std::to_string(text.size()) + "\r\n"
+                   "\r\n" + text;
+        }
+
+        writeAll(client_fd, text, METRICS_CLIENT_TIMEOUT_MS);
+    } catch (const Error& e) {
+        LOG_DEBUG("Failed to serve a metrics client: %1%", e.what());
+    }
+
+    ::close(client_fd);
+}
+
+#endif  // _WIN32
+
+}  // namespace PXPAgent
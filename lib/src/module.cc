@@ -10,7 +10,9 @@ namespace PXPAgent {
 
 Module::Module()
         : input_validator_ {},
-          output_validator_ {} {
+          output_validator_ {},
+          compiled_input_schemas_ {},
+          compiled_output_schemas_ {} {
 }
 
 bool Module::hasAction(const std::string& action_name) {
@@ -21,22 +23,26 @@ bool Module::hasAction(const std::string& action_name) {
 ActionOutcome Module::executeAction(const ActionRequest& request) {
     try {
         // Execute action
+        request.stamp(RequestTimeline::Event::Started);
         auto outcome = callAction(request);
 
-        // Validate action output
-        LOG_DEBUG("Validating the result output for '%1% %2%'",
-                  module_name, request.action());
-        try {
-            output_validator_.validate(outcome.results, request.action());
-        } catch (PCPClient::validation_error) {
-            std::string err_msg { "'" + module_name + " " + request.action()
-                                  + "' returned an invalid result" };
-            if (!outcome.std_err.empty()) {
-                err_msg += " - stderr: " + outcome.std_err;
+        // Validate action output, unless done while parsing it
+        if (!outcome.validated) {
+            LOG_DEBUG("Validating the result output for '%1% %2%'",
+                      module_name, request.action());
+            try {
+                validateOutput(outcome.results, request.action());
+            } catch (PCPClient::validation_error) {
+                std::string err_msg { "'" + module_name + " " + request.action()
+                                      + "' returned an invalid result" };
+                if (!outcome.std_err.empty()) {
+                    err_msg += " - stderr: " + outcome.std_err;
+                }
+                throw Module::ProcessingError { err_msg + outcome.std_err };
             }
-            throw Module::ProcessingError { err_msg + outcome.std_err };
         }
 
+        request.stamp(RequestTimeline::Event::OutputValidated);
         return outcome;
     } catch (Module::ProcessingError) {
         throw;
@@ -53,4 +59,37 @@ ActionOutcome Module::executeAction(const ActionRequest& request) {
     }
 }
 
+void Module::validateInput(const lth_jc::JsonContainer& params,
+                           const std::string& action_name) const {
+    auto schema_it = compiled_input_schemas_.find(action_name);
+    validateWith(schema_it != compiled_input_schemas_.end() ? &schema_it->second
+                                                            : nullptr,
+                 input_validator_, params, action_name);
+}
+
+void Module::validateOutput(const lth_jc::JsonContainer& results,
+                            const std::string& action_name) const {
+    auto schema_it = compiled_output_schemas_.find(action_name);
+    validateWith(schema_it != compiled_output_schemas_.end() ? &schema_it->second
+                                                             : nullptr,
+                 output_validator_, results, action_name);
+}
+
+void Module::validateWith(const CompiledSchema* schema,
+                          const PCPClient::Validator& validator,
+                          const lth_jc::JsonContainer& data,
+                          const std::string& action_name) {
+    if (schema == nullptr) {
+        // NB: the registered schemas have the same name as the action
+        validator.validate(data, action_name);
+        return;
+    }
+
+    std::string error;
+
+    if (!schema->validate(data, error)) {
+        throw PCPClient::validation_error { error };
+    }
+}
+
 }  // namespace PXPAgent
@@ -15,10 +15,17 @@ Echo::Echo() {
 
     input_validator_.registerSchema(input_schema);
     output_validator_.registerSchema(output_schema);
+
+    CompiledSchema compiled_input_schema {};
+    compiled_input_schema.addConstraint("argument",
+                                        PCPClient::TypeConstraint::String,
+                                        true);
+    compiled_input_schemas_.emplace(ECHO, compiled_input_schema);
+    compiled_output_schemas_.emplace(ECHO, CompiledSchema {});
 }
 
 ActionOutcome Echo::callAction(const ActionRequest& request) {
-    auto params = request.params();
+    const auto& params = request.params();
 
     assert(params.includes("argument")
            && params.type("argument") == lth_jc::DataType::String);
@@ -26,7 +33,7 @@ ActionOutcome Echo::callAction(const ActionRequest& request) {
     lth_jc::JsonContainer results {};
     results.set<std::string>("outcome", params.get<std::string>("argument"));
 
-    return ActionOutcome { EXIT_SUCCESS, results };
+    return ActionOutcome { EXIT_SUCCESS, std::move(results) };
 }
 
 }  // namespace Modules
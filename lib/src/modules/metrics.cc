@@ -0,0 +1,28 @@
+#include <pxp-agent/modules/metrics.hpp>
+
+namespace PXPAgent {
+namespace Modules {
+
+static const std::string METRICS { "metrics" };
+static const std::string QUERY { "query" };
+
+Metrics::Metrics(std::shared_ptr<AgentMetrics> metrics_ptr)
+        : metrics_ptr_ { metrics_ptr } {
+    module_name = METRICS;
+    actions.push_back(QUERY);
+    PCPClient::Schema input_schema { QUERY };
+    PCPClient::Schema output_schema { QUERY };
+
+    input_validator_.registerSchema(input_schema);
+    output_validator_.registerSchema(output_schema);
+
+    compiled_input_schemas_.emplace(QUERY, CompiledSchema {});
+    compiled_output_schemas_.emplace(QUERY, CompiledSchema {});
+}
+
+ActionOutcome Metrics::callAction(const ActionRequest&) {
+    return ActionOutcome { EXIT_SUCCESS, metrics_ptr_->getReport() };
+}
+
+}  // namespace Modules
+}  // namespace PXPAgent
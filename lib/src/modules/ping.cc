@@ -24,17 +24,23 @@ Ping::Ping() {
 
     input_validator_.registerSchema(input_schema);
     output_validator_.registerSchema(output_schema);
+
+    CompiledSchema compiled_input_schema {};
+    compiled_input_schema.addConstraint("sender_timestamp",
+                                        PCPClient::TypeConstraint::String);
+    compiled_input_schemas_.emplace(PING, compiled_input_schema);
+    compiled_output_schemas_.emplace(PING, CompiledSchema {});
 }
 
 lth_jc::JsonContainer Ping::ping(const ActionRequest& request) {
     lth_jc::JsonContainer data {};
 
-    if (request.parsedChunks().debug.empty()) {
+    if (request.debug()->empty()) {
         LOG_ERROR("Found no debug entry in the request message");
         throw Module::ProcessingError { "no debug entry" };
     }
 
-    auto& debug_entry = request.parsedChunks().debug[0];
+    auto& debug_entry = request.debug()->front();
 
     try {
         data.set<std::vector<lth_jc::JsonContainer>>(
@@ -1,6 +1,7 @@
 #include <pxp-agent/modules/status.hpp>
 #include <pxp-agent/util/process.hpp>
 #include <pxp-agent/external_module.hpp>    // readNonBlockingOutcome
+#include <pxp-agent/spool_layout.hpp>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -12,6 +13,7 @@
 
 #include <horsewhisperer/horsewhisperer.h>
 
+#include <sstream>
 #include <string>
 #include <stdexcept>
 
@@ -29,7 +31,16 @@ const std::string Status::SUCCESS { "success" };
 const std::string Status::FAILURE { "failure" };
 const std::string Status::RUNNING { "running" };
 
-Status::Status() {
+Status::Status()
+        : Status(nullptr) {
+}
+
+Status::Status(std::shared_ptr<MetadataWriter> metadata_writer_ptr,
+               std::shared_ptr<JobArchive> archive_ptr,
+               std::shared_ptr<JobIndex> index_ptr)
+        : metadata_writer_ptr_ { metadata_writer_ptr },
+          archive_ptr_ { archive_ptr },
+          index_ptr_ { index_ptr } {
     module_name = "status";
     actions.push_back(QUERY);
     PCPClient::Schema input_schema { QUERY };
@@ -39,6 +50,13 @@ Status::Status() {
     PCPClient::Schema output_schema { QUERY };
     input_validator_.registerSchema(input_schema);
     output_validator_.registerSchema(output_schema);
+
+    CompiledSchema compiled_input_schema {};
+    compiled_input_schema.addConstraint("transaction_id",
+                                        PCPClient::TypeConstraint::String,
+                                        true);
+    compiled_input_schemas_.emplace(QUERY, compiled_input_schema);
+    compiled_output_schemas_.emplace(QUERY, CompiledSchema {});
 }
 
 class ActionMetadata {
@@ -49,23 +67,53 @@ class ActionMetadata {
 
     int exitcode;
     bool completed;
+    bool interrupted;
 
     ActionMetadata() {
     }
 
-    ActionMetadata(const std::string& file_)
+    ActionMetadata(const std::string& file_,
+                   std::shared_ptr<MetadataWriter> writer_ptr)
             : exitcode {},
               completed { false },
+              interrupted { false },
               file { file_ } {
-        if (!fs::exists(file)) {
-            throw Error { "file does not exist" };
-        }
-
         std::string txt;
-        if (!lth_file::read(file, txt)) {
-            throw Error { "failed to read" };
+
+        if (writer_ptr) {
+            // Includes the updates not written yet
+            if (!writer_ptr->read(file, txt)) {
+                throw Error { "failed to read" };
+            }
+        } else {
+            if (!fs::exists(file)) {
+                throw Error { "file does not exist" };
+            }
+
+            if (!lth_file::read(file, txt)) {
+                throw Error { "failed to read" };
+            }
         }
 
+        parse(txt);
+    }
+
+    /// Parse the metadata of an archived job
+    static ActionMetadata fromContent(const std::string& job_id,
+                                      const std::string& txt) {
+        ActionMetadata metadata {};
+        metadata.exitcode = 0;
+        metadata.completed = false;
+        metadata.interrupted = false;
+        metadata.file = "archived job " + job_id;
+        metadata.parse(txt);
+        return metadata;
+    }
+
+  private:
+    std::string file;
+
+    void parse(const std::string& txt) {
         try {
             lth_jc::JsonContainer entries { txt };
 
@@ -75,6 +123,10 @@ class ActionMetadata {
                 throw Error { "invalid content; missing 'completed' entry" };
             }
 
+            if (entries.includes("interrupted")) {
+                interrupted = entries.get<bool>("interrupted");
+            }
+
             if (completed) {
                 if (entries.includes("exitcode")) {
                     exitcode = entries.get<int>("exitcode");
@@ -88,9 +140,6 @@ class ActionMetadata {
             throw Error { std::string("invalid content format: ") + txt };
         }
     }
-
-  private:
-    std::string file;
 };
 
 //
@@ -108,7 +157,7 @@ class ActionMetadata {
 // |+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++|
 // |   yes   |    no    |    no    |     -     |       unknown       |
 // |+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++|
-// |   yes   |    no    |    yes   |    yes    |       running       |
+// |   yes   |    no    |    yes   |  yes (**)|       running       |
 // |+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++|
 // |   yes   |    no    |    yes   |    no     |       unknown       |
 // |         |          |          |           | + stdout & stderr   |
@@ -116,19 +165,44 @@ class ActionMetadata {
 // |   yes   |    yes   |     -    |     -     |  success / failure  |
 // |         |          |          |           | + stdout & stderr   |
 // |+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++|
+// |   yes   |  yes (*) |     -    |     -     |       unknown       |
+// |         |          |          |           | + stdout & stderr   |
+// |+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++|
+//
+// (*) flagged as interrupted by SpoolRecovery
+// (**) with the start time stored in the PID file, if any
+//
+// The PID of indexed jobs is not checked; the JobIndex holds the jobs
+// in progress, so they're running.
 //
 
 ActionOutcome Status::callAction(const ActionRequest& request) {
     lth_jc::JsonContainer results {};
     auto t_id = request.params().get<std::string>("transaction_id");
-    fs::path spool_path { HW::GetFlag<std::string>("spool-dir") };
-    auto results_dir_path = spool_path / t_id;
+    JobIndex::Entry index_entry {};
+    auto indexed = index_ptr_ && index_ptr_->find(t_id, index_entry);
+    fs::path results_dir_path {
+        indexed ? index_entry.job_dir
+                : SpoolLayout::findJobDir(HW::GetFlag<std::string>("spool-dir"),
+                                          t_id) };
     results.set<std::string>("transaction_id", t_id);
     results.set<std::string>("status", Status::UNKNOWN);
 
     if (!fs::exists(results_dir_path)) {
+        JobArchive::Record record {};
+
+        try {
+            if (archive_ptr_ && archive_ptr_->find(t_id, record)) {
+                return getArchivedOutcome(t_id, record, results);
+            }
+        } catch (const JobArchive::Error& e) {
+            LOG_ERROR("Cannot retrieve the archived results of job %1%: %2%",
+                      t_id, e.what());
+            return ActionOutcome { EXIT_SUCCESS, std::move(results) };
+        }
+
         LOG_DEBUG("Found no results for job %1%", t_id);
-        return ActionOutcome { EXIT_SUCCESS, results };
+        return ActionOutcome { EXIT_SUCCESS, std::move(results) };
     }
 
     LOG_DEBUG("Retrieving results for job %1% from %2%",
@@ -138,20 +212,28 @@ ActionOutcome Status::callAction(const ActionRequest& request) {
     ActionMetadata metadata {};
 
     try {
-        metadata = ActionMetadata(metadata_file);
+        metadata = ActionMetadata(metadata_file, metadata_writer_ptr_);
     } catch (const ActionMetadata::Error& e) {
         // The file may not exist, may not be readable, or contain
         // invalid JSON - return "unknown"
         LOG_ERROR("Cannot retrieve metadata from %1%: %2%", metadata_file, e.what());
-        return ActionOutcome { EXIT_SUCCESS, results };
+        return ActionOutcome { EXIT_SUCCESS, std::move(results) };
     }
 
     bool not_running_by_pid { false };
 
-    if (metadata.completed) {
+    if (metadata.completed && metadata.interrupted) {
+        // The outcome of the job could not be determined; see
+        // SpoolRecovery - leave it 'unknown'
+        LOG_DEBUG("Job %1% was interrupted", t_id);
+    } else if (metadata.completed) {
         results.set<std::string>(
             "status",
             (metadata.exitcode == EXIT_SUCCESS ? Status::SUCCESS : Status::FAILURE));
+    } else if (indexed) {
+        // NB: jobs are removed from the index once their metadata
+        // is finalized
+        results.set<std::string>("status", Status::RUNNING);
     } else {
         // The metadata does not report the task as completed, but it
         // may be due to a previous pxp-agent crash; if the PID file
@@ -167,22 +249,30 @@ ActionOutcome Status::callAction(const ActionRequest& request) {
         } else if (pid_txt.empty()) {
             LOG_ERROR("PID file '%1%' is empty", pid_file);
         } else {
-            try {
-                pid = std::stoi(pid_txt);
+            // The start time of the process follows the PID, if
+            // stored; it guards against recycled PIDs
+            std::istringstream pid_stream { pid_txt };
+            uint64_t start_time { 0 };
+
+            if (!(pid_stream >> pid)) {
+                // We didn't manage to get the PID and the metadata
+                // file does not report the action as completed; we
+                // cannot determine the state, so leave it 'unknown'
+                LOG_ERROR("Invalid value '%1%' stored in PID file '%2%'",
+                          pid_txt, pid_file);
+            } else {
+                if (!(pid_stream >> start_time)) {
+                    start_time = 0;
+                }
+
                 // NOTE(ale): processExists() does not throw
-                if (Util::processExists(pid)) {
+                if (Util::processExists(pid, start_time)) {
                     results.set<std::string>("status", Status::RUNNING);
                 } else {
                     // We know that the process is not running, but
                     // its status is 'unknown'
                     not_running_by_pid = true;
                 }
-            } catch (const std::invalid_argument& e) {
-                // We didn't manage to get the PID and the metadata
-                // file does not report the action as completed; we
-                // cannot determine the state, so leave it 'unknown'
-                LOG_ERROR("Invalid value '%1%' stored in PID file '%2%'",
-                          pid_txt, pid_file);
             }
         }
     }
@@ -212,7 +302,36 @@ ActionOutcome Status::callAction(const ActionRequest& request) {
         results.set<std::string>("stderr", e);
     }
 
-    return ActionOutcome { EXIT_SUCCESS, results };
+    return ActionOutcome { EXIT_SUCCESS, std::move(results) };
+}
+
+ActionOutcome Status::getArchivedOutcome(const std::string& job_id,
+                                         const JobArchive::Record& record,
+                                         lth_jc::JsonContainer& results) {
+    LOG_DEBUG("Retrieving results for job %1% from the archive", job_id);
+
+    try {
+        auto metadata = ActionMetadata::fromContent(job_id, record.metadata);
+
+        // NB: only completed jobs are archived
+        if (metadata.completed && metadata.interrupted) {
+            results.set<int>("exitcode", metadata.exitcode);
+            results.set<std::string>("stdout", record.stdout_txt);
+            results.set<std::string>("stderr", record.stderr_txt);
+        } else if (metadata.completed) {
+            results.set<std::string>(
+                "status",
+                (metadata.exitcode == EXIT_SUCCESS ? Status::SUCCESS
+                                                   : Status::FAILURE));
+            results.set<int>("exitcode", metadata.exitcode);
+            results.set<std::string>("stdout", record.stdout_txt);
+            results.set<std::string>("stderr", record.stderr_txt);
+        }
+    } catch (const ActionMetadata::Error& e) {
+        LOG_ERROR("Invalid archived metadata of job %1%: %2%", job_id, e.what());
+    }
+
+    return ActionOutcome { EXIT_SUCCESS, std::move(results) };
 }
 
 }  // namespace Modules
@@ -0,0 +1,452 @@
+#include <pxp-agent/outbound_queue.hpp>
+
+#include <cpp-pcp-client/connector/errors.hpp>
+
+#include <leatherman/util/strings.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.outbound_queue"
+#include <leatherman/logging/logging.hpp>
+
+#include <algorithm>  // find, min
+#include <iterator>   // prev
+#include <utility>    // move
+
+namespace PXPAgent {
+
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+OutboundQueue::OutboundQueue(SendFunction send_function,
+                             uint64_t max_size_bytes,
+                             uint32_t ttl_s,
+                             uint32_t min_backoff_ms,
+                             UndeliveredFunction undelivered_function,
+                             IdleFunction idle_function)
+        : send_function_ { send_function },
+          undelivered_function_ { undelivered_function },
+          idle_function_ { idle_function },
+          max_size_bytes_ { max_size_bytes },
+          ttl_s_ { ttl_s },
+          min_backoff_ms_ { min_backoff_ms },
+          batch_options_ { 0, 0, {}, nullptr },
+          entries_ {},
+          target_entries_ {},
+          next_order_ { 0 },
+          queued_size_ { 0 },
+          num_dropped_ { 0 },
+          stopping_ { false },
+          mutex_ {},
+          sender_cond_var_ {},
+          flushed_cond_var_ {},
+          room_cond_var_ {},
+          send_latency_ {},
+          sender_thread_ { &OutboundQueue::senderTask, this } {
+}
+
+OutboundQueue::~OutboundQueue() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        sender_cond_var_.notify_one();
+        room_cond_var_.notify_all();
+    }
+
+    if (sender_thread_.joinable()) {
+        sender_thread_.join();
+    }
+}
+
+void OutboundQueue::enableBatching(BatchOptions options) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    batch_options_ = std::move(options);
+}
+
+bool OutboundQueue::push(Message&& msg, uint32_t timeout_ms) {
+    // NB: serializing the data outside the lock
+    if (msg.data_txt.empty()) {
+        msg.data_txt = msg.data.toString();
+    }
+
+    auto size = msg.data_txt.size();
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    // A message larger than the limit is accepted if the queue is
+    // empty, as it would be rejected forever otherwise
+    auto isFull = [&]() {
+        return max_size_bytes_ > 0 && !entries_.empty()
+               && queued_size_ + size > max_size_bytes_;
+    };
+
+    if (isFull() && timeout_ms > 0) {
+        auto deadline = pcp_util::chrono::system_clock::now()
+                        + pcp_util::chrono::milliseconds(timeout_ms);
+
+        while (!stopping_ && isFull()
+                && pcp_util::chrono::system_clock::now() < deadline) {
+            room_cond_var_.wait_until(the_lock, deadline);
+        }
+    }
+
+    if (isFull()) {
+        num_dropped_++;
+        return false;
+    }
+
+    auto now = pcp_util::chrono::system_clock::now();
+    entries_.push_back(Entry { std::move(msg),
+                               size,
+                               now,
+                               now + pcp_util::chrono::seconds(ttl_s_),
+                               false,
+                               next_order_++ });
+    target_entries_[entries_.back().msg.targets].push_back(
+        std::prev(entries_.end()));
+    queued_size_ += size;
+    sender_cond_var_.notify_one();
+    return true;
+}
+
+bool OutboundQueue::flush(uint32_t timeout_ms) {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+    auto deadline = pcp_util::chrono::system_clock::now()
+                    + pcp_util::chrono::milliseconds(timeout_ms);
+
+    while (!entries_.empty()
+            && pcp_util::chrono::system_clock::now() < deadline) {
+        flushed_cond_var_.wait_until(the_lock, deadline);
+    }
+
+    return entries_.empty();
+}
+
+size_t OutboundQueue::getNumQueued() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return entries_.size();
+}
+
+uint64_t OutboundQueue::getNumDropped() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return num_dropped_;
+}
+
+const Histogram& OutboundQueue::getSendLatency() const {
+    return send_latency_;
+}
+
+//
+// Private interface
+//
+
+void OutboundQueue::senderTask() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+    uint32_t backoff_ms { 0 };
+
+    while (true) {
+        if (!stopping_ && entries_.empty() && idle_function_) {
+            // NB: the idle function may queue further messages
+            the_lock.unlock();
+            idle_function_();
+            the_lock.lock();
+        }
+
+        if (!stopping_ && entries_.empty()) {
+            if (idle_function_) {
+                sender_cond_var_.wait_until(
+                    the_lock,
+                    pcp_util::chrono::system_clock::now()
+                        + pcp_util::chrono::milliseconds(OUTBOUND_IDLE_INTERVAL_MS));
+            } else {
+                sender_cond_var_.wait(the_lock);
+            }
+            continue;
+        }
+
+        if (stopping_) {
+            break;
+        }
+
+        auto expired = takeExpired();
+
+        if (!expired.empty()) {
+            the_lock.unlock();
+            auto num_dropped = handOver(expired, "it could not be sent in "
+                                                 + std::to_string(ttl_s_) + " s");
+            the_lock.lock();
+            num_dropped_ += num_dropped;
+        }
+
+        if (entries_.empty()) {
+            backoff_ms = 0;
+            continue;
+        }
+
+        auto wake_up = pcp_util::chrono::system_clock::time_point::max();
+        auto it = findReady(wake_up);
+
+        if (it == entries_.end()) {
+            // All messages are waiting for further ones to join them
+            sender_cond_var_.wait_until(the_lock, wake_up);
+            continue;
+        }
+
+        if (batch_options_.max_delay_ms > 0 && isBatchable(*it)) {
+            it = makeBatch(it);
+        }
+
+        // NB: entries are removed only by this thread, and the list
+        // does not move its elements when others are added, so the
+        // entry can be sent without holding the lock
+        const auto& entry = *it;
+        bool retry { false };
+        std::string error {};
+
+        the_lock.unlock();
+
+        try {
+            send_function_(entry.msg);
+        } catch (const PCPClient::connection_error& e) {
+            retry = true;
+            error = e.what();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        the_lock.lock();
+
+        if (!retry) {
+            if (error.empty()) {
+                LOG_DEBUG("Sent the %1%", entry.msg.description);
+                auto latency = pcp_util::chrono::system_clock::now() - entry.queued;
+                send_latency_.record(static_cast<uint64_t>(std::max<int64_t>(
+                    pcp_util::chrono::duration_cast<pcp_util::chrono::microseconds>(
+                        latency).count(), 0)));
+            } else {
+                LOG_ERROR("Failed to send the %1% (no further attempts): %2%",
+                          entry.msg.description, error);
+                num_dropped_++;
+            }
+
+            removeAt(it);
+            backoff_ms = 0;
+            continue;
+        }
+
+        if (entry.msg.persistent && undelivered_function_) {
+            // Hand it over instead of retrying, so that the following
+            // messages are not held back
+            std::vector<Message> undelivered {};
+            undelivered.push_back(takeAt(it));
+            the_lock.unlock();
+            auto num_dropped = handOver(undelivered, error);
+            the_lock.lock();
+            num_dropped_ += num_dropped;
+            continue;
+        }
+
+        backoff_ms = (backoff_ms == 0
+                      ? min_backoff_ms_
+                      : std::min(2 * backoff_ms, OUTBOUND_MAX_BACKOFF_MS));
+        LOG_WARNING("Failed to send the %1%; will retry in %2% ms: %3%",
+                    entry.msg.description, backoff_ms, error);
+        auto deadline = pcp_util::chrono::system_clock::now()
+                        + pcp_util::chrono::milliseconds(backoff_ms);
+
+        while (!stopping_ && pcp_util::chrono::system_clock::now() < deadline) {
+            sender_cond_var_.wait_until(the_lock, deadline);
+        }
+    }
+
+    if (!entries_.empty()) {
+        std::vector<Message> pending {};
+
+        while (!entries_.empty()) {
+            pending.push_back(takeAt(entries_.begin()));
+        }
+
+        the_lock.unlock();
+        auto num_dropped = handOver(pending, "pxp-agent is stopping");
+        the_lock.lock();
+        num_dropped_ += num_dropped;
+    }
+}
+
+std::vector<OutboundQueue::Message> OutboundQueue::takeExpired() {
+    std::vector<Message> expired {};
+
+    if (ttl_s_ == 0) {
+        return expired;
+    }
+
+    auto now = pcp_util::chrono::system_clock::now();
+
+    while (!entries_.empty() && entries_.front().expiry <= now) {
+        expired.push_back(takeAt(entries_.begin()));
+    }
+
+    return expired;
+}
+
+uint32_t OutboundQueue::handOver(const std::vector<Message>& messages,
+                                 const std::string& reason) {
+    uint32_t num_dropped { 0 };
+
+    for (const auto& msg : messages) {
+        if (msg.persistent && undelivered_function_ && undelivered_function_(msg)) {
+            LOG_INFO("Stored the undelivered %1% (%2%)", msg.description, reason);
+        } else {
+            LOG_ERROR("Dropping the %1%: %2%", msg.description, reason);
+            num_dropped++;
+        }
+    }
+
+    return num_dropped;
+}
+
+void OutboundQueue::removeAt(EntryIterator it) {
+    unindex(it);
+    eraseEntry(it);
+}
+
+OutboundQueue::Message OutboundQueue::takeAt(EntryIterator it) {
+    unindex(it);
+    auto msg = std::move(it->msg);
+    eraseEntry(it);
+    return msg;
+}
+
+void OutboundQueue::unindex(EntryIterator it) {
+    auto targets_it = target_entries_.find(it->msg.targets);
+    auto& target_entries = targets_it->second;
+
+    // NB: usually the first one
+    target_entries.erase(std::find(target_entries.begin(), target_entries.end(), it));
+
+    if (target_entries.empty()) {
+        target_entries_.erase(targets_it);
+    }
+}
+
+void OutboundQueue::eraseEntry(EntryIterator it) {
+    queued_size_ -= it->size;
+    entries_.erase(it);
+    room_cond_var_.notify_all();
+
+    if (entries_.empty()) {
+        flushed_cond_var_.notify_all();
+    }
+}
+
+bool OutboundQueue::isBatchable(const Entry& entry) const {
+    // NB: a stored message is handed back to the outbox on its own
+    return !entry.batched
+           && entry.msg.outbox_sequence_number == 0
+           && entry.msg.targets.size() == 1
+           && batch_options_.message_types.count(entry.msg.message_type) > 0;
+}
+
+std::vector<OutboundQueue::EntryIterator> OutboundQueue::findBatch(
+        EntryIterator first, bool& open) const {
+    std::vector<EntryIterator> batch {};
+    open = true;
+
+    // NB: messages to the same target can't overtake each other
+    for (auto it : target_entries_.at(first->msg.targets)) {
+        if (!isBatchable(*it)) {
+            open = false;
+            break;
+        }
+
+        batch.push_back(it);
+
+        if (batch.size() >= batch_options_.max_messages) {
+            open = false;
+            break;
+        }
+    }
+
+    return batch;
+}
+
+OutboundQueue::EntryIterator OutboundQueue::findReady(
+        pcp_util::chrono::system_clock::time_point& wake_up) {
+    if (batch_options_.max_delay_ms == 0) {
+        return entries_.begin();
+    }
+
+    auto now = pcp_util::chrono::system_clock::now();
+    auto ready = entries_.end();
+
+    for (const auto& target_entries : target_entries_) {
+        auto first = target_entries.second.front();
+
+        if (ready != entries_.end() && ready->order < first->order) {
+            continue;
+        }
+
+        if (!isBatchable(*first)) {
+            ready = first;
+            continue;
+        }
+
+        bool open;
+        findBatch(first, open);
+        auto due = first->queued
+                   + pcp_util::chrono::milliseconds(batch_options_.max_delay_ms);
+
+        if (!open || due <= now) {
+            ready = first;
+            continue;
+        }
+
+        wake_up = std::min(wake_up, due);
+    }
+
+    return ready;
+}
+
+OutboundQueue::EntryIterator OutboundQueue::makeBatch(EntryIterator first) {
+    bool open;
+    auto batch = findBatch(first, open);
+
+    if (batch.size() < 2) {
+        first->batched = true;
+        return first;
+    }
+
+    auto targets_it = target_entries_.find(first->msg.targets);
+    std::vector<Message> messages {};
+    size_t size { 0 };
+    auto expiry = first->expiry;
+
+    for (auto it : batch) {
+        messages.push_back(std::move(it->msg));
+        size += it->size;
+        expiry = std::min(expiry, it->expiry);
+    }
+
+    LOG_TRACE("Batching %1% messages to %2%",
+              messages.size(), messages.front().targets.front());
+    auto batch_it = entries_.insert(
+        first,
+        Entry { batch_options_.batch_function(std::move(messages)),
+                size,
+                pcp_util::chrono::system_clock::now(),
+                expiry,
+                true,
+                first->order });
+
+    // NB: the batched messages are the first ones to their target
+    auto& target_entries = targets_it->second;
+    target_entries.erase(target_entries.begin(),
+                         target_entries.begin()
+                             + static_cast<std::ptrdiff_t>(batch.size()));
+    target_entries.push_front(batch_it);
+
+    for (auto it : batch) {
+        entries_.erase(it);
+    }
+
+    return batch_it;
+}
+
+}  // namespace PXPAgent
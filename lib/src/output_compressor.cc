@@ -0,0 +1,210 @@
+#include <pxp-agent/output_compressor.hpp>
+#include <pxp-agent/util/sync_file.hpp>
+
+#include <leatherman/file_util/file.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.output_compressor"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+namespace lth_file = leatherman::file_util;
+namespace pcp_util = PCPClient::Util;
+
+static const std::vector<std::string> OUTPUT_FILE_NAMES { "stdout", "stderr" };
+
+OutputCompressor::OutputCompressor(uint64_t min_size)
+        : min_size_ { min_size },
+          job_dirs_ {},
+          stopping_ { false },
+          mutex_ {},
+          cond_var_ {},
+          worker_thread_ { &OutputCompressor::workerTask, this } {
+}
+
+OutputCompressor::~OutputCompressor() {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        stopping_ = true;
+        cond_var_.notify_one();
+    }
+
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
+    }
+}
+
+void OutputCompressor::compress(const std::string& job_dir) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    job_dirs_.push_back(job_dir);
+    cond_var_.notify_one();
+}
+
+bool OutputCompressor::compressFile(const std::string& file_path,
+                                    uint64_t min_size) {
+    if (!fs::exists(file_path) || fs::file_size(file_path) < min_size) {
+        return false;
+    }
+
+    auto compressed_path = file_path + COMPRESSED_FILE_SUFFIX;
+    auto tmp_path = compressed_path + ".tmp";
+
+    try {
+        io::file_source source { file_path, std::ios_base::binary };
+        if (!source.is_open()) {
+            throw std::runtime_error { "failed to open " + file_path };
+        }
+
+        io::file_sink sink { tmp_path, std::ios_base::binary };
+        if (!sink.is_open()) {
+            throw std::runtime_error { "failed to open " + tmp_path };
+        }
+
+        io::filtering_ostream out {};
+        out.push(io::gzip_compressor());
+        out.push(sink);
+        io::copy(source, out);
+
+        // NB: io::copy closed the sink; the file is reopened to be
+        // synced before replacing the original one
+        auto tmp_file = std::fopen(tmp_path.data(), "ab");
+        if (tmp_file == nullptr) {
+            throw std::runtime_error { "failed to open " + tmp_path };
+        }
+
+        auto synced = Util::syncFile(tmp_file);
+        std::fclose(tmp_file);
+
+        if (!synced) {
+            throw std::runtime_error { "failed to sync " + tmp_path };
+        }
+    } catch (...) {
+        boost::system::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+
+    // NB: readers look for the compressed file first; the original
+    // file is removed only once the rename is on disk
+    fs::rename(tmp_path, compressed_path);
+
+    if (!Util::syncDirectory(fs::path(compressed_path).parent_path().string())) {
+        throw std::runtime_error { "failed to sync the directory of "
+                                   + compressed_path };
+    }
+
+    fs::remove(file_path);
+    return true;
+}
+
+bool OutputCompressor::exists(const std::string& file_path) {
+    return fs::exists(file_path + COMPRESSED_FILE_SUFFIX) || fs::exists(file_path);
+}
+
+bool OutputCompressor::read(const std::string& file_path, std::string& content) {
+    auto compressed_path = file_path + COMPRESSED_FILE_SUFFIX;
+
+    if (!fs::exists(compressed_path)) {
+        if (lth_file::read(file_path, content)) {
+            return true;
+        }
+
+        // The file may have been compressed in the meantime
+        if (!fs::exists(compressed_path)) {
+            return false;
+        }
+    }
+
+    try {
+        io::file_source source { compressed_path, std::ios_base::binary };
+        if (!source.is_open()) {
+            throw std::runtime_error { "failed to open" };
+        }
+
+        io::filtering_istream in {};
+        in.push(io::gzip_decompressor());
+        in.push(source);
+        content.clear();
+        io::copy(in, io::back_inserter(content));
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to decompress '%1%': %2%", compressed_path, e.what());
+        return false;
+    }
+}
+
+std::string OutputCompressor::compressData(const std::string& content) {
+    std::string compressed {};
+
+    {
+        // NB: the gzip trailer is written when the stream is destroyed
+        io::filtering_ostream out {};
+        out.push(io::gzip_compressor());
+        out.push(io::back_inserter(compressed));
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+    return compressed;
+}
+
+std::string OutputCompressor::decompress(const std::string& compressed) {
+    std::string content {};
+    io::filtering_istream in {};
+    in.push(io::gzip_decompressor());
+    in.push(io::array_source(compressed.data(), compressed.size()));
+    io::copy(in, io::back_inserter(content));
+    return content;
+}
+
+//
+// Private interface
+//
+
+void OutputCompressor::workerTask() {
+    pcp_util::unique_lock<pcp_util::mutex> the_lock { mutex_ };
+
+    while (true) {
+        while (!stopping_ && job_dirs_.empty()) {
+            cond_var_.wait(the_lock);
+        }
+
+        if (stopping_) {
+            break;
+        }
+
+        auto job_dir = job_dirs_.front();
+        job_dirs_.pop_front();
+        the_lock.unlock();
+
+        for (const auto& file_name : OUTPUT_FILE_NAMES) {
+            auto file_path = (fs::path(job_dir) / file_name).string();
+
+            try {
+                if (compressFile(file_path, min_size_)) {
+                    LOG_TRACE("Compressed '%1%'", file_path);
+                }
+            } catch (const std::exception& e) {
+                LOG_WARNING("Failed to compress '%1%': %2%", file_path, e.what());
+            }
+        }
+
+        the_lock.lock();
+    }
+}
+
+}  // namespace PXPAgent
@@ -1,6 +1,9 @@
 #include <pxp-agent/pxp_connector.hpp>
+#include <pxp-agent/output_compressor.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/util/base64.hpp>
 
+#include <cpp-pcp-client/connector/errors.hpp>
 #include <cpp-pcp-client/protocol/schemas.hpp>
 
 #include <leatherman/util/strings.hpp>
@@ -8,6 +11,11 @@
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.pxp_connector"
 #include <leatherman/logging/logging.hpp>
 
+#include <algorithm>  // min, max
+#include <fstream>
+#include <memory>     // make_shared
+#include <utility>    // move
+
 namespace PXPAgent {
 
 namespace lth_jc = leatherman::json_container;
@@ -15,19 +23,41 @@ namespace lth_util = leatherman::util;
 
 static const int DEFAULT_MSG_TIMEOUT_SEC { 2 };
 
-std::vector<lth_jc::JsonContainer> wrapDebug(
-        const PCPClient::ParsedChunks& parsed_chunks) {
-    auto request_id = parsed_chunks.envelope.get<std::string>("id");
-    if (parsed_chunks.num_invalid_debug) {
-        LOG_WARNING("Message %1% contained %2% bad debug chunk%3%",
-                    request_id, parsed_chunks.num_invalid_debug,
-                    lth_util::plural(parsed_chunks.num_invalid_debug));
-    }
-    std::vector<lth_jc::JsonContainer> debug {};
-    for (auto& debug_entry : parsed_chunks.debug) {
-        debug.push_back(debug_entry);
+// Time to wait for the outbound queue to have room for a fragment,
+// before aborting the stream
+static const uint32_t FRAGMENT_QUEUE_TIMEOUT_MS { 30000 };
+
+// Combine the responses to the same requester in a batch response;
+// the debug chunks of each response are kept in its entry
+static OutboundQueue::Message batchResponses(
+        std::vector<OutboundQueue::Message>&& messages) {
+    std::vector<lth_jc::JsonContainer> responses {};
+    bool persistent { false };
+
+    for (auto& msg : messages) {
+        lth_jc::JsonContainer response {};
+        response.set<std::string>("message_type", msg.message_type);
+        response.set<lth_jc::JsonContainer>("data", std::move(msg.data));
+        if (msg.debug) {
+            response.set<std::vector<lth_jc::JsonContainer>>("debug", *msg.debug);
+        }
+        responses.push_back(std::move(response));
+        persistent = persistent || msg.persistent;
     }
-    return debug;
+
+    lth_jc::JsonContainer batch_data {};
+    batch_data.set<std::vector<lth_jc::JsonContainer>>("responses", responses);
+
+    return OutboundQueue::Message {
+        messages.front().targets,
+        PXPSchemas::BATCH_RESPONSE_TYPE,
+        std::move(batch_data),
+        nullptr,
+        "batch of " + std::to_string(messages.size()) + " responses to "
+            + messages.front().targets.front(),
+        persistent,
+        0,
+        "" };
 }
 
 PXPConnector::PXPConnector(const Configuration::Agent& agent_configuration)
@@ -35,7 +65,36 @@ PXPConnector::PXPConnector(const Configuration::Agent& agent_configuration)
                                  agent_configuration.client_type,
                                  agent_configuration.ca,
                                  agent_configuration.crt,
-                                 agent_configuration.key } {
+                                 agent_configuration.key },
+          compression_threshold_ {
+              static_cast<uint64_t>(agent_configuration.result_compression_threshold)
+                  * 1024 },
+          fragment_size_ {
+              static_cast<uint64_t>(agent_configuration.result_fragment_size)
+                  * 1024 },
+          outbox_ { agent_configuration.spool_dir },
+          outbound_queue_ {
+              [this](const OutboundQueue::Message& msg) {
+                  sendQueued(msg);
+              },
+              static_cast<uint64_t>(agent_configuration.outbound_queue_size)
+                  * 1024 * 1024,
+              static_cast<uint32_t>(agent_configuration.outbound_message_ttl),
+              OUTBOUND_MIN_BACKOFF_MS,
+              [this](const OutboundQueue::Message& msg) {
+                  return storeUndelivered(msg);
+              },
+              [this]() {
+                  redeliverStored();
+              } } {
+    if (agent_configuration.response_batch_delay > 0) {
+        outbound_queue_.enableBatching(OutboundQueue::BatchOptions {
+            static_cast<uint32_t>(agent_configuration.response_batch_delay),
+            static_cast<size_t>(agent_configuration.response_batch_size),
+            { PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
+              PXPSchemas::PROVISIONAL_RESPONSE_TYPE },
+            batchResponses });
+    }
 }
 
 void PXPConnector::sendPCPError(const std::string& request_id,
@@ -60,90 +119,366 @@ void PXPConnector::sendPCPError(const std::string& request_id,
 
 void PXPConnector::sendPXPError(const ActionRequest& request,
                                 const std::string& description) {
-    lth_jc::JsonContainer pxp_error_data {};
-    pxp_error_data.set<std::string>("transaction_id", request.transactionId());
-    pxp_error_data.set<std::string>("id", request.id());
-    pxp_error_data.set<std::string>("description", description);
-
-    try {
-        send(std::vector<std::string> { request.sender() },
-             PXPSchemas::PXP_ERROR_MSG_TYPE,
-             DEFAULT_MSG_TIMEOUT_SEC,
-             pxp_error_data);
-        LOG_INFO("Replied to %1% request %2% by %3%, transaction %4%, with "
-                 "an PXP error message", requestTypeNames[request.type()],
-                 request.id(), request.sender(), request.transactionId());
-    } catch (PCPClient::connection_error& e) {
-        LOG_ERROR("Failed to send PXP error message for %1% request %2% by "
-                  "%3%, transaction %4% (no further sending attempts): %5%",
-                  requestTypeNames[request.type()], request.id(),
-                  request.sender(), request.transactionId(), description);
-    }
+    sendPXPError(request.sender(), request.id(), request.transactionId(),
+                 description);
 }
 
 void PXPConnector::sendBlockingResponse(const ActionRequest& request,
-                                        const lth_jc::JsonContainer& results) {
-    auto debug = wrapDebug(request.parsedChunks());
+                                        lth_jc::JsonContainer&& results) {
     lth_jc::JsonContainer response_data {};
     response_data.set<std::string>("transaction_id", request.transactionId());
-    response_data.set<lth_jc::JsonContainer>("results", results);
+    auto data_txt = setResults(response_data, std::move(results),
+                               request.acceptEncoding(), request.transactionId());
 
-    try {
-        send(std::vector<std::string> { request.sender() },
-             PXPSchemas::BLOCKING_RESPONSE_TYPE,
-             DEFAULT_MSG_TIMEOUT_SEC,
-             response_data,
-             debug);
-    } catch (PCPClient::connection_error& e) {
-        LOG_ERROR("Failed to reply to blocking request %1% from %2%, "
-                  "transaction %3%: %4%", request.id(), request.sender(),
-                  request.transactionId(), e.what());
-    }
+    enqueue(OutboundQueue::Message {
+        std::vector<std::string> { request.sender() },
+        PXPSchemas::BLOCKING_RESPONSE_TYPE,
+        std::move(response_data),
+        getResponseDebug(request, true),
+        "response for blocking request " + request.id() + " by "
+            + request.sender() + ", transaction " + request.transactionId(),
+        false,
+        0,
+        std::move(data_txt) });
 }
 
 void PXPConnector::sendNonBlockingResponse(const ActionRequest& request,
-                                           const lth_jc::JsonContainer& results,
+                                           lth_jc::JsonContainer&& results,
                                            const std::string& job_id) {
+    // NOTE(ale): assuming debug was sent in provisional response
+    sendNonBlockingResponse(request.sender(), request.transactionId(),
+                            std::move(results), job_id, request.acceptEncoding(),
+                            getResponseDebug(request, false));
+}
+
+bool PXPConnector::sendFragmentedNonBlockingResponse(
+        const ActionRequest& request,
+        const std::string& results_file,
+        const std::string& job_id) {
+    if (fragment_size_ == 0) {
+        return false;
+    }
+
+    std::ifstream in { results_file, std::ios::in | std::ios::binary };
+    in.seekg(0, std::ios::end);
+    auto size = static_cast<uint64_t>(in.tellg());
+
+    if (!in || size <= fragment_size_) {
+        return false;
+    }
+
+    in.seekg(0, std::ios::beg);
+    auto num_fragments = (size + fragment_size_ - 1) / fragment_size_;
+    auto request_description = "non-blocking request " + request.id() + " by "
+                               + request.sender() + ", transaction "
+                               + request.transactionId();
+    LOG_INFO("Sending the results (%1% bytes) of %2% in %3% fragments",
+             size, request_description, num_fragments);
+
+    // NB: a single fragment is held in memory at a time; enqueue()
+    // waits for the queue to have room for it
+    std::string buffer(fragment_size_, '\0');
+
+    for (uint64_t idx = 0; idx < num_fragments; idx++) {
+        in.read(&buffer[0], static_cast<std::streamsize>(fragment_size_));
+        auto num_read = static_cast<uint64_t>(
+            std::max<std::streamsize>(in.gcount(), 0));
+
+        // NB: the file may have been truncated meanwhile
+        if (num_read != std::min(fragment_size_, size - idx * fragment_size_)) {
+            if (idx == 0) {
+                LOG_ERROR("Failed to read the results of %1% from '%2%'; sending "
+                          "them in full", request_description, results_file);
+                return false;
+            }
+
+            abortStream(request, request_description,
+                        "failed to read results fragment "
+                            + std::to_string(idx + 1) + "/"
+                            + std::to_string(num_fragments));
+        }
+
+        lth_jc::JsonContainer fragment_data {};
+        fragment_data.set<std::string>("transaction_id", request.transactionId());
+        fragment_data.set<std::string>("job_id", job_id);
+        fragment_data.set<int>("index", static_cast<int>(idx));
+        fragment_data.set<int>("num_fragments", static_cast<int>(num_fragments));
+        fragment_data.set<std::string>(
+            "data",
+            Util::base64Encode(buffer.substr(0, static_cast<size_t>(num_read))));
+
+        auto description = "results fragment " + std::to_string(idx + 1) + "/"
+                           + std::to_string(num_fragments) + " for "
+                           + request_description;
+
+        if (!enqueue(OutboundQueue::Message {
+                         std::vector<std::string> { request.sender() },
+                         PXPSchemas::RESULTS_FRAGMENT_TYPE,
+                         std::move(fragment_data),
+                         {},
+                         description,
+                         false,
+                         0,
+                         "" },
+                     FRAGMENT_QUEUE_TIMEOUT_MS)) {
+            abortStream(request, request_description,
+                        "the outbound queue has no room for " + description);
+        }
+    }
+
     lth_jc::JsonContainer response_data {};
     response_data.set<std::string>("transaction_id", request.transactionId());
     response_data.set<std::string>("job_id", job_id);
-    response_data.set<lth_jc::JsonContainer>("results", results);
+    response_data.set<int>("num_fragments", static_cast<int>(num_fragments));
 
-    try {
-        // NOTE(ale): assuming debug was sent in provisional response
-        send(std::vector<std::string> { request.sender() },
-             PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
-             DEFAULT_MSG_TIMEOUT_SEC,
-             response_data);
-        LOG_INFO("Sent response for non-blocking request %1% by %2%, "
-                 "transaction %3%", request.id(), request.sender(),
-                 request.transactionId());
-    } catch (PCPClient::connection_error& e) {
-        LOG_ERROR("Failed to reply to non-blocking request %1% by %2%, "
-                  "transaction %3% (no further attempts): %4%",
-                  request.id(), request.sender(), request.transactionId(),
-                  e.what());
-    }
+    enqueue(OutboundQueue::Message {
+                std::vector<std::string> { request.sender() },
+                PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
+                std::move(response_data),
+                getResponseDebug(request, false),
+                "response for " + request_description,
+                true,
+                0,
+                "" },
+            FRAGMENT_QUEUE_TIMEOUT_MS);
+    return true;
+}
+
+void PXPConnector::sendPXPError(const std::string& requester,
+                                const std::string& request_id,
+                                const std::string& transaction_id,
+                                const std::string& description) {
+    lth_jc::JsonContainer pxp_error_data {};
+    pxp_error_data.set<std::string>("transaction_id", transaction_id);
+    pxp_error_data.set<std::string>("id", request_id);
+    pxp_error_data.set<std::string>("description", description);
+
+    LOG_INFO("Replying to request %1% by %2%, transaction %3%, with an PXP "
+             "error message", request_id, requester, transaction_id);
+    enqueue(OutboundQueue::Message {
+        std::vector<std::string> { requester },
+        PXPSchemas::PXP_ERROR_MSG_TYPE,
+        std::move(pxp_error_data),
+        {},
+        "PXP error message for request " + request_id + " by " + requester
+            + ", transaction " + transaction_id,
+        false,
+        0,
+        "" });
+}
+
+void PXPConnector::sendNonBlockingResponse(
+        const std::string& requester,
+        const std::string& transaction_id,
+        lth_jc::JsonContainer&& results,
+        const std::string& job_id,
+        const std::string& accept_encoding,
+        std::shared_ptr<const std::vector<lth_jc::JsonContainer>> debug) {
+    lth_jc::JsonContainer response_data {};
+    response_data.set<std::string>("transaction_id", transaction_id);
+    response_data.set<std::string>("job_id", job_id);
+    auto data_txt = setResults(response_data, std::move(results),
+                               accept_encoding, transaction_id);
+
+    LOG_INFO("Sending response for non-blocking request by %1%, transaction "
+             "%2%", requester, transaction_id);
+    enqueue(OutboundQueue::Message {
+        std::vector<std::string> { requester },
+        PXPSchemas::NON_BLOCKING_RESPONSE_TYPE,
+        std::move(response_data),
+        std::move(debug),
+        "response for non-blocking request by " + requester
+            + ", transaction " + transaction_id,
+        true,
+        0,
+        std::move(data_txt) });
 }
 
 void PXPConnector::sendProvisionalResponse(const ActionRequest& request) {
-    auto debug = wrapDebug(request.parsedChunks());
     lth_jc::JsonContainer provisional_data {};
     provisional_data.set<std::string>("transaction_id", request.transactionId());
 
+    LOG_INFO("Sending provisional response for request %1% by %2%, "
+             "transaction %3%", request.id(), request.sender(),
+             request.transactionId());
+    enqueue(OutboundQueue::Message {
+        std::vector<std::string> { request.sender() },
+        PXPSchemas::PROVISIONAL_RESPONSE_TYPE,
+        std::move(provisional_data),
+        getResponseDebug(request, true),
+        "provisional response for request " + request.id() + " by "
+            + request.sender() + ", transaction " + request.transactionId(),
+        false,
+        0,
+        "" });
+}
+
+bool PXPConnector::flushOutbound(uint32_t timeout_ms) {
+    return outbound_queue_.flush(timeout_ms);
+}
+
+size_t PXPConnector::getNumQueuedMessages() {
+    return outbound_queue_.getNumQueued();
+}
+
+uint64_t PXPConnector::getNumDroppedMessages() {
+    return outbound_queue_.getNumDropped();
+}
+
+size_t PXPConnector::getNumStoredMessages() {
+    return outbox_.size();
+}
+
+const Histogram& PXPConnector::getSendLatency() const {
+    return outbound_queue_.getSendLatency();
+}
+
+//
+// Private interface
+//
+
+bool PXPConnector::enqueue(OutboundQueue::Message&& msg, uint32_t timeout_ms) {
+    // NB: the message is left untouched if rejected
+    if (outbound_queue_.push(std::move(msg), timeout_ms)) {
+        return true;
+    }
+
+    if (msg.persistent && storeUndelivered(msg)) {
+        LOG_WARNING("The outbound queue is full; stored the %1% in the outbox",
+                    msg.description);
+        return true;
+    }
+
+    LOG_ERROR("Failed to queue the %1%: the outbound queue is full (no "
+              "further attempts)", msg.description);
+    return false;
+}
+
+void PXPConnector::abortStream(const ActionRequest& request,
+                               const std::string& request_description,
+                               const std::string& reason) {
+    LOG_ERROR("Aborting the fragmented results of %1%: %2%",
+              request_description, reason);
+    sendPXPError(request, "failed to send the results: " + reason);
+    throw StreamError { reason };
+}
+
+std::string PXPConnector::setResults(lth_jc::JsonContainer& response_data,
+                                     lth_jc::JsonContainer&& results,
+                                     const std::string& accept_encoding,
+                                     const std::string& transaction_id) const {
+    if (compression_threshold_ == 0
+            || accept_encoding != PXPSchemas::GZIP_RESULTS_ENCODING) {
+        response_data.set<lth_jc::JsonContainer>("results", std::move(results));
+        return "";
+    }
+
+    auto results_txt = results.toString();
+
+    if (results_txt.size() < compression_threshold_) {
+        // NB: appending the serialized results to the other entries,
+        // as the last one, instead of serializing them again
+        auto data_txt = response_data.toString();
+        data_txt.pop_back();
+        data_txt += ",\"results\":" + results_txt + "}";
+        response_data.set<lth_jc::JsonContainer>("results", std::move(results));
+        return data_txt;
+    }
+
     try {
-        send(std::vector<std::string> { request.sender() },
-             PXPSchemas::PROVISIONAL_RESPONSE_TYPE,
-             DEFAULT_MSG_TIMEOUT_SEC,
-             provisional_data,
-             debug);
-        LOG_INFO("Sent provisional response for request %1% by %2%, "
-                 "transaction %3%", request.id(), request.sender(),
-                 request.transactionId());
-    } catch (PCPClient::connection_error& e) {
-        LOG_ERROR("Failed to send provisional response for request %1% by "
-                  "%2%, transaction %3% (no further attempts): %4%",
-                  request.id(), request.sender(), request.transactionId(), e.what());
+        auto encoded_results = Util::base64Encode(
+            OutputCompressor::compressData(results_txt));
+        LOG_DEBUG("Compressed the results of transaction %1% from %2% to %3% bytes",
+                  transaction_id, results_txt.size(), encoded_results.size());
+        response_data.set<std::string>("results_encoding",
+                                       PXPSchemas::GZIP_RESULTS_ENCODING);
+        response_data.set<std::string>("encoded_results", encoded_results);
+    } catch (const std::exception& e) {
+        LOG_WARNING("Failed to compress the results of transaction %1%; sending "
+                    "them uncompressed: %2%", transaction_id, e.what());
+        response_data.set<lth_jc::JsonContainer>("results", std::move(results));
+    }
+
+    return "";
+}
+
+std::shared_ptr<const std::vector<lth_jc::JsonContainer>>
+PXPConnector::getResponseDebug(const ActionRequest& request,
+                               bool with_request_debug) const {
+    // NB: stamped for every request, as the send latency of its
+    // action is derived from it
+    request.stamp(RequestTimeline::Event::Sent);
+
+    if (!request.timing()) {
+        return with_request_debug ? request.debug() : nullptr;
+    }
+
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    if (with_request_debug && request.debug()) {
+        debug = *request.debug();
+    }
+
+    debug.push_back(request.timeline().getDebugChunk());
+    return std::make_shared<const std::vector<lth_jc::JsonContainer>>(
+        std::move(debug));
+}
+
+void PXPConnector::sendQueued(const OutboundQueue::Message& msg) {
+    static const std::vector<lth_jc::JsonContainer> no_debug {};
+
+    try {
+        // NB: the data was serialized when queued, unless it's a batch
+        if (msg.data_txt.empty()) {
+            send(msg.targets, msg.message_type, DEFAULT_MSG_TIMEOUT_SEC,
+                 msg.data, msg.debug ? *msg.debug : no_debug);
+        } else {
+            send(msg.targets, msg.message_type, DEFAULT_MSG_TIMEOUT_SEC,
+                 msg.data_txt, msg.debug ? *msg.debug : no_debug);
+        }
+    } catch (const PCPClient::connection_error&) {
+        // NB: a stored message is handed back to the outbox
+        throw;
+    } catch (...) {
+        // The message is dropped
+        if (msg.outbox_sequence_number > 0) {
+            outbox_.remove(msg.outbox_sequence_number);
+        }
+        throw;
+    }
+
+    if (msg.outbox_sequence_number > 0) {
+        outbox_.remove(msg.outbox_sequence_number);
+    }
+}
+
+bool PXPConnector::storeUndelivered(const OutboundQueue::Message& msg) {
+    try {
+        outbox_.store(msg);
+        return true;
+    } catch (const SpoolOutbox::Error& e) {
+        LOG_ERROR("The undelivered message is lost: %1%", e.what());
+        return false;
+    }
+}
+
+void PXPConnector::redeliverStored() {
+    if (outbox_.size() == 0 || !isConnected()) {
+        return;
+    }
+
+    // NB: only the messages that are not being delivered are taken
+    auto messages = outbox_.take();
+
+    if (messages.empty()) {
+        return;
+    }
+
+    LOG_INFO("Delivering %1% message%2% stored in the outbox",
+             messages.size(), lth_util::plural(messages.size()));
+
+    for (auto& msg : messages) {
+        enqueue(std::move(msg));
     }
 }
 
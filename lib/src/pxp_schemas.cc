@@ -18,6 +18,8 @@ PCPClient::Schema BlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    schema.addConstraint("accept_encoding", T_Constraint::String, false);
+    schema.addConstraint("timing", T_Constraint::Bool, false);
     return schema;
 }
 
@@ -25,7 +27,10 @@ PCPClient::Schema BlockingResponseSchema() {
     PCPClient::Schema schema { BLOCKING_RESPONSE_TYPE, C_Type::Json };
     // NB: additionalProperties = false
     schema.addConstraint("transaction_id", T_Constraint::String, true);
-    schema.addConstraint("results", T_Constraint::Object, true);
+    // NB: either results or encoded_results
+    schema.addConstraint("results", T_Constraint::Object, false);
+    schema.addConstraint("results_encoding", T_Constraint::String, false);
+    schema.addConstraint("encoded_results", T_Constraint::String, false);
     return schema;
 }
 
@@ -37,6 +42,8 @@ PCPClient::Schema NonBlockingRequestSchema() {
     schema.addConstraint("module", T_Constraint::String, true);
     schema.addConstraint("action", T_Constraint::String, true);
     schema.addConstraint("params", T_Constraint::Object, false);
+    schema.addConstraint("accept_encoding", T_Constraint::String, false);
+    schema.addConstraint("timing", T_Constraint::Bool, false);
     return schema;
 }
 
@@ -45,7 +52,11 @@ PCPClient::Schema NonBlockingResponseSchema() {
     // NB: additionalProperties = false
     schema.addConstraint("transaction_id", T_Constraint::String, true);
     schema.addConstraint("job_id", T_Constraint::String, true);
-    schema.addConstraint("results", T_Constraint::Object, true);
+    // NB: either results, encoded_results, or num_fragments
+    schema.addConstraint("results", T_Constraint::Object, false);
+    schema.addConstraint("results_encoding", T_Constraint::String, false);
+    schema.addConstraint("encoded_results", T_Constraint::String, false);
+    schema.addConstraint("num_fragments", T_Constraint::Int, false);
     return schema;
 }
 
@@ -56,6 +67,15 @@ PCPClient::Schema ProvisionalResponseSchema() {
     return schema;
 }
 
+// NB: the header of binary requests is validated by ActionRequest
+PCPClient::Schema BinaryBlockingRequestSchema() {
+    return PCPClient::Schema { BINARY_BLOCKING_REQUEST_TYPE, C_Type::Binary };
+}
+
+PCPClient::Schema BinaryNonBlockingRequestSchema() {
+    return PCPClient::Schema { BINARY_NON_BLOCKING_REQUEST_TYPE, C_Type::Binary };
+}
+
 PCPClient::Schema PXPErrorSchema() {
     PCPClient::Schema schema { PXP_ERROR_MSG_TYPE, C_Type::Json };
     // NB: additionalProperties = false
@@ -65,5 +85,23 @@ PCPClient::Schema PXPErrorSchema() {
     return schema;
 }
 
+PCPClient::Schema BatchResponseSchema() {
+    PCPClient::Schema schema { BATCH_RESPONSE_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("responses", T_Constraint::Array, true);
+    return schema;
+}
+
+PCPClient::Schema ResultsFragmentSchema() {
+    PCPClient::Schema schema { RESULTS_FRAGMENT_TYPE, C_Type::Json };
+    // NB: additionalProperties = false
+    schema.addConstraint("transaction_id", T_Constraint::String, true);
+    schema.addConstraint("job_id", T_Constraint::String, true);
+    schema.addConstraint("index", T_Constraint::Int, true);
+    schema.addConstraint("num_fragments", T_Constraint::Int, true);
+    schema.addConstraint("data", T_Constraint::String, true);
+    return schema;
+}
+
 }  // namespace PXPAgent
 }  // namespace PXPSchemas
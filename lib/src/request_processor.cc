@@ -2,7 +2,11 @@
 #include <pxp-agent/action_outcome.hpp>
 #include <pxp-agent/pxp_schemas.hpp>
 #include <pxp-agent/external_module.hpp>
+#include <pxp-agent/metadata_writer.hpp>
+#include <pxp-agent/spool_layout.hpp>
+#include <pxp-agent/output_compressor.hpp>
 #include <pxp-agent/modules/echo.hpp>
+#include <pxp-agent/modules/metrics.hpp>
 #include <pxp-agent/modules/ping.hpp>
 #include <pxp-agent/modules/status.hpp>
 
@@ -20,9 +24,10 @@
 #include <boost/filesystem/operations.hpp>
 
 #include <vector>
+#include <set>
 #include <atomic>
 #include <functional>
-#include <stdexcept>  // out_of_range
+#include <stdexcept>
 
 namespace PXPAgent {
 
@@ -31,6 +36,15 @@ namespace lth_jc = leatherman::json_container;
 namespace lth_file = leatherman::file_util;
 namespace lth_util = leatherman::util;
 
+// Number of tracked jobs above which the completed ones are forgotten
+static const size_t JOBS_PRUNING_THRESHOLD { 256 };
+
+// Time given to the queued responses to be sent when draining
+static const uint32_t OUTBOUND_FLUSH_TIMEOUT_MS { 2000 };
+
+// Name of the journal file, in the spool directory
+static const std::string JOURNAL_FILE_NAME { "jobs.journal" };
+
 //
 // Results Storage
 //
@@ -41,34 +55,112 @@ class ResultsStorage {
         explicit Error(std::string const& msg) : std::runtime_error(msg) {}
     };
 
-    // Throw a ResultsStorage::Error in case of failure while writing
-    // to any of result files
-    ResultsStorage(const ActionRequest& request, const std::string& results_dir)
+    // Throw a ResultsStorage::Error in case it fails to create the
+    // results directory; the metadata file is written by
+    // writeInitialMetadata()
+    ResultsStorage(const ActionRequest& request,
+                   const std::string& results_dir,
+                   std::shared_ptr<MetadataWriter> metadata_writer_ptr)
             : module { request.module() },
               action { request.action() },
+              sender { request.sender() },
+              request_id { request.id() },
+              job_id { request.transactionId() },
+              job_dir { results_dir },
               metadata_file { (fs::path(results_dir) / "metadata").string() },
-              action_metadata {} {
+              action_metadata {},
+              started { false },
+              finalized { false },
+              mtx {},
+              writer_ptr { metadata_writer_ptr } {
         initialize(request, results_dir);
     }
 
+    // Queue the write of the metadata of the accepted job; the
+    // callback tells if it was written
+    void writeInitialMetadata(MetadataWriter::Callback on_written) {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex };
+        writer_ptr->write(metadata_file, action_metadata.toString() + "\n",
+                          std::move(on_written));
+    }
+
     void writeMetadata(const int exit_code,
                        const std::string& exec_error,
                        const std::string& duration) {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mtx };
         // TODO(ale): use this metadata in status response!
         action_metadata.set<bool>("completed", true);
         action_metadata.set<std::string>("duration", duration);
         action_metadata.set<int>("exitcode", exit_code);
         action_metadata.set<std::string>("exec_error", exec_error);
+        finalized = true;
+
+        writer_ptr->write(metadata_file, action_metadata.toString() + "\n");
+    }
+
+    // Flag the job as started, unless it was already failed (see
+    // writeNotStarted()). Return false if the job must not execute.
+    bool markStarted() {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mtx };
+        if (finalized) {
+            return false;
+        }
+
+        started = true;
+        return true;
+    }
+
+    // Finalize the metadata of a job that was never started (i.e. it
+    // was still queued when pxp-agent stopped) as failed.
+    // Return true if the metadata was updated, false otherwise.
+    bool writeNotStarted(const std::string& reason) {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mtx };
+        if (started || finalized) {
+            return false;
+        }
+
+        action_metadata.set<bool>("completed", true);
+        action_metadata.set<int>("exitcode", EXIT_FAILURE);
+        action_metadata.set<std::string>("exec_error", reason);
+        finalized = true;
 
-        lth_file::atomic_write_to_file(action_metadata.toString() + "\n",
-                                       metadata_file);
+        writer_ptr->write(metadata_file, action_metadata.toString() + "\n");
+        return true;
     }
 
+    // Flag the job as orphaned, i.e. still in progress when pxp-agent
+    // stopped, unless it was never started or its metadata was
+    // already finalized.
+    // Return true if the metadata was updated, false otherwise.
+    bool writeOrphaned() {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mtx };
+        if (!started || finalized) {
+            return false;
+        }
+
+        action_metadata.set<bool>("orphaned", true);
+        writer_ptr->write(metadata_file, action_metadata.toString() + "\n");
+        return true;
+    }
+
+    const std::string& getSender() const { return sender; }
+    const std::string& getRequestId() const { return request_id; }
+    const std::string& getJobId() const { return job_id; }
+    const std::string& getJobDir() const { return job_dir; }
+
   private:
     std::string module;
     std::string action;
+    std::string sender;
+    std::string request_id;
+    std::string job_id;
+    std::string job_dir;
     std::string metadata_file;
     lth_jc::JsonContainer action_metadata;
+    bool started;
+    bool finalized;
+    PCPClient::Util::mutex mtx;
+    std::shared_ptr<MetadataWriter> writer_ptr;
 
     void initialize(const ActionRequest& request, const std::string& results_dir) {
         if (!fs::exists(results_dir)) {
@@ -88,27 +180,69 @@ class ResultsStorage {
         action_metadata.set<bool>("completed", false);
         action_metadata.set<std::string>("duration", "0 s");
 
+        // Needed to notify the requester in case the job is adopted
+        // by another pxp-agent run (see SpoolRecovery)
+        action_metadata.set<std::string>("requester", request.sender());
+        action_metadata.set<std::string>("request_id", request.id());
+        action_metadata.set<std::string>("transaction_id", request.transactionId());
+        action_metadata.set<bool>(
+            "notify_outcome",
+            request.parsedChunks().data.get<bool>("notify_outcome"));
+
         if (!request.paramsTxt().empty()) {
             action_metadata.set<std::string>("input", request.paramsTxt());
         } else {
             action_metadata.set<std::string>("input", "none");
         }
-
-        lth_file::atomic_write_to_file(action_metadata.toString() + "\n",
-                                       metadata_file);
     }
 };
 
+// Record the latency of the phase, as the time elapsed between the
+// two events of the timeline of the request, if both were stamped
+static void recordPhase(DispatchTable::Handle& handle,
+                        DispatchTable::Phase phase,
+                        const ActionRequest& request,
+                        RequestTimeline::Event from,
+                        RequestTimeline::Event to) {
+    auto elapsed_us = request.timeline().elapsedMicroseconds(from, to);
+
+    if (elapsed_us >= 0) {
+        handle.recordPhase(phase, static_cast<uint64_t>(elapsed_us));
+    }
+}
+
+// Record the latencies of the spawn and of the execution of an action
+static void recordExecution(DispatchTable::Handle& handle,
+                            const ActionRequest& request) {
+    recordPhase(handle, DispatchTable::Phase::Spawn, request,
+                RequestTimeline::Event::Started, RequestTimeline::Event::Spawned);
+    recordPhase(handle, DispatchTable::Phase::Execution, request,
+                RequestTimeline::Event::Started,
+                RequestTimeline::Event::OutputValidated);
+}
+
 //
 // Non-blocking action task
 //
 
-void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
-                           ActionRequest request,
-                           std::string job_id,
-                           ResultsStorage results_storage,
-                           std::shared_ptr<PXPConnector> connector_ptr,
-                           std::shared_ptr<std::atomic<bool>> done) {
+// Notify the requester of a job that failed unexpectedly, if possible
+static void sendUnexpectedFailure(std::shared_ptr<PXPConnector> connector_ptr,
+                                  const ActionRequest& request) {
+    try {
+        connector_ptr->sendPXPError(request, "unexpected failure while "
+                                             "executing the job");
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to send the PXP error for job %1%: %2%",
+                  request.transactionId(), e.what());
+    }
+}
+
+void nonBlockingActionTask(std::shared_ptr<DispatchTable::Handle> handle_ptr,
+                           const ActionRequest& request,
+                           const std::string& job_id,
+                           const std::string& results_dir,
+                           std::shared_ptr<ResultsStorage> results_storage,
+                           std::shared_ptr<PXPConnector> connector_ptr) {
     lth_util::Timer timer {};
     std::string exec_error {};
     ActionOutcome outcome {};
@@ -116,40 +250,71 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
     lth_jc::JsonContainer results {};
 
     try {
-        outcome = module_ptr->executeAction(request);
+        outcome = handle_ptr->module_ptr->executeAction(request);
         assert(outcome.type == ActionOutcome::Type::External);
         exit_code = outcome.exitcode;
+        recordExecution(*handle_ptr, request);
 
         LOG_INFO("Non-blocking request %1% by %2%, transaction %3%, has completed",
                  request.id(), request.sender(), request.transactionId());
 
+        // NB: the results are in the stdout file, as output by the module
         if (request.parsedChunks().data.get<bool>("notify_outcome")) {
-            connector_ptr->sendNonBlockingResponse(request, outcome.results, job_id);
+            if (!connector_ptr->sendFragmentedNonBlockingResponse(
+                        request, (fs::path(results_dir) / "stdout").string(),
+                        job_id)) {
+                // NB: the results of a fragmented outcome were not loaded
+                if (outcome.fragmented) {
+                    throw Module::ProcessingError { "failed to read the results" };
+                }
+
+                connector_ptr->sendNonBlockingResponse(
+                    request, std::move(outcome.results), job_id);
+            }
+
+            recordPhase(*handle_ptr, DispatchTable::Phase::Send, request,
+                        RequestTimeline::Event::OutputValidated,
+                        RequestTimeline::Event::Sent);
         }
     } catch (const Module::ProcessingError& e) {
         connector_ptr->sendPXPError(request, e.what());
         exec_error = std::string("Failed to execute: ") + e.what() + "\n";
         LOG_ERROR("Failed to execute '%1% %2%': %3%",
                   request.module(), request.action(), e.what());
+    } catch (const PXPConnector::StreamError& e) {
+        // NB: the PXP error was sent in place of the remaining fragments
+        exec_error = std::string("Failed to send the results: ")
+                     + e.what() + "\n";
     } catch (PCPClient::connection_error& e) {
         exec_error = std::string("Failed to send non blocking response: ")
                      + e.what() + "\n";
         LOG_ERROR("Failed to send non blocking response for '%1% %2%': %3%",
                   request.module(), request.action(), e.what());
+    } catch (const std::exception& e) {
+        // NB: the metadata and the index entry must be finalized anyway
+        exec_error = std::string("Unexpected failure: ") + e.what() + "\n";
+        LOG_ERROR("Unexpected failure of the '%1% %2%' job %3%: %4%",
+                  request.module(), request.action(), job_id, e.what());
+        sendUnexpectedFailure(connector_ptr, request);
+    } catch (...) {
+        exec_error = "Unexpected failure\n";
+        LOG_ERROR("Unexpected failure of the '%1% %2%' job %3%",
+                  request.module(), request.action(), job_id);
+        sendUnexpectedFailure(connector_ptr, request);
     }
 
+    handle_ptr->recordRequest(exec_error.empty(),
+                              static_cast<uint64_t>(timer.elapsed_milliseconds()));
+
     // Store metadata on disk
     auto duration = std::to_string(timer.elapsed_seconds()) + " s";
     try {
         // Catch possible write error to ensure signalling we're done
-        results_storage.writeMetadata(exit_code, exec_error, duration);
+        results_storage->writeMetadata(exit_code, exec_error, duration);
     } catch (const std::exception& e) {
         LOG_ERROR("Failed to write metadata of non blocking request %1%: %2%",
                   job_id, e.what());
     }
-
-    // Flag end of processing
-    *done = true;
 }
 
 //
@@ -158,13 +323,56 @@ void nonBlockingActionTask(std::shared_ptr<Module> module_ptr,
 
 RequestProcessor::RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
                                    const Configuration::Agent& agent_configuration)
-        : thread_container_ { "Action Executer" },
+        : draining_ { false },
+          scheduler_ { static_cast<uint32_t>(agent_configuration.max_concurrent_jobs),
+                       agent_configuration.sender_rate_limit,
+                       static_cast<uint32_t>(agent_configuration.sender_rate_burst),
+                       static_cast<uint32_t>(agent_configuration.max_queued_jobs) },
           connector_ptr_ { connector_ptr },
           spool_dir_ { agent_configuration.spool_dir },
+          metadata_writer_ptr_ { new MetadataWriter(static_cast<uint32_t>(
+              agent_configuration.metadata_flush_delay)) },
+          journal_ptr_ { new JobJournal((fs::path(agent_configuration.spool_dir)
+                                         / JOURNAL_FILE_NAME).string()) },
+          job_index_ptr_ { new JobIndex() },
+          spool_recovery_ { agent_configuration.spool_dir, connector_ptr,
+                            job_index_ptr_ },
+          compressor_ptr_ { new OutputCompressor() },
+          archive_ptr_ { new JobArchive(
+              agent_configuration.spool_dir,
+              static_cast<uint32_t>(agent_configuration.spool_archive_after) * 60,
+              static_cast<uint32_t>(agent_configuration.spool_archive_retention)
+                  * 24 * 3600,
+              ARCHIVE_MAX_SEGMENT_SIZE,
+              job_index_ptr_) },
           modules_ {},
+          dispatch_table_ {},
+          metrics_ptr_ { new AgentMetrics(dispatch_table_) },
           modules_config_dir_ { agent_configuration.modules_config_dir },
-          modules_config_ {} {
+          modules_config_ {},
+          jobs_ {},
+          jobs_mutex_ {},
+          metrics_exporter_ptr_ { nullptr } {
     assert(!spool_dir_.empty());
+
+    try {
+        SpoolLayout::migrate(spool_dir_);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to migrate the spool to the sharded layout: %1%",
+                  e.what());
+    }
+
+    try {
+        // NB: the jobs reported by the journal are failed by adoptJobs()
+        std::set<std::string> journaled_job_ids {};
+        for (const auto& job : journal_ptr_->getInterruptedJobs()) {
+            journaled_job_ids.insert(job.job_id);
+        }
+        spool_recovery_.scan(journaled_job_ids);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to scan the spool: %1%", e.what());
+    }
+
     loadModulesConfiguration();
     loadInternalModules();
 
@@ -175,24 +383,106 @@ RequestProcessor::RequestProcessor(std::shared_ptr<PXPConnector> connector_ptr,
                     "module will be loaded");
     }
 
+    dispatch_table_ = DispatchTable { modules_ };
     logLoadedModules();
+
+    // NB: the metrics are owned by the processor, so capturing it is safe
+    metrics_ptr_->addGauge("running_jobs", [this]() -> uint64_t {
+        return scheduler_.getNumRunningJobs();
+    });
+    metrics_ptr_->addGauge("queued_jobs", [this]() -> uint64_t {
+        return scheduler_.getNumQueuedJobs();
+    });
+    metrics_ptr_->addGauge("indexed_jobs", [this]() -> uint64_t {
+        return job_index_ptr_->size();
+    });
+    metrics_ptr_->addGauge("job_threads", [this]() -> uint64_t {
+        return scheduler_.getNumRunningThreads();
+    });
+    metrics_ptr_->addCounter("started_job_threads", [this]() -> uint64_t {
+        return scheduler_.getNumStartedThreads();
+    });
+    metrics_ptr_->addGauge("adopted_job_threads", [this]() -> uint64_t {
+        return spool_recovery_.getNumWatchedJobs();
+    });
+    // NB: the spool is scanned at each report
+    metrics_ptr_->addGauge("spool_jobs", [this]() -> uint64_t {
+        return SpoolLayout::listJobDirs(spool_dir_).size();
+    });
+    metrics_ptr_->addGauge("outbound_queue_messages", [this]() -> uint64_t {
+        return connector_ptr_->getNumQueuedMessages();
+    });
+    metrics_ptr_->addGauge("outbox_messages", [this]() -> uint64_t {
+        return connector_ptr_->getNumStoredMessages();
+    });
+    metrics_ptr_->addGauge("broker_connected", [this]() -> uint64_t {
+        return connector_ptr_->isConnected() ? 1 : 0;
+    });
+    metrics_ptr_->addCounter("outbound_dropped_messages", [this]() -> uint64_t {
+        return connector_ptr_->getNumDroppedMessages();
+    });
+    metrics_ptr_->addLatency("outbound", connector_ptr_->getSendLatency());
+
+    if (!agent_configuration.metrics_textfile.empty()
+            || !agent_configuration.metrics_socket.empty()) {
+        try {
+            metrics_exporter_ptr_.reset(new MetricsExporter(
+                metrics_ptr_,
+                agent_configuration.metrics_textfile,
+                static_cast<uint32_t>(agent_configuration.metrics_interval),
+                agent_configuration.metrics_socket));
+        } catch (const MetricsExporter::Error& e) {
+            LOG_ERROR("Failed to start exporting the metrics: %1%", e.what());
+        }
+    }
 }
 
 void RequestProcessor::processRequest(const RequestType& request_type,
                                       const PCPClient::ParsedChunks& parsed_chunks) {
     LOG_TRACE("About to validate and process PXP request message: %1%",
-              parsed_chunks.toString());
+              describeParsedChunks(parsed_chunks));
     try {
         // Inspect and validate the request message format
-        ActionRequest request { request_type, parsed_chunks };
+        // NB: the request is shared with non-blocking job tasks
+        std::shared_ptr<const ActionRequest> request_ptr {
+            std::make_shared<ActionRequest>(request_type, parsed_chunks) };
+        const auto& request = *request_ptr;
 
         LOG_INFO("Processing %1% request %2% by %3%, transaction %4%",
                  requestTypeNames[request_type], request.id(), request.sender(),
                  request.transactionId());
 
+        if (draining_) {
+            // We're stopping; send *PXP error*
+            LOG_WARNING("Rejecting %1% request %2% by %3%, transaction %4%: "
+                        "pxp-agent is shutting down",
+                        requestTypeNames[request_type], request.id(),
+                        request.sender(), request.transactionId());
+            connector_ptr_->sendPXPError(request, "pxp-agent is shutting down; "
+                                                  "request not processed");
+            return;
+        }
+
+        if (!scheduler_.admit(request.sender())) {
+            // Too many requests from this sender; send *PXP error*
+            LOG_WARNING("Rejecting %1% request %2% by %3%, transaction %4%: "
+                        "the requester exceeded its rate limit",
+                        requestTypeNames[request_type], request.id(),
+                        request.sender(), request.transactionId());
+            connector_ptr_->sendPXPError(request, "rate limit exceeded; "
+                                                  "request not processed");
+            return;
+        }
+
+        std::shared_ptr<DispatchTable::Handle> handle_ptr;
+
         try {
             // We can access the request content; validate it
-            validateRequestContent(request);
+            handle_ptr = validateRequestContent(request);
+            request.stamp(RequestTimeline::Event::Validated);
+            recordPhase(*handle_ptr, DispatchTable::Phase::Validation, request,
+                        RequestTimeline::Event::Received,
+                        RequestTimeline::Event::Validated);
         } catch (RequestProcessor::Error& e) {
             // Invalid request; send *PXP error*
 
@@ -208,9 +498,9 @@ void RequestProcessor::processRequest(const RequestType& request_type,
 
         try {
             if (request.type() == RequestType::Blocking) {
-                processBlockingRequest(request);
+                processBlockingRequest(request, *handle_ptr);
             } else {
-                processNonBlockingRequest(request);
+                processNonBlockingRequest(request_ptr, handle_ptr);
             }
             LOG_DEBUG("%1% request %2% by %3%, transaction %4%, has been "
                       "successfully processed", requestTypeNames[request_type],
@@ -233,24 +523,161 @@ void RequestProcessor::processRequest(const RequestType& request_type,
     }
 }
 
+RequestProcessor::~RequestProcessor() {
+    // NB: the callbacks of the metadata updates and of the journal
+    // records of the accepted jobs refer to the processor
+    metadata_writer_ptr_->flush();
+    journal_ptr_->flush();
+}
+
+void RequestProcessor::drain(uint32_t timeout_s) {
+    draining_ = true;
+    LOG_INFO("Stopped accepting requests; waiting up to %1% s for the running "
+             "jobs to complete", timeout_s);
+
+    // NB: the jobs accepted so far are scheduled once recorded
+    metadata_writer_ptr_->flush();
+    journal_ptr_->flush();
+
+    auto all_completed = scheduler_.drain(timeout_s * 1000);
+
+    // NB: the scheduler no longer starts the queued jobs
+    failQueuedJobs();
+
+    if (all_completed) {
+        LOG_INFO("All running jobs have completed");
+    } else {
+        uint32_t num_orphaned { 0 };
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { jobs_mutex_ };
+
+        for (auto& job : jobs_) {
+            auto results_storage = job.second.lock();
+            try {
+                if (results_storage && results_storage->writeOrphaned()) {
+                    LOG_DEBUG("Flagged job %1% as orphaned", job.first);
+                    num_orphaned++;
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failed to flag job %1% as orphaned: %2%",
+                          job.first, e.what());
+            }
+        }
+
+        LOG_WARNING("%1% job%2% did not complete in time; flagged as orphaned",
+                    num_orphaned, lth_util::plural(num_orphaned));
+    }
+
+    metadata_writer_ptr_->flush();
+    flushOutbound();
+}
+
+void RequestProcessor::adoptJobs() {
+    for (const auto& job : journal_ptr_->getInterruptedJobs()) {
+        try {
+            spool_recovery_.failJob(job, "pxp-agent stopped before the job "
+                                         "was started");
+            journal_ptr_->logFailed(job.job_id);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to flag job %1% as failed: %2%",
+                      job.job_id, e.what());
+        }
+    }
+
+    try {
+        spool_recovery_.adoptJobs();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to adopt the jobs of the previous run: %1%", e.what());
+    }
+}
+
 //
 // Private interface
 //
 
-void RequestProcessor::validateRequestContent(const ActionRequest& request) {
+void RequestProcessor::flushOutbound() {
+    if (!connector_ptr_->flushOutbound(OUTBOUND_FLUSH_TIMEOUT_MS)) {
+        LOG_WARNING("Failed to send all queued responses before stopping");
+    }
+}
+
+void RequestProcessor::failQueuedJobs() {
+    static const std::string reason { "pxp-agent stopped before the job was "
+                                      "started" };
+    std::vector<std::shared_ptr<ResultsStorage>> failed_jobs {};
+
+    {
+        PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { jobs_mutex_ };
+
+        for (auto& job : jobs_) {
+            auto results_storage = job.second.lock();
+            try {
+                if (results_storage && results_storage->writeNotStarted(reason)) {
+                    failed_jobs.push_back(results_storage);
+                }
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failed to flag job %1% as failed: %2%",
+                          job.first, e.what());
+            }
+        }
+    }
+
+    for (const auto& results_storage : failed_jobs) {
+        const auto& job_id = results_storage->getJobId();
+        LOG_DEBUG("Failed job %1%, as it was never started", job_id);
+
+        try {
+            journal_ptr_->logFailed(job_id);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to record job %1% as failed in the journal: %2%",
+                      job_id, e.what());
+        }
+
+        connector_ptr_->sendPXPError(results_storage->getSender(),
+                                     results_storage->getRequestId(),
+                                     job_id,
+                                     reason);
+    }
+
+    if (!failed_jobs.empty()) {
+        LOG_WARNING("%1% queued job%2% failed, as pxp-agent is stopping",
+                    failed_jobs.size(), lth_util::plural(failed_jobs.size()));
+    }
+}
+
+void RequestProcessor::trackJob(const std::string& job_id,
+                                std::shared_ptr<ResultsStorage> results_storage) {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { jobs_mutex_ };
+
+    if (jobs_.size() >= JOBS_PRUNING_THRESHOLD) {
+        // Forget the jobs whose task has been destroyed
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            if (it->second.expired()) {
+                it = jobs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    jobs_[job_id] = results_storage;
+}
+
+std::shared_ptr<DispatchTable::Handle> RequestProcessor::validateRequestContent(
+        const ActionRequest& request) {
     // Validate requested module and action
-    try {
-        if (!modules_.at(request.module())->hasAction(request.action())) {
-            throw RequestProcessor::Error { "unknown action '" + request.action()
-                                            + "' for module '" + request.module() + "'" };
+    auto handle_ptr = dispatch_table_.find(request.module(), request.action());
+
+    if (handle_ptr == nullptr) {
+        if (modules_.find(request.module()) == modules_.end()) {
+            throw RequestProcessor::Error { "unknown module: " + request.module() };
         }
-    } catch (std::out_of_range& e) {
-        throw RequestProcessor::Error { "unknown module: " + request.module() };
+
+        throw RequestProcessor::Error { "unknown action '" + request.action()
+                                        + "' for module '" + request.module() + "'" };
     }
 
     // If it's an internal module, the request must be blocking
-    if (modules_.at(request.module())->type() == Module::Type::Internal
-        && request.type() == RequestType::NonBlocking) {
+    if (handle_ptr->blocking_only && request.type() == RequestType::NonBlocking) {
         throw RequestProcessor::Error { "the module '" + request.module() + "' "
                                         "supports only blocking PXP requests" };
     }
@@ -261,64 +688,194 @@ void RequestProcessor::validateRequestContent(const ActionRequest& request) {
                   "by %4%, transaction %5%", request.module(), request.action(),
                   request.id(), request.sender(), request.transactionId());
 
-        // NB: the registred schemas have the same name as the action
-        auto& validator = modules_.at(request.module())->input_validator_;
-        validator.validate(request.params(), request.action());
+        handle_ptr->validateInput(request.params());
     } catch (PCPClient::validation_error& e) {
         LOG_DEBUG("Invalid '%1% %2%' request %3%: %4%", request.module(),
                   request.action(), request.id(), e.what());
         throw RequestProcessor::Error { "invalid input for '" + request.module()
                                         + " " + request.action() + "'" };
     }
+
+    return handle_ptr;
 }
 
-void RequestProcessor::processBlockingRequest(const ActionRequest& request) {
+void RequestProcessor::processBlockingRequest(const ActionRequest& request,
+                                              DispatchTable::Handle& handle) {
+    lth_util::Timer timer {};
+    ActionOutcome outcome {};
+
     // Execute action; possible request errors will be propagated
-    auto outcome = modules_[request.module()]->executeAction(request);
+    try {
+        outcome = handle.module_ptr->executeAction(request);
+    } catch (...) {
+        handle.recordRequest(false,
+                             static_cast<uint64_t>(timer.elapsed_milliseconds()));
+        throw;
+    }
+
+    handle.recordRequest(true, static_cast<uint64_t>(timer.elapsed_milliseconds()));
+    recordExecution(handle, request);
 
     LOG_INFO("Blocking request %1% by %2%, transaction %3%, has completed",
              request.id(), request.sender(), request.transactionId());
 
-    connector_ptr_->sendBlockingResponse(request, outcome.results);
+    connector_ptr_->sendBlockingResponse(request, std::move(outcome.results));
+    recordPhase(handle, DispatchTable::Phase::Send, request,
+                RequestTimeline::Event::OutputValidated,
+                RequestTimeline::Event::Sent);
 }
 
-void RequestProcessor::processNonBlockingRequest(const ActionRequest& request) {
-    fs::path spool_path { spool_dir_ };
-    std::string results_dir { (spool_path / request.transactionId()).string() };
-    std::string err_msg {};
+void RequestProcessor::processNonBlockingRequest(
+        std::shared_ptr<const ActionRequest> request_ptr,
+        std::shared_ptr<DispatchTable::Handle> handle_ptr) {
+    const auto& request = *request_ptr;
+    auto results_dir = SpoolLayout::getJobDir(spool_dir_, request.transactionId());
 
     LOG_DEBUG("Starting '%1% %2%' job with ID %3% for non-blocking request %4% "
               "by %5%", request.module(), request.action(),
               request.transactionId(), request.id(), request.sender());
 
+    // NB: checked before anything is stored for the job; the queue
+    // may still fill up before the job is scheduled, as jobs are
+    // scheduled once recorded in the journal (see startJob())
+    if (scheduler_.isFull()) {
+        LOG_WARNING("Rejecting the '%1% %2%' job with ID %3%: %4% jobs are "
+                    "already queued", request.module(), request.action(),
+                    request.transactionId(), scheduler_.getNumQueuedJobs());
+        connector_ptr_->sendPXPError(request, "too many queued jobs; "
+                                              "request not processed");
+        return;
+    }
+
+    std::shared_ptr<ResultsStorage> results_storage;
+
     try {
-        // Flag to enable signaling from task to thread_container
-        auto done = std::make_shared<std::atomic<bool>>(false);
-
-        thread_container_.add(PCPClient::Util::thread(&nonBlockingActionTask,
-                                                      modules_[request.module()],
-                                                      request,
-                                                      request.transactionId(),
-                                                      ResultsStorage { request, results_dir },
-                                                      connector_ptr_,
-                                                      done),
-                              done);
+        results_storage = std::make_shared<ResultsStorage>(
+            request, results_dir, metadata_writer_ptr_);
     } catch (ResultsStorage::Error& e) {
         // Failed to instantiate ResultsStorage
         LOG_ERROR("Failed to initialize the result files for '%1% %2%' action "
                   "job with ID %3%: %4%", request.module(), request.action(),
                   request.transactionId(), e.what());
-        err_msg = std::string { "failed to initialize result files: " } + e.what();
+        connector_ptr_->sendPXPError(
+            request,
+            std::string { "failed to initialize result files: " } + e.what());
+        return;
+    }
+
+    // The metadata must be stored and the job recorded before
+    // acknowledging the request; the writer threads of the metadata
+    // and of the journal start the job once both are durable, so
+    // that this thread does not wait for the files to be synced.
+    // NB: the writers are flushed before the processor is destroyed
+    results_storage->writeInitialMetadata(
+        [this, request_ptr, handle_ptr, results_dir, results_storage](bool written) {
+            const auto& request = *request_ptr;
+
+            if (!written) {
+                LOG_ERROR("Failed to write the metadata of '%1% %2%' action "
+                          "job with ID %3%", request.module(), request.action(),
+                          request.transactionId());
+                connector_ptr_->sendPXPError(request, "failed to initialize "
+                                                      "result files");
+                return;
+            }
+
+            journal_ptr_->logAccepted(
+                request,
+                [this, request_ptr, handle_ptr, results_dir,
+                 results_storage](bool durable) {
+                    if (!durable) {
+                        LOG_ERROR("Failed to record '%1% %2%' action job with "
+                                  "ID %3% in the journal", request_ptr->module(),
+                                  request_ptr->action(), request_ptr->transactionId());
+                        results_storage->writeNotStarted("failed to record the job");
+                        connector_ptr_->sendPXPError(*request_ptr,
+                                                     "failed to record the job");
+                        return;
+                    }
+
+                    startJob(request_ptr, handle_ptr, results_dir, results_storage);
+                });
+        });
+}
+
+void RequestProcessor::startJob(std::shared_ptr<const ActionRequest> request_ptr,
+                                std::shared_ptr<DispatchTable::Handle> handle_ptr,
+                                const std::string& results_dir,
+                                std::shared_ptr<ResultsStorage> results_storage) {
+    const auto& request = *request_ptr;
+    std::string err_msg {};
+
+    try {
+        auto connector_ptr = connector_ptr_;
+        auto journal_ptr = journal_ptr_;
+        auto compressor_ptr = compressor_ptr_;
+        auto job_index_ptr = job_index_ptr_;
+
+        trackJob(request.transactionId(), results_storage);
+        request.stamp(RequestTimeline::Event::Scheduled);
+        auto started = scheduler_.schedule(
+            request.sender(),
+            [handle_ptr, request_ptr, results_dir, results_storage,
+             connector_ptr, journal_ptr, compressor_ptr, job_index_ptr]() {
+                // NB: the job may have been failed while queued
+                if (!results_storage->markStarted()) {
+                    return;
+                }
+
+                request_ptr->stamp(RequestTimeline::Event::Dequeued);
+                recordPhase(*handle_ptr, DispatchTable::Phase::QueueWait,
+                            *request_ptr, RequestTimeline::Event::Scheduled,
+                            RequestTimeline::Event::Dequeued);
+                const auto& job_id = request_ptr->transactionId();
+                job_index_ptr->set(job_id, results_dir);
+
+                // NB: a journal failure must not prevent finalizing the job
+                try {
+                    journal_ptr->logStarted(job_id);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Failed to record job %1% as started in the "
+                              "journal: %2%", job_id, e.what());
+                }
+
+                nonBlockingActionTask(handle_ptr,
+                                      *request_ptr,
+                                      job_id,
+                                      results_dir,
+                                      results_storage,
+                                      connector_ptr);
+                // NB: the finalized metadata is readable by now
+                job_index_ptr->remove(job_id);
+
+                try {
+                    journal_ptr->logCompleted(job_id);
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Failed to record job %1% as completed in the "
+                              "journal: %2%", job_id, e.what());
+                }
+
+                compressor_ptr->compress(results_dir);
+            });
+
+        if (!started) {
+            LOG_INFO("The '%1% %2%' job with ID %3% has been queued; %4% "
+                     "jobs are waiting to be executed", request.module(),
+                     request.action(), request.transactionId(),
+                     scheduler_.getNumQueuedJobs());
+        }
     } catch (std::exception& e) {
         LOG_ERROR("Failed to spawn '%1% %2%' action job with ID %3%: %4%",
                   request.module(), request.action(), request.transactionId(),
                   e.what());
         err_msg = std::string { "failed to start action task: " } + e.what();
+        journal_ptr_->logFailed(request.transactionId());
     }
 
     if (err_msg.empty()) {
         connector_ptr_->sendProvisionalResponse(request);
-    } else {
+    } else if (results_storage->writeNotStarted(err_msg)) {
+        // NB: otherwise the job was already failed by failQueuedJobs()
         connector_ptr_->sendPXPError(request, err_msg);
     }
 }
@@ -361,7 +918,9 @@ void RequestProcessor::loadInternalModules() {
     // HERE(ale): no external configuration for internal modules
     modules_["echo"] = std::shared_ptr<Module>(new Modules::Echo);
     modules_["ping"] = std::shared_ptr<Module>(new Modules::Ping);
-    modules_["status"] = std::shared_ptr<Module>(new Modules::Status);
+    modules_["status"] = std::shared_ptr<Module>(
+        new Modules::Status(metadata_writer_ptr_, archive_ptr_, job_index_ptr_));
+    modules_["metrics"] = std::shared_ptr<Module>(new Modules::Metrics(metrics_ptr_));
 }
 
 void RequestProcessor::loadExternalModulesFrom(fs::path dir_path) {
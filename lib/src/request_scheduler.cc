@@ -0,0 +1,253 @@
+#include <pxp-agent/request_scheduler.hpp>
+
+#include <leatherman/util/strings.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.request_scheduler"
+#include <leatherman/logging/logging.hpp>
+
+#include <algorithm>  // min, max
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>  // make_pair
+
+namespace PXPAgent {
+
+namespace pcp_util = PCPClient::Util;
+namespace lth_util = leatherman::util;
+
+// Number of token buckets above which the least recently used one is
+// discarded; it is most likely full by then, and a discarded bucket
+// is recreated full anyway
+static const size_t MAX_TOKEN_BUCKETS { 1024 };
+
+//
+// TokenBucket
+//
+
+TokenBucket::TokenBucket(double rate, double burst)
+        : rate_ { rate },
+          burst_ { burst },
+          tokens_ { burst },
+          last_refill_ { clock::now() } {
+}
+
+bool TokenBucket::tryConsume(clock::time_point now) {
+    tokens_ = tokensAt(now);
+    last_refill_ = now;
+
+    if (tokens_ < 1.0) {
+        return false;
+    }
+
+    tokens_ -= 1.0;
+    return true;
+}
+
+bool TokenBucket::isFull(clock::time_point now) const {
+    return tokensAt(now) >= burst_;
+}
+
+double TokenBucket::tokensAt(clock::time_point now) const {
+    // NB: the time may precede the last refill (e.g. if taken before
+    // the bucket was created); the bucket is not drained then
+    auto elapsed_us = std::max<int64_t>(0, pcp_util::chrono::duration_cast<
+        pcp_util::chrono::microseconds>(now - last_refill_).count());
+    return std::min(burst_, tokens_ + rate_ * elapsed_us / 1000000.0);
+}
+
+//
+// RequestScheduler
+//
+
+RequestScheduler::RequestScheduler(uint32_t max_concurrent_jobs,
+                                   double rate_limit,
+                                   uint32_t rate_burst,
+                                   uint32_t max_queued_jobs)
+        : max_concurrent_jobs_ { max_concurrent_jobs },
+          rate_limit_ { rate_limit },
+          rate_burst_ { std::max(rate_burst, 1u) },
+          max_queued_jobs_ { max_queued_jobs },
+          buckets_ {},
+          buckets_lru_ {},
+          queues_ {},
+          senders_round_robin_ {},
+          num_running_jobs_ { 0 },
+          num_queued_jobs_ { 0 },
+          draining_ { false },
+          mutex_ {},
+          thread_container_ { "Action Executer" } {
+}
+
+bool RequestScheduler::admit(const std::string& sender) {
+    if (rate_limit_ <= 0.0) {
+        return true;
+    }
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto bucket_it = buckets_.find(sender);
+
+    if (bucket_it != buckets_.end()) {
+        // The sender becomes the most recently used
+        buckets_lru_.splice(buckets_lru_.end(), buckets_lru_,
+                            bucket_it->second.second);
+    } else {
+        if (buckets_.size() >= MAX_TOKEN_BUCKETS) {
+            buckets_.erase(buckets_lru_.front());
+            buckets_lru_.pop_front();
+        }
+
+        auto lru_it = buckets_lru_.insert(buckets_lru_.end(), sender);
+        bucket_it = buckets_.emplace(
+            sender,
+            std::make_pair(TokenBucket { rate_limit_,
+                                         static_cast<double>(rate_burst_) },
+                           lru_it)).first;
+    }
+
+    return bucket_it->second.first.tryConsume();
+}
+
+bool RequestScheduler::schedule(const std::string& sender, Task task) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+
+    if (draining_) {
+        throw RequestScheduler::Error { "no job can be started while draining" };
+    }
+
+    if (max_concurrent_jobs_ > 0 && num_running_jobs_ >= max_concurrent_jobs_) {
+        if (isFullUnlocked()) {
+            throw RequestScheduler::Error { "too many queued jobs ("
+                                            + std::to_string(num_queued_jobs_)
+                                            + ")" };
+        }
+
+        auto& queue = queues_[sender];
+
+        if (queue.empty()) {
+            senders_round_robin_.push_back(sender);
+        }
+
+        queue.push_back(std::move(task));
+        num_queued_jobs_++;
+        LOG_DEBUG("%1% jobs running; queued a job of %2% (%3% queued "
+                  "jobs from this requester, %4% in total)", num_running_jobs_,
+                  sender, queue.size(), num_queued_jobs_);
+        return false;
+    }
+
+    // Flag to enable signaling from task to thread_container
+    auto done = std::make_shared<std::atomic<bool>>(false);
+
+    thread_container_.add(pcp_util::thread(&RequestScheduler::workerTask,
+                                           this,
+                                           std::move(task),
+                                           done),
+                          done);
+    num_running_jobs_++;
+    return true;
+}
+
+bool RequestScheduler::isFull() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return isFullUnlocked();
+}
+
+bool RequestScheduler::drain(uint32_t timeout_ms) {
+    {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+        draining_ = true;
+        LOG_INFO("Draining; %1% running job%2%, %3% queued job%4% will not "
+                 "be started", num_running_jobs_,
+                 lth_util::plural(num_running_jobs_), num_queued_jobs_,
+                 lth_util::plural(num_queued_jobs_));
+    }
+
+    return thread_container_.waitForAll(timeout_ms);
+}
+
+bool RequestScheduler::isDraining() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return draining_;
+}
+
+uint32_t RequestScheduler::getNumRunningJobs() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return num_running_jobs_;
+}
+
+uint32_t RequestScheduler::getNumQueuedJobs() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return num_queued_jobs_;
+}
+
+uint32_t RequestScheduler::getNumRunningThreads() {
+    return thread_container_.getNumRunningThreads();
+}
+
+uint32_t RequestScheduler::getNumStartedThreads() {
+    return thread_container_.getNumAddedThreads();
+}
+
+//
+// Private interface
+//
+
+void RequestScheduler::workerTask(Task task,
+                                  std::shared_ptr<std::atomic<bool>> done) {
+    while (true) {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("Unexpected failure while executing a job: %1%", e.what());
+        } catch (...) {
+            LOG_ERROR("Unexpected failure while executing a job");
+        }
+
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+
+        if (!popNextTask(task)) {
+            num_running_jobs_--;
+            break;
+        }
+    }
+
+    // Flag end of processing
+    *done = true;
+}
+
+bool RequestScheduler::popNextTask(Task& task) {
+    if (draining_ || senders_round_robin_.empty()) {
+        return false;
+    }
+
+    auto sender = senders_round_robin_.front();
+    senders_round_robin_.pop_front();
+    auto queue_it = queues_.find(sender);
+    assert(queue_it != queues_.end() && !queue_it->second.empty());
+
+    task = std::move(queue_it->second.front());
+    queue_it->second.pop_front();
+    num_queued_jobs_--;
+
+    if (queue_it->second.empty()) {
+        queues_.erase(queue_it);
+    } else {
+        // The sender goes at the back of the line
+        senders_round_robin_.push_back(sender);
+    }
+
+    LOG_DEBUG("Dequeued a job of %1%; %2% jobs left in queue",
+              sender, num_queued_jobs_);
+    return true;
+}
+
+bool RequestScheduler::isFullUnlocked() const {
+    return max_queued_jobs_ > 0
+           && max_concurrent_jobs_ > 0
+           && num_running_jobs_ >= max_concurrent_jobs_
+           && num_queued_jobs_ >= max_queued_jobs_;
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,81 @@
+#include <pxp-agent/request_timeline.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <vector>
+
+namespace PXPAgent {
+
+namespace pcp_chrono = PCPClient::Util::chrono;
+
+const size_t RequestTimeline::NUM_EVENTS;
+
+static const std::array<std::string, RequestTimeline::NUM_EVENTS> EVENT_NAMES {
+    { "received", "validated", "scheduled", "dequeued", "started", "spawned",
+      "exited", "output_validated", "sent" } };
+
+static const std::string TIMELINE_SERVER { "pxp-agent" };
+
+const std::string& RequestTimeline::eventName(Event event) {
+    return EVENT_NAMES[static_cast<size_t>(event)];
+}
+
+RequestTimeline::RequestTimeline()
+        : received_ { pcp_chrono::steady_clock::now() },
+          received_time_ { boost::posix_time::microsec_clock::universal_time() },
+          elapsed_us_ {} {
+    for (auto& elapsed_us : elapsed_us_) {
+        elapsed_us.store(-1);
+    }
+
+    elapsed_us_[static_cast<size_t>(Event::Received)].store(0);
+}
+
+void RequestTimeline::stamp(Event event) {
+    auto elapsed = pcp_chrono::duration_cast<pcp_chrono::microseconds>(
+        pcp_chrono::steady_clock::now() - received_).count();
+    elapsed_us_[static_cast<size_t>(event)].store(static_cast<int64_t>(elapsed),
+                                                  std::memory_order_relaxed);
+}
+
+int64_t RequestTimeline::elapsedMicroseconds(Event event) const {
+    return elapsed_us_[static_cast<size_t>(event)].load(std::memory_order_relaxed);
+}
+
+int64_t RequestTimeline::elapsedMicroseconds(Event from, Event to) const {
+    auto from_us = elapsedMicroseconds(from);
+    auto to_us = elapsedMicroseconds(to);
+
+    if (from_us < 0 || to_us < from_us) {
+        return -1;
+    }
+
+    return to_us - from_us;
+}
+
+lth_jc::JsonContainer RequestTimeline::getDebugChunk() const {
+    std::vector<lth_jc::JsonContainer> hops {};
+
+    for (size_t idx = 0; idx < NUM_EVENTS; idx++) {
+        auto elapsed_us = elapsed_us_[idx].load(std::memory_order_relaxed);
+
+        if (elapsed_us < 0) {
+            continue;
+        }
+
+        auto time = received_time_ + boost::posix_time::microseconds(elapsed_us);
+        lth_jc::JsonContainer hop {};
+        hop.set<std::string>("server", TIMELINE_SERVER);
+        hop.set<std::string>("stage", EVENT_NAMES[idx]);
+        hop.set<std::string>("time",
+                             boost::posix_time::to_iso_extended_string(time) + "Z");
+        hop.set<double>("elapsed_ms", static_cast<double>(elapsed_us) / 1000.0);
+        hops.push_back(std::move(hop));
+    }
+
+    lth_jc::JsonContainer chunk {};
+    chunk.set<std::vector<lth_jc::JsonContainer>>("hops", hops);
+    return chunk;
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,159 @@
+#include <pxp-agent/spool_layout.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/strings.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.spool_layout"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cctype>     // isxdigit, isupper
+#include <cstdio>
+
+namespace PXPAgent {
+namespace SpoolLayout {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+// File stored in the spool once no job is left in the legacy layout
+static const std::string MIGRATED_MARKER { ".sharded" };
+
+// Return true if the specified directory is a shard; note that a job
+// of the legacy layout may have a shard-like name
+static bool isShard(const fs::path& dir_path) {
+    auto name = dir_path.filename().string();
+    return name.size() == 2
+           && isxdigit(static_cast<unsigned char>(name[0]))
+           && !isupper(static_cast<unsigned char>(name[0]))
+           && isxdigit(static_cast<unsigned char>(name[1]))
+           && !isupper(static_cast<unsigned char>(name[1]))
+           && !fs::exists(dir_path / "metadata");
+}
+
+std::string getShard(const std::string& job_id) {
+    boost::crc_32_type crc {};
+    crc.process_bytes(job_id.data(), job_id.size());
+    char buffer[3];
+    std::snprintf(buffer, sizeof(buffer), "%02x",
+                  static_cast<unsigned int>(crc.checksum() & 0xff));
+    return std::string { buffer };
+}
+
+std::string getJobDir(const std::string& spool_dir, const std::string& job_id) {
+    return (fs::path(spool_dir) / getShard(job_id) / job_id).string();
+}
+
+std::string findJobDir(const std::string& spool_dir, const std::string& job_id) {
+    auto job_dir = getJobDir(spool_dir, job_id);
+
+    if (!fs::exists(job_dir)) {
+        auto legacy_job_path = fs::path(spool_dir) / job_id;
+
+        if (fs::exists(legacy_job_path / "metadata")) {
+            return legacy_job_path.string();
+        }
+    }
+
+    return job_dir;
+}
+
+std::vector<std::string> listJobDirs(const std::string& spool_dir) {
+    std::vector<std::string> job_dirs {};
+
+    if (!fs::is_directory(spool_dir)) {
+        return job_dirs;
+    }
+
+    fs::directory_iterator end;
+
+    for (auto f = fs::directory_iterator(spool_dir); f != end; ++f) {
+        if (!fs::is_directory(f->status())) {
+            continue;
+        }
+
+        if (!isShard(f->path())) {
+            // NB: the spool may contain other directories (archive)
+            if (fs::exists(f->path() / "metadata")) {
+                job_dirs.push_back(f->path().string());
+            }
+            continue;
+        }
+
+        for (auto j = fs::directory_iterator(f->path()); j != end; ++j) {
+            if (fs::is_directory(j->status())) {
+                job_dirs.push_back(j->path().string());
+            }
+        }
+    }
+
+    return job_dirs;
+}
+
+unsigned int migrate(const std::string& spool_dir) {
+    unsigned int num_migrated { 0 };
+    unsigned int num_left { 0 };
+    auto marker_path = (fs::path(spool_dir) / MIGRATED_MARKER).string();
+
+    if (!fs::is_directory(spool_dir) || fs::exists(marker_path)) {
+        return num_migrated;
+    }
+
+    fs::directory_iterator end;
+    std::vector<fs::path> legacy_job_paths {};
+
+    for (auto f = fs::directory_iterator(spool_dir); f != end; ++f) {
+        if (fs::is_directory(f->status()) && !isShard(f->path())) {
+            legacy_job_paths.push_back(f->path());
+        }
+    }
+
+    for (const auto& legacy_job_path : legacy_job_paths) {
+        auto job_id = legacy_job_path.filename().string();
+        auto metadata_file = (legacy_job_path / "metadata").string();
+        std::string txt;
+
+        if (!fs::exists(metadata_file)) {
+            // NB: the spool may contain other directories (archive)
+            continue;
+        }
+
+        try {
+            if (!lth_file::read(metadata_file, txt)
+                    || !lth_jc::JsonContainer(txt).get<bool>("completed")) {
+                num_left++;
+                continue;
+            }
+
+            fs::path job_path { getJobDir(spool_dir, job_id) };
+            fs::create_directories(job_path.parent_path());
+            fs::rename(legacy_job_path, job_path);
+            num_migrated++;
+        } catch (const std::exception& e) {
+            LOG_DEBUG("Not migrating job %1% to the sharded spool layout: %2%",
+                      job_id, e.what());
+            num_left++;
+        }
+    }
+
+    if (num_left == 0) {
+        // The spool won't be scanned again
+        lth_file::atomic_write_to_file("", marker_path);
+    }
+
+    if (num_migrated > 0) {
+        LOG_INFO("Migrated %1% job%2% to the sharded spool layout",
+                 num_migrated, lth_util::plural(num_migrated));
+    }
+
+    return num_migrated;
+}
+
+}  // namespace SpoolLayout
+}  // namespace PXPAgent
@@ -0,0 +1,170 @@
+#include <pxp-agent/spool_outbox.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/strings.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.spool_outbox"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cstdio>   // snprintf
+#include <utility>  // move
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+namespace pcp_util = PCPClient::Util;
+
+static const std::string OUTBOX_DIR_NAME { "outbox" };
+static const std::string MESSAGE_FILE_SUFFIX { ".json" };
+
+SpoolOutbox::SpoolOutbox(const std::string& spool_dir)
+        : outbox_dir_ { (fs::path(spool_dir) / OUTBOX_DIR_NAME).string() },
+          sequence_numbers_ {},
+          taken_sequence_numbers_ {},
+          next_sequence_number_ { 1 },
+          mutex_ {} {
+    if (!fs::is_directory(outbox_dir_)) {
+        return;
+    }
+
+    try {
+        fs::directory_iterator end;
+
+        for (auto f = fs::directory_iterator(outbox_dir_); f != end; ++f) {
+            if (f->path().extension().string() != MESSAGE_FILE_SUFFIX) {
+                continue;
+            }
+
+            try {
+                sequence_numbers_.insert(std::stoull(f->path().stem().string()));
+            } catch (const std::exception&) {
+                LOG_WARNING("Ignoring the unexpected file %1% in the outbox",
+                            f->path().string());
+            }
+        }
+    } catch (const fs::filesystem_error& e) {
+        LOG_ERROR("Failed to list the outbox; the messages it contains will "
+                  "not be delivered: %1%", e.what());
+        sequence_numbers_.clear();
+    }
+
+    if (!sequence_numbers_.empty()) {
+        next_sequence_number_ = *sequence_numbers_.rbegin() + 1;
+        LOG_INFO("Found %1% undelivered message%2% in the outbox",
+                 sequence_numbers_.size(),
+                 lth_util::plural(sequence_numbers_.size()));
+    }
+}
+
+void SpoolOutbox::store(const OutboundQueue::Message& msg) {
+    if (msg.outbox_sequence_number > 0) {
+        pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+
+        // NB: its file is still there; keep its position
+        if (taken_sequence_numbers_.erase(msg.outbox_sequence_number)) {
+            sequence_numbers_.insert(msg.outbox_sequence_number);
+            return;
+        }
+    }
+
+    lth_jc::JsonContainer stored_msg {};
+    stored_msg.set<std::vector<std::string>>("targets", msg.targets);
+    stored_msg.set<std::string>("message_type", msg.message_type);
+    stored_msg.set<lth_jc::JsonContainer>("data", msg.data);
+    stored_msg.set<std::string>("description", msg.description);
+
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto sequence_number = next_sequence_number_;
+
+    try {
+        if (!fs::exists(outbox_dir_)) {
+            fs::create_directories(outbox_dir_);
+        }
+
+        lth_file::atomic_write_to_file(stored_msg.toString() + "\n",
+                                       getFilePath(sequence_number));
+    } catch (const std::exception& e) {
+        throw Error { "failed to store the " + msg.description + ": " + e.what() };
+    }
+
+    sequence_numbers_.insert(sequence_number);
+    next_sequence_number_++;
+}
+
+std::vector<OutboundQueue::Message> SpoolOutbox::take(size_t max_messages) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    std::vector<OutboundQueue::Message> messages {};
+
+    while (!sequence_numbers_.empty() && messages.size() < max_messages) {
+        auto sequence_number = *sequence_numbers_.begin();
+        auto file_path = getFilePath(sequence_number);
+        sequence_numbers_.erase(sequence_numbers_.begin());
+        std::string txt;
+
+        try {
+            if (!lth_file::read(file_path, txt)) {
+                throw Error { "failed to read the file" };
+            }
+
+            lth_jc::JsonContainer stored_msg { txt };
+            messages.push_back(OutboundQueue::Message {
+                stored_msg.get<std::vector<std::string>>("targets"),
+                stored_msg.get<std::string>("message_type"),
+                stored_msg.get<lth_jc::JsonContainer>("data"),
+                {},
+                stored_msg.get<std::string>("description"),
+                true,
+                sequence_number,
+                "" });
+        } catch (const std::exception& e) {
+            LOG_ERROR("Removing the invalid outbox file %1%: %2%",
+                      file_path, e.what());
+            boost::system::error_code ec;
+            fs::remove(file_path, ec);
+            continue;
+        }
+
+        taken_sequence_numbers_.insert(sequence_number);
+    }
+
+    return messages;
+}
+
+void SpoolOutbox::remove(uint64_t sequence_number) {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    auto file_path = getFilePath(sequence_number);
+    taken_sequence_numbers_.erase(sequence_number);
+
+    boost::system::error_code ec;
+    fs::remove(file_path, ec);
+
+    if (ec) {
+        LOG_WARNING("Failed to remove the outbox file %1% of a delivered "
+                    "message: %2%", file_path, ec.message());
+    }
+}
+
+size_t SpoolOutbox::size() {
+    pcp_util::lock_guard<pcp_util::mutex> the_lock { mutex_ };
+    return sequence_numbers_.size() + taken_sequence_numbers_.size();
+}
+
+//
+// Private interface
+//
+
+std::string SpoolOutbox::getFilePath(uint64_t sequence_number) const {
+    char buffer[21];
+    std::snprintf(buffer, sizeof(buffer), "%020llu",
+                  static_cast<unsigned long long>(sequence_number));
+    return (fs::path(outbox_dir_) / (buffer + MESSAGE_FILE_SUFFIX)).string();
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,460 @@
+#include <pxp-agent/spool_recovery.hpp>
+#include <pxp-agent/util/process.hpp>
+#include <pxp-agent/spool_layout.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/strings.hpp>
+#include <leatherman/util/timer.hpp>
+
+#define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.spool_recovery"
+#include <leatherman/logging/logging.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>  // min, max
+#include <cstdlib>    // EXIT_FAILURE
+#include <ctime>      // time_t
+#include <sstream>
+#include <stdexcept>  // invalid_argument, out_of_range
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+// Return the integer stored in the specified file; throw a
+// std::runtime_error in case of failure
+static int readIntFrom(const std::string& file_path) {
+    std::string txt;
+
+    if (!fs::exists(file_path)) {
+        throw std::runtime_error { "file does not exist" };
+    }
+
+    if (!lth_file::read(file_path, txt) || txt.empty()) {
+        throw std::runtime_error { "failed to read" };
+    }
+
+    try {
+        return std::stoi(txt);
+    } catch (const std::invalid_argument&) {
+        throw std::runtime_error { "invalid content '" + txt + "'" };
+    } catch (const std::out_of_range&) {
+        throw std::runtime_error { "invalid content '" + txt + "'" };
+    }
+}
+
+// Retrieve the PID and the start time of the process stored in the
+// specified file; the start time is 0 if not stored (see
+// Util::processExists). Throw a std::runtime_error in case of failure
+static void readPidFrom(const std::string& file_path,
+                        int& pid,
+                        uint64_t& start_time) {
+    std::string txt;
+
+    if (!fs::exists(file_path)) {
+        throw std::runtime_error { "file does not exist" };
+    }
+
+    if (!lth_file::read(file_path, txt)) {
+        throw std::runtime_error { "failed to read" };
+    }
+
+    std::istringstream pid_txt { txt };
+
+    if (!(pid_txt >> pid)) {
+        throw std::runtime_error { "invalid content '" + txt + "'" };
+    }
+
+    if (!(pid_txt >> start_time)) {
+        start_time = 0;
+    }
+}
+
+// Duration of an adopted job, as for the jobs executed by this run
+// (see RequestProcessor); the job starts when its pid file is
+// written and ends when its exit code is stored, so the duration is
+// approximated by the modification times of these files (1 s
+// resolution). Return an empty string in case of failure
+static std::string getAdoptedJobDuration(const fs::path& job_path) {
+    boost::system::error_code ec;
+    auto start = fs::last_write_time(job_path / "pid", ec);
+
+    if (ec) {
+        return "";
+    }
+
+    auto end = fs::last_write_time(job_path / "exitcode", ec);
+
+    if (ec) {
+        return "";
+    }
+
+    return std::to_string(static_cast<double>(std::max<std::time_t>(end - start, 0)))
+           + " s";
+}
+
+static lth_jc::JsonContainer readMetadata(const std::string& job_dir) {
+    auto metadata_file = (fs::path(job_dir) / "metadata").string();
+    std::string txt;
+
+    if (!lth_file::read(metadata_file, txt)) {
+        throw std::runtime_error { "failed to read " + metadata_file };
+    }
+
+    try {
+        return lth_jc::JsonContainer { txt };
+    } catch (const lth_jc::data_parse_error& e) {
+        throw std::runtime_error { "invalid metadata: " + std::string(e.what()) };
+    }
+}
+
+SpoolRecovery::SpoolRecovery(const std::string& spool_dir,
+                             std::shared_ptr<PXPConnector> connector_ptr,
+                             std::shared_ptr<JobIndex> index_ptr)
+        : spool_dir_ { spool_dir },
+          connector_ptr_ { connector_ptr },
+          index_ptr_ { index_ptr },
+          scanned_ { false },
+          running_jobs_ {},
+          exited_jobs_ {},
+          stopping_ { false },
+          thread_container_ { "Job Adopter" } {
+}
+
+SpoolRecovery::~SpoolRecovery() {
+    stopping_ = true;
+    thread_container_.waitForAll(2 * ADOPTED_JOB_WAIT_INTERVAL_MS);
+}
+
+SpoolRecovery::ScanReport SpoolRecovery::scan(
+        const std::set<std::string>& ignored_job_ids) {
+    lth_util::Timer timer {};
+    ScanReport report { 0, 0, 0, 0, 0, 0, 0 };
+    std::vector<std::string> job_dirs {};
+
+    for (auto& job_dir : SpoolLayout::listJobDirs(spool_dir_)) {
+        if (!ignored_job_ids.count(fs::path(job_dir).filename().string())) {
+            job_dirs.push_back(std::move(job_dir));
+        }
+    }
+
+    // Each thread classifies a slice of the jobs; the outcome is then
+    // collected by this thread, so no locking is needed
+    auto num_threads = std::min<size_t>(
+        std::max(1u, std::min(SPOOL_SCAN_MAX_THREADS,
+                              PCPClient::Util::thread::hardware_concurrency())),
+        job_dirs.size());
+    std::vector<std::pair<JobClass, int>> outcomes(job_dirs.size());
+    std::vector<PCPClient::Util::thread> scanners {};
+
+    // NB: a single scan of the process table for all jobs
+    const Util::ProcessSnapshot processes {};
+
+    for (size_t t_idx = 0; t_idx < num_threads; t_idx++) {
+        scanners.push_back(PCPClient::Util::thread(
+            [this, t_idx, num_threads, &job_dirs, &outcomes, &processes]() {
+                for (auto idx = t_idx; idx < job_dirs.size(); idx += num_threads) {
+                    outcomes[idx].first = classifyJob(job_dirs[idx],
+                                                      processes,
+                                                      outcomes[idx].second);
+                }
+            }));
+    }
+
+    for (auto& scanner : scanners) {
+        scanner.join();
+    }
+
+    running_jobs_.clear();
+    exited_jobs_.clear();
+
+    for (size_t idx = 0; idx < job_dirs.size(); idx++) {
+        switch (outcomes[idx].first) {
+            case JobClass::Completed:
+                report.num_completed++;
+                break;
+            case JobClass::Running:
+#ifndef _WIN32
+                indexJob(job_dirs[idx]);
+                running_jobs_.push_back(
+                    std::make_pair(job_dirs[idx], outcomes[idx].second));
+#endif
+                // NB: on Windows the exit code of jobs is not stored,
+                // so adopting them would not tell their outcome; the
+                // status module checks their process instead
+                report.num_running++;
+                break;
+            case JobClass::Exited:
+                // NB: removed from the index once finalized
+                indexJob(job_dirs[idx]);
+                exited_jobs_.push_back(job_dirs[idx]);
+                report.num_exited++;
+                break;
+            case JobClass::Interrupted:
+                report.num_interrupted++;
+                break;
+            case JobClass::Invalid:
+                report.num_invalid++;
+                break;
+        }
+    }
+
+    scanned_ = true;
+    report.num_jobs = static_cast<unsigned int>(job_dirs.size());
+    report.duration_ms = timer.elapsed_milliseconds();
+
+    LOG_INFO("Scanned %1% job%2% in the spool in %3% ms with %4% thread%5%: "
+             "%6% completed, %7% running, %8% exited while pxp-agent was not "
+             "running, %9% interrupted, %10% invalid",
+             report.num_jobs, lth_util::plural(report.num_jobs),
+             report.duration_ms, num_threads, lth_util::plural(num_threads),
+             report.num_completed, report.num_running, report.num_exited,
+             report.num_interrupted, report.num_invalid);
+
+    return report;
+}
+
+unsigned int SpoolRecovery::adoptJobs() {
+    if (!scanned_) {
+        scan();
+    }
+
+    unsigned int num_adopted { 0 };
+    unsigned int num_finalized { 0 };
+
+    for (const auto& job : running_jobs_) {
+        LOG_INFO("Adopting job %1%; its process (PID %2%) is still executing",
+                 fs::path(job.first).filename().string(), job.second);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        thread_container_.add(
+            PCPClient::Util::thread(&SpoolRecovery::watchJob,
+                                    this, job.first, job.second, done),
+            done);
+        num_adopted++;
+    }
+
+    for (const auto& job_dir : exited_jobs_) {
+        try {
+            if (finalizeJob(job_dir)) {
+                num_finalized++;
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to finalize the job in %1%: %2%", job_dir, e.what());
+        }
+
+        unindexJob(job_dir);
+    }
+
+    running_jobs_.clear();
+    exited_jobs_.clear();
+
+    if (num_adopted + num_finalized > 0) {
+        LOG_INFO("Adopted %1% running job%2%; finalized %3% job%4% that "
+                 "completed while pxp-agent was not running",
+                 num_adopted, lth_util::plural(num_adopted),
+                 num_finalized, lth_util::plural(num_finalized));
+    }
+
+    return num_adopted;
+}
+
+void SpoolRecovery::failJob(const JobJournal::Entry& job,
+                            const std::string& reason) {
+    fs::path job_path { SpoolLayout::findJobDir(spool_dir_, job.job_id) };
+
+    LOG_WARNING("Failing job %1% ('%2% %3%' requested by %4%): %5%",
+                job.job_id, job.module, job.action, job.requester, reason);
+
+    try {
+        auto metadata = readMetadata(job_path.string());
+        metadata.set<bool>("completed", true);
+        metadata.set<int>("exitcode", EXIT_FAILURE);
+        metadata.set<std::string>("exec_error", reason);
+        lth_file::atomic_write_to_file(metadata.toString() + "\n",
+                                       (job_path / "metadata").string());
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to update the metadata of job %1%: %2%",
+                  job.job_id, e.what());
+    }
+
+    connector_ptr_->sendPXPError(job.requester, job.request_id, job.job_id,
+                                 reason);
+}
+
+unsigned int SpoolRecovery::getNumWatchedJobs() {
+    return thread_container_.getNumRunningThreads();
+}
+
+//
+// Private interface
+//
+
+SpoolRecovery::JobClass SpoolRecovery::classifyJob(
+        const std::string& job_dir,
+        const Util::ProcessSnapshot& processes,
+        int& pid) {
+    fs::path job_path { job_dir };
+
+    try {
+        auto metadata = readMetadata(job_dir);
+
+        if (!metadata.includes("completed")) {
+            LOG_DEBUG("The metadata of job %1% is missing the 'completed' "
+                      "entry", job_path.filename().string());
+            return JobClass::Invalid;
+        }
+
+        if (metadata.get<bool>("completed")) {
+            return JobClass::Completed;
+        }
+    } catch (const std::exception& e) {
+        LOG_DEBUG("Cannot classify job %1%: %2%",
+                  job_path.filename().string(), e.what());
+        return JobClass::Invalid;
+    }
+
+    try {
+        uint64_t start_time;
+        readPidFrom((job_path / "pid").string(), pid, start_time);
+
+        if (processes.processExists(pid, start_time)) {
+            return JobClass::Running;
+        }
+    } catch (const std::exception& e) {
+        LOG_DEBUG("Cannot retrieve the PID of job %1%: %2%",
+                  job_path.filename().string(), e.what());
+    }
+
+    if (fs::exists(job_path / "exitcode")) {
+        return JobClass::Exited;
+    }
+
+    try {
+        flagInterrupted(job_dir);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to flag job %1% as interrupted: %2%",
+                  job_path.filename().string(), e.what());
+    }
+
+    return JobClass::Interrupted;
+}
+
+void SpoolRecovery::flagInterrupted(const std::string& job_dir) {
+    auto metadata = readMetadata(job_dir);
+
+    metadata.set<bool>("completed", true);
+    metadata.set<bool>("interrupted", true);
+    metadata.set<int>("exitcode", EXIT_FAILURE);
+    metadata.set<std::string>("exec_error", "the job process terminated "
+                                            "without storing its exit code; "
+                                            "its outcome is unknown");
+    lth_file::atomic_write_to_file(metadata.toString() + "\n",
+                                   (fs::path(job_dir) / "metadata").string());
+
+    LOG_DEBUG("Flagged the job in %1% as interrupted", job_dir);
+}
+
+void SpoolRecovery::indexJob(const std::string& job_dir) {
+    if (index_ptr_) {
+        index_ptr_->set(fs::path(job_dir).filename().string(), job_dir);
+    }
+}
+
+void SpoolRecovery::unindexJob(const std::string& job_dir) {
+    if (index_ptr_) {
+        index_ptr_->remove(fs::path(job_dir).filename().string());
+    }
+}
+
+void SpoolRecovery::watchJob(std::string job_dir,
+                             int pid,
+                             std::shared_ptr<std::atomic<bool>> done) {
+    while (!Util::waitForProcessExit(pid, ADOPTED_JOB_WAIT_INTERVAL_MS)) {
+        if (stopping_) {
+            *done = true;
+            return;
+        }
+    }
+
+    try {
+        if (!finalizeJob(job_dir)) {
+            LOG_WARNING("The process of the adopted job in %1% terminated "
+                        "without storing its exit code; cannot determine "
+                        "the job outcome", job_dir);
+            flagInterrupted(job_dir);
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to finalize the adopted job in %1%: %2%",
+                  job_dir, e.what());
+    }
+
+    // NB: even if not finalized, the process is no longer executing
+    unindexJob(job_dir);
+
+    *done = true;
+}
+
+bool SpoolRecovery::finalizeJob(const std::string& job_dir) {
+    fs::path job_path { job_dir };
+    auto exitcode_file = (job_path / "exitcode").string();
+
+    if (!fs::exists(exitcode_file)) {
+        return false;
+    }
+
+    auto exit_code = readIntFrom(exitcode_file);
+    auto metadata = readMetadata(job_dir);
+    auto job_id = job_path.filename().string();
+
+    metadata.set<bool>("completed", true);
+    metadata.set<int>("exitcode", exit_code);
+    metadata.set<std::string>("exec_error", "");
+    metadata.set<bool>("adopted", true);
+
+    auto duration = getAdoptedJobDuration(job_path);
+
+    if (!duration.empty()) {
+        metadata.set<std::string>("duration", duration);
+    }
+    lth_file::atomic_write_to_file(metadata.toString() + "\n",
+                                   (job_path / "metadata").string());
+
+    LOG_INFO("Adopted job %1% has completed (exit code %2%)", job_id, exit_code);
+
+    if (!metadata.includes("notify_outcome")
+            || !metadata.get<bool>("notify_outcome")
+            || !metadata.includes("requester")) {
+        return true;
+    }
+
+    auto requester = metadata.get<std::string>("requester");
+    auto request_id = metadata.get<std::string>("request_id");
+    auto transaction_id = metadata.get<std::string>("transaction_id");
+    std::string out_txt;
+
+    if (!lth_file::read((job_path / "stdout").string(), out_txt)) {
+        LOG_ERROR("Failed to read the output of adopted job %1%", job_id);
+    }
+
+    try {
+        lth_jc::JsonContainer results { out_txt };
+        connector_ptr_->sendNonBlockingResponse(requester, transaction_id,
+                                                std::move(results), job_id);
+    } catch (const lth_jc::data_parse_error& e) {
+        LOG_ERROR("The output of adopted job %1% is not valid JSON: %2%",
+                  job_id, e.what());
+        connector_ptr_->sendPXPError(requester, request_id, transaction_id,
+                                     "'" + metadata.get<std::string>("module")
+                                     + " " + metadata.get<std::string>("action")
+                                     + "' returned invalid JSON");
+    }
+
+    return true;
+}
+
+}  // namespace PXPAgent
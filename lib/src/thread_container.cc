@@ -2,7 +2,9 @@
 
 #include <cpp-pcp-client/util/chrono.hpp>
 
-#include <algorithm>  // remove_if
+#include <leatherman/util/strings.hpp>
+
+#include <algorithm>  // remove_if, all_of, count_if
 #include <iterator>   // distance
 
 #define LEATHERMAN_LOGGING_NAMESPACE "puppetlabs.pxp_agent.thread_container"
@@ -10,6 +12,8 @@
 
 namespace PXPAgent {
 
+namespace lth_util = leatherman::util;
+
 // Check if the thread has completed; if so, and if it's joinable,
 // detach it. Return true if completed, false otherwise.
 bool detachIfCompleted(std::shared_ptr<ManagedThread> thread_ptr) {
@@ -63,17 +67,22 @@ ThreadContainer::~ThreadContainer() {
     }
 
     // Detach the completed threads
-    bool all_detached { true };
+    uint32_t num_running { 0 };
     for (auto thread_ptr : threads_) {
         if (!detachIfCompleted(thread_ptr)) {
-            all_detached = false;
+            // Detach it anyway, otherwise std::terminate would be
+            // invoked when deleting the thread object
+            if (thread_ptr->the_instance.joinable()) {
+                thread_ptr->the_instance.detach();
+            }
+            num_running++;
         }
     }
 
-    if (!all_detached) {
-        // NB: std::terminate will be invoked
-        LOG_WARNING("Not all threads stored by the '%1%' ThreadContainer have "
-                    "completed; pxp-agent will not terminate gracefully", name_);
+    if (num_running > 0) {
+        LOG_WARNING("Detached %1% thread%2% stored by the '%3%' "
+                    "ThreadContainer that did not complete their execution",
+                    num_running, lth_util::plural(num_running), name_);
     }
 }
 
@@ -108,6 +117,32 @@ bool ThreadContainer::isMonitoring() {
     return is_monitoring_;
 }
 
+bool ThreadContainer::waitForAll(uint32_t timeout_ms) {
+    auto deadline = PCPClient::Util::chrono::steady_clock::now()
+                    + PCPClient::Util::chrono::milliseconds(timeout_ms);
+
+    while (true) {
+        {
+            PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+            auto all_done = std::all_of(threads_.begin(),
+                                        threads_.end(),
+                                        [](std::shared_ptr<ManagedThread> t_ptr) {
+                                            return t_ptr->is_done->load();
+                                        });
+            if (all_done) {
+                return true;
+            }
+        }
+
+        if (PCPClient::Util::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+
+        PCPClient::Util::this_thread::sleep_for(
+            PCPClient::Util::chrono::milliseconds(THREADS_WAIT_INTERVAL_MS));
+    }
+}
+
 uint32_t ThreadContainer::getNumAddedThreads() {
     PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
     return num_added_threads_;
@@ -118,6 +153,16 @@ uint32_t ThreadContainer::getNumErasedThreads() {
     return num_erased_threads_;
 }
 
+uint32_t ThreadContainer::getNumRunningThreads() {
+    PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
+    return static_cast<uint32_t>(std::count_if(
+        threads_.begin(),
+        threads_.end(),
+        [](const std::shared_ptr<ManagedThread>& t_ptr) {
+            return !t_ptr->is_done->load();
+        }));
+}
+
 void ThreadContainer::setName(const std::string& name) {
     PCPClient::Util::lock_guard<PCPClient::Util::mutex> the_lock { mutex_ };
     name_ = name;
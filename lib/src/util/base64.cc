@@ -0,0 +1,93 @@
+#include <pxp-agent/util/base64.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace PXPAgent {
+namespace Util {
+
+static const char ALPHABET[] {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" };
+
+// Return the 6-bit value of the base64 character, or -1 if invalid
+static int decodeChar(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+std::string base64Encode(const std::string& data) {
+    std::string txt {};
+    txt.reserve(4 * ((data.size() + 2) / 3));
+    size_t idx { 0 };
+
+    for (; idx + 2 < data.size(); idx += 3) {
+        uint32_t group = (static_cast<unsigned char>(data[idx]) << 16)
+                         | (static_cast<unsigned char>(data[idx + 1]) << 8)
+                         | static_cast<unsigned char>(data[idx + 2]);
+        txt.push_back(ALPHABET[(group >> 18) & 0x3F]);
+        txt.push_back(ALPHABET[(group >> 12) & 0x3F]);
+        txt.push_back(ALPHABET[(group >> 6) & 0x3F]);
+        txt.push_back(ALPHABET[group & 0x3F]);
+    }
+
+    if (idx < data.size()) {
+        uint32_t group = static_cast<unsigned char>(data[idx]) << 16;
+
+        if (idx + 1 < data.size()) {
+            group |= static_cast<unsigned char>(data[idx + 1]) << 8;
+        }
+
+        txt.push_back(ALPHABET[(group >> 18) & 0x3F]);
+        txt.push_back(ALPHABET[(group >> 12) & 0x3F]);
+        txt.push_back(idx + 1 < data.size() ? ALPHABET[(group >> 6) & 0x3F] : '=');
+        txt.push_back('=');
+    }
+
+    return txt;
+}
+
+std::string base64Decode(const std::string& txt) {
+    if (txt.size() % 4 != 0) {
+        throw std::invalid_argument { "invalid base64 length" };
+    }
+
+    std::string data {};
+    data.reserve(3 * (txt.size() / 4));
+
+    for (size_t idx = 0; idx < txt.size(); idx += 4) {
+        auto last_group = (idx + 4 == txt.size());
+        auto num_padding = (last_group && txt[idx + 3] == '=')
+                           ? (txt[idx + 2] == '=' ? 2 : 1)
+                           : 0;
+        uint32_t group { 0 };
+
+        for (auto pos = 0; pos < 4; pos++) {
+            auto value = (pos >= 4 - num_padding) ? 0 : decodeChar(txt[idx + pos]);
+
+            if (value < 0) {
+                throw std::invalid_argument { "invalid base64 character" };
+            }
+
+            group = (group << 6) | static_cast<uint32_t>(value);
+        }
+
+        data.push_back(static_cast<char>((group >> 16) & 0xFF));
+
+        if (num_padding < 2) {
+            data.push_back(static_cast<char>((group >> 8) & 0xFF));
+        }
+
+        if (num_padding < 1) {
+            data.push_back(static_cast<char>(group & 0xFF));
+        }
+    }
+
+    return data;
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
@@ -11,6 +11,11 @@
 #include <sys/stat.h>       // umask()
 #include <signal.h>
 #include <stdio.h>
+#include <errno.h>
+#include <string.h>         // strerror()
+#include <fcntl.h>          // fcntl()
+
+#include <cassert>
 
 #include <memory>
 #include <vector>
@@ -21,15 +26,18 @@ namespace Util {
 const mode_t UMASK_FLAGS { 002 };
 const std::string DEFAULT_DAEMON_WORKING_DIR = "/";
 
-static void sigHandler(int sig) {
-    // NOTE(ale): if issued by the init process, between SIGTERM and
-    // the successive SIGKILL there are only 5 s - must be fast
-    auto pidfile = Configuration::Instance().get<std::string>("pidfile");
-    LOG_INFO("Caught signal %1% - removing PID file '%2%'",
-             std::to_string(sig), pidfile);
-    PIDFile pidf { pidfile };
-    pidf.cleanup();
-    exit(EXIT_SUCCESS);
+// Self-pipe used to pass the caught termination signals to the
+// thread waiting for them
+static int termination_pipe[2] { -1, -1 };
+
+static void terminationSigHandler(int sig) {
+    // NB: write() is async-signal-safe; nothing else is done here
+    unsigned char sig_byte = static_cast<unsigned char>(sig);
+    auto saved_errno = errno;
+    if (write(termination_pipe[1], &sig_byte, 1) == -1) {
+        // Nothing we can safely do
+    }
+    errno = saved_errno;
 }
 
 static void dumbSigHandler(int sig) {}
@@ -226,13 +234,8 @@ std::unique_ptr<PIDFile> daemonize() {
 
     // Change signal dispositions
     // HERE(ale): don't touch SIGUSR2; it's used to reopen the logfile
-
-    for (auto s : std::vector<int> { SIGINT, SIGTERM, SIGQUIT }) {
-        if (signal(s, sigHandler) == SIG_ERR) {
-            LOG_ERROR("Failed to set signal handler for sig %1%", s);
-            removeLockAndExit();
-        }
-    }
+    // NB: the termination signals are handled by the caller (refer
+    // to setTerminationSignalHandlers)
 
     signal(SIGCHLD, SIG_DFL);
     signal(SIGTSTP, SIG_IGN);
@@ -267,5 +270,38 @@ std::unique_ptr<PIDFile> daemonize() {
     return std::move(pidf_ptr);
 }
 
+void setTerminationSignalHandlers() {
+    if (termination_pipe[0] == -1 && pipe(termination_pipe) == -1) {
+        LOG_ERROR("Failed to create the pipe for termination signals; "
+                  "%1% (%2%)", strerror(errno), errno);
+        return;
+    }
+
+    // Don't let the spawned module processes inherit the pipe
+    fcntl(termination_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(termination_pipe[1], F_SETFD, FD_CLOEXEC);
+
+    for (auto s : std::vector<int> { SIGINT, SIGTERM, SIGQUIT }) {
+        if (signal(s, terminationSigHandler) == SIG_ERR) {
+            LOG_ERROR("Failed to set signal handler for sig %1%", s);
+        }
+    }
+}
+
+int waitForTerminationSignal() {
+    assert(termination_pipe[0] != -1);
+    unsigned char sig_byte { 0 };
+
+    while (read(termination_pipe[0], &sig_byte, 1) != 1) {
+        if (errno != EINTR) {
+            LOG_ERROR("Failed to read the termination signal pipe; %1% (%2%)",
+                      strerror(errno), errno);
+            return SIGTERM;
+        }
+    }
+
+    return static_cast<int>(sig_byte);
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
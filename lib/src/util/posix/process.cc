@@ -2,7 +2,20 @@
 
 #include <signal.h>
 #include <errno.h>
-#include <unistd.h>         // getpid()
+#include <unistd.h>         // getpid(), close()
+#include <poll.h>           // poll()
+#include <sys/syscall.h>    // SYS_pidfd_open (Linux >= 5.3)
+#include <dirent.h>         // opendir(), readdir()
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <algorithm>        // min
+#include <cctype>           // isdigit
+#include <cstdlib>          // atoi
+#include <fstream>
+#include <sstream>
+#include <string>
 
 namespace PXPAgent {
 namespace Util {
@@ -26,9 +39,158 @@ bool processExists(int pid) {
     return true;
 }
 
+// Retrieve the state and the start time of the process from
+// /proc/<pid>/stat; return false if the file can't be parsed
+static bool readProcStat(int pid, char& state, uint64_t& start_time) {
+#ifdef __linux__
+    std::ifstream stat_file { "/proc/" + std::to_string(pid) + "/stat" };
+    std::string stat;
+
+    if (!std::getline(stat_file, stat)) {
+        return false;
+    }
+
+    // NB: the command name (2nd field) is enclosed in parentheses
+    // and may contain spaces; the start time is the 22nd field
+    auto comm_end = stat.rfind(')');
+
+    if (comm_end == std::string::npos) {
+        return false;
+    }
+
+    std::istringstream fields { stat.substr(comm_end + 1) };
+    std::string skipped;
+    fields >> state;
+
+    for (auto idx = 4; idx < 22; idx++) {
+        fields >> skipped;
+    }
+
+    fields >> start_time;
+    return !fields.fail();
+#else
+    (void)pid;
+    (void)state;
+    (void)start_time;
+    return false;
+#endif
+}
+
+bool processExists(int pid, uint64_t start_time) {
+    if (start_time == 0) {
+        return processExists(pid);
+    }
+
+    char state;
+    uint64_t current_start_time;
+
+    if (!readProcStat(pid, state, current_start_time)) {
+        // The process is not executing, unless /proc is not available
+        return getProcessStartTime(getpid()) == 0 && processExists(pid);
+    }
+
+    return state != 'Z' && state != 'X' && current_start_time == start_time;
+}
+
+uint64_t getProcessStartTime(int pid) {
+    char state;
+    uint64_t start_time;
+    return readProcStat(pid, state, start_time) ? start_time : 0;
+}
+
 int getPid() {
     return getpid();
 }
 
+// Interval between liveness checks, when a process descriptor can't
+// be obtained
+static const uint32_t PROCESS_CHECK_INTERVAL_MS { 100 };
+
+bool waitForProcessExit(int pid, uint32_t timeout_ms) {
+#ifdef SYS_pidfd_open
+    // A pidfd becomes readable once the process terminates
+    auto pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pid_fd >= 0) {
+        struct pollfd poll_fd { pid_fd, POLLIN, 0 };
+        int poll_result;
+        do {
+            poll_result = poll(&poll_fd, 1, static_cast<int>(timeout_ms));
+        } while (poll_result == -1 && errno == EINTR);
+        close(pid_fd);
+
+        if (poll_result != -1) {
+            return poll_result > 0;
+        }
+    } else if (errno == ESRCH) {
+        return true;
+    }
+    // Not supported by the kernel; poll the PID
+#endif
+
+    namespace pcp_chrono = PCPClient::Util::chrono;
+    auto deadline = pcp_chrono::steady_clock::now()
+                    + pcp_chrono::milliseconds(timeout_ms);
+
+    while (processExists(pid)) {
+        auto now = pcp_chrono::steady_clock::now();
+        if (now >= deadline) {
+            return false;
+        }
+
+        auto left_ms = pcp_chrono::duration_cast<pcp_chrono::milliseconds>(
+            deadline - now).count();
+        PCPClient::Util::this_thread::sleep_for(pcp_chrono::milliseconds(
+            std::min(static_cast<int64_t>(PROCESS_CHECK_INTERVAL_MS),
+                     static_cast<int64_t>(left_ms))));
+    }
+
+    return true;
+}
+
+ProcessSnapshot::ProcessSnapshot()
+        : scanned_ { false },
+          start_times_ {} {
+#ifdef __linux__
+    auto proc_dir = opendir("/proc");
+
+    if (proc_dir == nullptr) {
+        return;
+    }
+
+    while (auto entry = readdir(proc_dir)) {
+        if (!std::isdigit(static_cast<unsigned char>(entry->d_name[0]))) {
+            continue;
+        }
+
+        auto pid = std::atoi(entry->d_name);
+        char state;
+        uint64_t start_time;
+
+        // NB: the process may have terminated in the meantime
+        if (readProcStat(pid, state, start_time)
+                && state != 'Z' && state != 'X') {
+            start_times_[pid] = start_time;
+        }
+    }
+
+    closedir(proc_dir);
+    scanned_ = true;
+#endif
+}
+
+bool ProcessSnapshot::processExists(int pid, uint64_t start_time) const {
+    if (!scanned_) {
+        return Util::processExists(pid, start_time);
+    }
+
+    auto process = start_times_.find(pid);
+
+    if (process == start_times_.end()) {
+        return false;
+    }
+
+    return start_time == 0 || process->second == start_time;
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
@@ -0,0 +1,42 @@
+#include <pxp-agent/util/sync_file.hpp>
+
+#ifdef _WIN32
+    #include <io.h>         // _commit(), _fileno()
+#else
+    #include <fcntl.h>      // open()
+    #include <unistd.h>     // fsync(), fileno(), close()
+#endif
+
+namespace PXPAgent {
+namespace Util {
+
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool syncDirectory(const std::string& dir_path) {
+#ifdef _WIN32
+    // NB: directory entries cannot be synced on Windows
+    (void)dir_path;
+    return true;
+#else
+    auto dir_fd = open(dir_path.data(), O_RDONLY);
+
+    if (dir_fd < 0) {
+        return false;
+    }
+
+    auto ok = fsync(dir_fd) == 0;
+    return (close(dir_fd) == 0) && ok;
+#endif
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
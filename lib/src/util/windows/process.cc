@@ -23,9 +23,73 @@ bool processExists(int pid) {
     return false;
 }
 
+// Return the creation time of the process, or 0 in case of failure
+static uint64_t getCreationTime(HANDLE p_handle) {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+
+    if (!GetProcessTimes(p_handle, &creation_time, &exit_time,
+                         &kernel_time, &user_time)) {
+        return 0;
+    }
+
+    return (static_cast<uint64_t>(creation_time.dwHighDateTime) << 32)
+           | creation_time.dwLowDateTime;
+}
+
+bool processExists(int pid, uint64_t start_time) {
+    if (start_time == 0) {
+        return processExists(pid);
+    }
+
+    auto p_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!p_handle) {
+        return false;
+    }
+
+    DWORD exit_code;
+    auto executing = GetExitCodeProcess(p_handle, &exit_code)
+                     && exit_code == STILL_ACTIVE
+                     && getCreationTime(p_handle) == start_time;
+    CloseHandle(p_handle);
+    return executing;
+}
+
+uint64_t getProcessStartTime(int pid) {
+    auto p_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!p_handle) {
+        return 0;
+    }
+
+    auto start_time = getCreationTime(p_handle);
+    CloseHandle(p_handle);
+    return start_time;
+}
+
 int getPid() {
     return GetCurrentProcessId();
 }
 
+bool waitForProcessExit(int pid, uint32_t timeout_ms) {
+    auto p_handle = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!p_handle) {
+        LOG_TRACE("OpenProcess failure while waiting for PID %1%: %2%",
+                  pid, lth_win::system_error());
+        return !processExists(pid);
+    }
+
+    auto wait_result = WaitForSingleObject(p_handle, timeout_ms);
+    CloseHandle(p_handle);
+    return wait_result == WAIT_OBJECT_0;
+}
+
+ProcessSnapshot::ProcessSnapshot()
+        : scanned_ { false },
+          start_times_ {} {
+}
+
+bool ProcessSnapshot::processExists(int pid, uint64_t start_time) const {
+    return Util::processExists(pid, start_time);
+}
+
 }  // namespace Util
 }  // namespace PXPAgent
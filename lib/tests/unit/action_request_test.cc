@@ -38,13 +38,34 @@ TEST_CASE("ActionRequest::ActionRequest", "[request]") {
                           ActionRequest::Error);
     }
 
-    SECTION("throw a ActionRequest::Error if binary data") {
+    SECTION("throw a ActionRequest::Error if binary data has no header") {
         const PCPClient::ParsedChunks p_c { envelope, "bin data", debug, 0 };
 
         REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
                           ActionRequest::Error);
     }
 
+    SECTION("throw a ActionRequest::Error if binary data has invalid header") {
+        const PCPClient::ParsedChunks p_c { envelope,
+                                            "{\"module\" : \"foo\"}\nbin data",
+                                            debug, 0 };
+
+        REQUIRE_THROWS_AS(ActionRequest(RequestType::Blocking, p_c),
+                          ActionRequest::Error);
+    }
+
+    SECTION("successfully instantiates with binary data") {
+        std::string blob { "bin\ndata\0\xff", 10 };
+        const PCPClient::ParsedChunks p_c { envelope, data.toString() + "\n" + blob,
+                                            debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+
+        REQUIRE(a_r.hasBlob());
+        REQUIRE(a_r.blob() == blob);
+        REQUIRE(a_r.module() == "module name");
+        REQUIRE(a_r.params().get<std::string>("some key") == "some value");
+    }
+
     SECTION("throw a ActionRequest::Error if invalid data") {
         const PCPClient::ParsedChunks p_c { envelope, false, debug, 0 };
 
@@ -112,6 +133,74 @@ TEST_CASE("ActionRequest getters", "[request]") {
         SECTION("paramsTxt") {
             REQUIRE(a_r.paramsTxt() == params.toString());
         }
+
+        SECTION("acceptEncoding") {
+            REQUIRE(a_r.acceptEncoding().empty());
+        }
+
+        SECTION("debug") {
+            REQUIRE(a_r.debug());
+            REQUIRE(a_r.debug()->empty());
+        }
+
+        SECTION("timing") {
+            REQUIRE_FALSE(a_r.timing());
+        }
+
+        SECTION("timeline") {
+            a_r.stamp(RequestTimeline::Event::Validated);
+            REQUIRE(a_r.timeline().elapsedMicroseconds(
+                        RequestTimeline::Event::Validated) >= 0);
+        }
+    }
+
+    SECTION("moves the debug chunks out of the parsed chunks") {
+        std::vector<lth_jc::JsonContainer> hops_debug {
+            lth_jc::JsonContainer { "{ \"hops\" : [] }" } };
+        const PCPClient::ParsedChunks p_c { envelope, data, hops_debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+
+        REQUIRE(a_r.debug()->size() == 1u);
+        REQUIRE(a_r.debug()->front().toString() == hops_debug[0].toString());
+        REQUIRE(a_r.parsedChunks().debug.empty());
+    }
+
+    SECTION("get the accepted encoding of the results") {
+        data.set<std::string>("accept_encoding", "gzip");
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+
+        REQUIRE(a_r.acceptEncoding() == "gzip");
+    }
+
+    SECTION("get whether the requester asks for the timeline") {
+        data.set<bool>("timing", true);
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+        ActionRequest a_r { RequestType::Blocking, p_c };
+
+        REQUIRE(a_r.timing());
+    }
+}
+
+TEST_CASE("describeParsedChunks", "[request]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { DATA_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+
+    SECTION("describes binary data by its size") {
+        std::string blob { "raw\xff\xfe blob" };
+        const PCPClient::ParsedChunks p_c { envelope, blob, debug, 0 };
+        auto description = describeParsedChunks(p_c);
+
+        REQUIRE(description.find(blob) == std::string::npos);
+        REQUIRE(description.find(std::to_string(blob.size()) + " bytes")
+                != std::string::npos);
+    }
+
+    SECTION("includes JSON data") {
+        const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+
+        REQUIRE(describeParsedChunks(p_c) == p_c.toString());
     }
 }
 
@@ -0,0 +1,117 @@
+#include <pxp-agent/agent_metrics.hpp>
+#include <pxp-agent/modules/echo.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static std::map<std::string, std::shared_ptr<Module>> getModules() {
+    std::map<std::string, std::shared_ptr<Module>> modules {};
+    modules["echo"] = std::shared_ptr<Module>(new Modules::Echo);
+    return modules;
+}
+
+TEST_CASE("AgentMetrics::getReport", "[metrics]") {
+    DispatchTable table { getModules() };
+    AgentMetrics metrics { table };
+
+    SECTION("reports the counters and latencies of each action") {
+        auto handle_ptr = table.find("echo", "echo");
+        handle_ptr->recordRequest(false, 2);
+        handle_ptr->recordPhase(DispatchTable::Phase::Execution, 2000);
+
+        auto actions = metrics.getReport().get<std::vector<lth_jc::JsonContainer>>(
+            "actions");
+
+        REQUIRE(actions.size() == 1u);
+        REQUIRE(actions[0].get<std::string>("module") == "echo");
+        REQUIRE(actions[0].get<std::string>("action") == "echo");
+        REQUIRE(actions[0].get<int>("requests") == 1);
+        REQUIRE(actions[0].get<int>("failures") == 1);
+
+        auto execution = actions[0].get<lth_jc::JsonContainer>(
+            { "latencies", "execution" });
+
+        REQUIRE(execution.get<int>("count") == 1);
+        REQUIRE(execution.get<double>("max_ms") == 2.0);
+        REQUIRE(execution.get<std::vector<lth_jc::JsonContainer>>("buckets").size()
+                == 1u);
+        REQUIRE(actions[0].get<int>({ "latencies", "validation", "count" }) == 0);
+    }
+
+    SECTION("reports the registered gauges and latencies") {
+        Histogram histogram {};
+        histogram.record(500);
+        metrics.addGauge("answer", []() -> uint64_t { return 42; });
+        metrics.addLatency("outbound", histogram);
+
+        auto report = metrics.getReport();
+
+        REQUIRE(report.get<int>({ "gauges", "answer" }) == 42);
+        REQUIRE(report.get<int>({ "latencies", "outbound", "count" }) == 1);
+    }
+
+    SECTION("reports the registered counters") {
+        metrics.addCounter("dropped", []() -> uint64_t { return 3; });
+
+        REQUIRE(metrics.getReport().get<int>({ "counters", "dropped" }) == 3);
+    }
+}
+
+static bool includesLine(const std::string& text, const std::string& line) {
+    return text.find(line + "\n") != std::string::npos;
+}
+
+TEST_CASE("AgentMetrics::getPrometheusText", "[metrics]") {
+    DispatchTable table { getModules() };
+    AgentMetrics metrics { table };
+    auto handle_ptr = table.find("echo", "echo");
+    handle_ptr->recordRequest(true, 2);
+    handle_ptr->recordPhase(DispatchTable::Phase::Send, 3000);
+    metrics.addGauge("answer", []() -> uint64_t { return 42; });
+    metrics.addCounter("dropped", []() -> uint64_t { return 3; });
+
+    auto text = metrics.getPrometheusText();
+
+    SECTION("reports the counters of each action") {
+        REQUIRE(includesLine(text, "# TYPE pxp_agent_requests_total counter"));
+        REQUIRE(includesLine(
+            text, "pxp_agent_requests_total{module=\"echo\",action=\"echo\"} 1"));
+        REQUIRE(includesLine(
+            text,
+            "pxp_agent_request_failures_total{module=\"echo\",action=\"echo\"} 0"));
+    }
+
+    SECTION("reports the phase latencies as cumulative histograms") {
+        std::string labels { "module=\"echo\",action=\"echo\",phase=\"send\"" };
+
+        REQUIRE(includesLine(text, "pxp_agent_phase_duration_seconds_bucket{"
+                                   + labels + ",le=\"0.002047\"} 0"));
+        REQUIRE(includesLine(text, "pxp_agent_phase_duration_seconds_bucket{"
+                                   + labels + ",le=\"0.004095\"} 1"));
+        REQUIRE(includesLine(text, "pxp_agent_phase_duration_seconds_bucket{"
+                                   + labels + ",le=\"+Inf\"} 1"));
+        REQUIRE(includesLine(text, "pxp_agent_phase_duration_seconds_sum{"
+                                   + labels + "} 0.003"));
+        REQUIRE(includesLine(text, "pxp_agent_phase_duration_seconds_count{"
+                                   + labels + "} 1"));
+    }
+
+    SECTION("reports the registered counters and gauges") {
+        REQUIRE(includesLine(text, "# TYPE pxp_agent_dropped_total counter"));
+        REQUIRE(includesLine(text, "pxp_agent_dropped_total 3"));
+        REQUIRE(includesLine(text, "# TYPE pxp_agent_answer gauge"));
+        REQUIRE(includesLine(text, "pxp_agent_answer 42"));
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,258 @@
+#include "certs.hpp"
+#include "content_format.hpp"
+#include "root_path.hpp"
+
+#include <pxp-agent/action_outcome.hpp>
+#include <pxp-agent/action_request.hpp>
+#include <pxp-agent/configuration.hpp>
+#include <pxp-agent/pxp_connector.hpp>
+#include <pxp-agent/modules/echo.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstdlib>  // malloc, free
+#include <new>      // bad_alloc
+#include <string>
+#include <utility>  // move
+#include <vector>
+
+// Count the bytes allocated on the heap while an AllocationCounter is
+// in scope, to detect deep copies. This replaces the global allocation
+// functions, so these tests are built in a dedicated executable.
+// NB: with glibc, malloc is replaced, so that the JsonContainer values
+// allocated by rapidjson are counted as well as the std::string ones;
+// otherwise only the allocations made through operator new are.
+
+static std::atomic<bool> counting_allocations { false };
+static std::atomic<size_t> num_allocated_bytes { 0 };
+
+static void countAllocation(size_t size) {
+    if (counting_allocations) {
+        num_allocated_bytes += size;
+    }
+}
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+    countAllocation(num * size);
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+}  // extern "C"
+
+#else
+
+void* operator new(std::size_t size) {
+    countAllocation(size);
+
+    if (auto ptr = std::malloc(size > 0 ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+#endif  // __GLIBC__
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static const size_t OUTPUT_SIZE { 1024 * 1024 };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+class AllocationCounter {
+  public:
+    AllocationCounter() {
+        num_allocated_bytes = 0;
+        counting_allocations = true;
+    }
+
+    ~AllocationCounter() {
+        counting_allocations = false;
+    }
+
+    size_t numBytes() const {
+        return num_allocated_bytes;
+    }
+};
+
+TEST_CASE("ActionOutcome deep copies", "[outcome]") {
+    std::string out(OUTPUT_SIZE, 'o');
+    std::string err(OUTPUT_SIZE, 'e');
+    lth_jc::JsonContainer results {};
+    results.set<std::string>("output", "done");
+
+    SECTION("the output is not copied when moved in") {
+        AllocationCounter counter {};
+        ActionOutcome outcome { 0, std::move(err), std::move(out),
+                                std::move(results) };
+        auto num_bytes = counter.numBytes();
+
+        REQUIRE(outcome.std_out.size() == OUTPUT_SIZE);
+        REQUIRE(num_bytes < OUTPUT_SIZE);
+    }
+
+    SECTION("the output is copied once when passed by reference") {
+        AllocationCounter counter {};
+        ActionOutcome outcome { 0, err, out, results };
+        auto num_bytes = counter.numBytes();
+
+        REQUIRE(outcome.std_out.size() == OUTPUT_SIZE);
+        REQUIRE(num_bytes >= 2 * OUTPUT_SIZE);
+        REQUIRE(num_bytes < 3 * OUTPUT_SIZE);
+    }
+
+    SECTION("the outcome is not copied when moved") {
+        ActionOutcome outcome { 0, std::move(err), std::move(out),
+                                std::move(results) };
+        AllocationCounter counter {};
+        ActionOutcome moved_outcome { std::move(outcome) };
+        auto num_bytes = counter.numBytes();
+
+        REQUIRE(moved_outcome.std_out.size() == OUTPUT_SIZE);
+        REQUIRE(num_bytes < OUTPUT_SIZE);
+    }
+}
+
+TEST_CASE("ActionRequest deep copies", "[request]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data {
+        (DATA_FORMAT % "\"0987\"" % "\"echo\"" % "\"echo\"" % "{}").str() };
+    std::string blob(OUTPUT_SIZE, 'b');
+    PCPClient::ParsedChunks parsed_chunks { envelope,
+                                            data.toString() + "\n" + blob,
+                                            NO_DEBUG,
+                                            0 };
+
+    SECTION("the blob is not copied when the chunks are moved in") {
+        AllocationCounter counter {};
+        ActionRequest request { RequestType::Blocking,
+                                std::move(parsed_chunks) };
+        auto num_bytes = counter.numBytes();
+
+        REQUIRE(request.blob() == blob);
+        REQUIRE(num_bytes < OUTPUT_SIZE);
+    }
+
+    SECTION("the blob is copied once when the chunks are passed by reference") {
+        AllocationCounter counter {};
+        ActionRequest request { RequestType::Blocking, parsed_chunks };
+        auto num_bytes = counter.numBytes();
+
+        REQUIRE(request.blob() == blob);
+        REQUIRE(num_bytes >= OUTPUT_SIZE);
+        REQUIRE(num_bytes < 2 * OUTPUT_SIZE);
+    }
+}
+
+#ifdef TEST_VIRTUAL
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+// Keeps the queued messages, instead of sending them
+class QueueingConnector : public PXPConnector {
+  public:
+    std::vector<OutboundQueue::Message> queued;
+
+    explicit QueueingConnector(const Configuration::Agent& agent_configuration)
+            : PXPConnector { agent_configuration },
+              queued {} {
+    }
+
+  private:
+    bool enqueue(OutboundQueue::Message&& msg, uint32_t) {
+        queued.push_back(std::move(msg));
+        return true;
+    }
+};
+
+TEST_CASE("Request to response deep copies", "[request]") {
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    std::string argument(OUTPUT_SIZE, 'a');
+    lth_jc::JsonContainer data {
+        (DATA_FORMAT % "\"0987\"" % "\"echo\"" % "\"echo\""
+                     % ("{ \"argument\" : \"" + argument + "\" }")).str() };
+    PCPClient::ParsedChunks parsed_chunks { envelope, data, NO_DEBUG, 0 };
+    ActionRequest request { RequestType::Blocking, std::move(parsed_chunks) };
+    Modules::Echo echo_module {};
+    QueueingConnector connector { Configuration::Agent { "",
+                                                         "wss://127.0.0.1:8090/pxp/",
+                                                         getCaPath(),
+                                                         getCertPath(),
+                                                         getKeyPath(),
+                                                         SPOOL_DIR,
+                                                         "",  // modules config dir
+                                                         "test_agent" } };
+
+    SECTION("the results are moved from the outcome to the sent response") {
+        auto outcome = echo_module.executeAction(request);
+        auto moved_outcome = echo_module.executeAction(request);
+        size_t num_copy_bytes {};
+        size_t num_moved_bytes {};
+        size_t num_copied_bytes {};
+
+        {
+            AllocationCounter counter {};
+            lth_jc::JsonContainer results_copy { outcome.results };
+            num_copy_bytes = counter.numBytes();
+        }
+
+        {
+            AllocationCounter counter {};
+            connector.sendBlockingResponse(request,
+                                           std::move(moved_outcome.results));
+            num_moved_bytes = counter.numBytes();
+        }
+
+        {
+            AllocationCounter counter {};
+            connector.sendBlockingResponse(request,
+                                           lth_jc::JsonContainer { outcome.results });
+            num_copied_bytes = counter.numBytes();
+        }
+
+        // NB: the counter sees the rapidjson allocations of a deep copy
+        REQUIRE(num_copy_bytes >= OUTPUT_SIZE);
+        // The results are stored in the response data
+        REQUIRE(num_moved_bytes >= num_copy_bytes);
+        // Moving saves the deep copy made by the caller
+        REQUIRE(num_copied_bytes >= num_moved_bytes + num_copy_bytes);
+
+        REQUIRE(connector.queued.size() == 2u);
+        REQUIRE(connector.queued.front().data.get<std::string>(
+                    { "results", "outcome" }) == argument);
+    }
+}
+
+#endif  // TEST_VIRTUAL
+
+}  // namespace PXPAgent
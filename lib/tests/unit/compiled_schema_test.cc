@@ -0,0 +1,232 @@
+#include <pxp-agent/compiled_schema.hpp>
+
+#include <cpp-pcp-client/validator/validator.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static const std::string SCHEMA_TXT {
+    "{ \"type\" : \"object\","
+    "  \"properties\" : {"
+    "    \"argument\" : { \"type\" : \"string\" },"
+    "    \"count\" : { \"type\" : \"integer\" },"
+    "    \"options\" : {"
+    "      \"type\" : \"object\","
+    "      \"properties\" : {"
+    "        \"noop\" : { \"type\" : \"boolean\" },"
+    "        \"environment\" : { \"type\" : [\"string\", \"null\"] }"
+    "      },"
+    "      \"required\" : [\"noop\"]"
+    "    }"
+    "  },"
+    "  \"required\" : [\"argument\"]"
+    "}" };
+
+static const std::string VALID_PARAMS_TXT {
+    "{ \"argument\" : \"maradona\", \"count\" : 10,"
+    "  \"options\" : { \"noop\" : true, \"environment\" : null } }" };
+
+TEST_CASE("CompiledSchema::CompiledSchema", "[schema]") {
+    SECTION("compiles a schema of the supported subset") {
+        REQUIRE_NOTHROW(CompiledSchema(lth_jc::JsonContainer(SCHEMA_TXT)));
+    }
+
+    SECTION("throws an Unsupported error for other keywords") {
+        lth_jc::JsonContainer schema {
+            "{ \"type\" : \"object\","
+            "  \"properties\" : { \"port\" : { \"type\" : \"integer\","
+            "                                  \"minimum\" : 1 } } }" };
+        REQUIRE_THROWS_AS(CompiledSchema { schema }, CompiledSchema::Unsupported);
+    }
+
+    SECTION("throws an Unsupported error for unknown types") {
+        lth_jc::JsonContainer schema { "{ \"type\" : \"objet\" }" };
+        REQUIRE_THROWS_AS(CompiledSchema { schema }, CompiledSchema::Unsupported);
+    }
+}
+
+TEST_CASE("CompiledSchema::validate", "[schema]") {
+    CompiledSchema schema { lth_jc::JsonContainer(SCHEMA_TXT) };
+    std::string error;
+
+    SECTION("accepts a valid document") {
+        REQUIRE(schema.validate(lth_jc::JsonContainer(VALID_PARAMS_TXT), error));
+    }
+
+    SECTION("accepts a document without the optional properties") {
+        REQUIRE(schema.validate(
+            lth_jc::JsonContainer("{ \"argument\" : \"maradona\" }"), error));
+    }
+
+    SECTION("rejects a document missing a required property") {
+        REQUIRE_FALSE(schema.validate(
+            lth_jc::JsonContainer("{ \"count\" : 1 }"), error));
+        REQUIRE(error.find("argument") != std::string::npos);
+    }
+
+    SECTION("rejects a property of the wrong type") {
+        REQUIRE_FALSE(schema.validate(
+            lth_jc::JsonContainer("{ \"argument\" : 1 }"), error));
+    }
+
+    SECTION("rejects a nested object missing a required property") {
+        REQUIRE_FALSE(schema.validate(
+            lth_jc::JsonContainer("{ \"argument\" : \"maradona\","
+                                  "  \"options\" : {} }"), error));
+        REQUIRE(error.find("options.noop") != std::string::npos);
+    }
+
+    SECTION("accepts any of multiple types") {
+        REQUIRE(schema.validate(
+            lth_jc::JsonContainer("{ \"argument\" : \"maradona\","
+                                  "  \"options\" : { \"noop\" : false,"
+                                  "                  \"environment\" : \"prod\" } }"),
+            error));
+    }
+
+    SECTION("the constraints added as for PCPClient::Schema are checked") {
+        CompiledSchema added_schema {};
+        added_schema.addConstraint("transaction_id",
+                                   PCPClient::TypeConstraint::String,
+                                   true);
+
+        REQUIRE(added_schema.validate(
+            lth_jc::JsonContainer("{ \"transaction_id\" : \"1234\" }"), error));
+        REQUIRE_FALSE(added_schema.validate(lth_jc::JsonContainer("{}"), error));
+    }
+}
+
+TEST_CASE("CompiledSchema::validate - JSON text", "[schema]") {
+    CompiledSchema schema { lth_jc::JsonContainer(SCHEMA_TXT) };
+    std::string error;
+    bool parse_error { false };
+
+    SECTION("accepts a valid document") {
+        REQUIRE(schema.validate(VALID_PARAMS_TXT, error, parse_error));
+    }
+
+    SECTION("ignores the properties without checks") {
+        REQUIRE(schema.validate(
+            std::string { "{ \"argument\" : \"maradona\", \"extra\" : "
+                          "[1, 2.5e3, { \"argument\" : 1 }, null, \"\\u00e9\"] }" },
+            error, parse_error));
+    }
+
+    SECTION("decodes the escaped keys") {
+        REQUIRE_FALSE(schema.validate(
+            std::string { "{ \"\\u0061rgument\" : 1 }" }, error, parse_error));
+        REQUIRE_FALSE(parse_error);
+        REQUIRE(error.find("argument") != std::string::npos);
+    }
+
+    SECTION("rejects a document missing a required nested property") {
+        REQUIRE_FALSE(schema.validate(
+            std::string { "{ \"argument\" : \"maradona\", \"options\" : {} }" },
+            error, parse_error));
+        REQUIRE_FALSE(parse_error);
+        REQUIRE(error.find("options.noop") != std::string::npos);
+    }
+
+    SECTION("distinguishes integers from doubles") {
+        REQUIRE_FALSE(schema.validate(
+            std::string { "{ \"argument\" : \"maradona\", \"count\" : 1.0 }" },
+            error, parse_error));
+        REQUIRE_FALSE(parse_error);
+    }
+
+    SECTION("reports invalid JSON as a parse error") {
+        for (const auto& json_txt : std::vector<std::string> {
+                "", "{ \"argument\" : \"maradona\"", "{ \"argument\" : 1, }",
+                "[1,]", "01", "{} {}", "\"\\x\"", "{ \"argument\" : tru }" }) {
+            REQUIRE_FALSE(schema.validate(json_txt, error, parse_error));
+            REQUIRE(parse_error);
+        }
+    }
+
+    SECTION("reports invalid JSON even after a schema violation") {
+        REQUIRE_FALSE(schema.validate(std::string { "{ \"argument\" : 1, " },
+                                      error, parse_error));
+        REQUIRE(parse_error);
+    }
+}
+
+TEST_CASE("CompiledSchema::validate - JSON stream", "[schema]") {
+    CompiledSchema schema { lth_jc::JsonContainer(SCHEMA_TXT) };
+    std::string error;
+    bool parse_error { false };
+
+    // A document that spans several reads of the stream
+    std::string numbers {};
+    for (auto idx = 0; idx < 50000; idx++) {
+        numbers += (idx ? ", " : "") + std::to_string(idx) + ".5e1";
+    }
+    auto getText = [&numbers](const std::string& noop) {
+        return "{ \"extra\" : [" + numbers + "], "
+               "\"argument\" : \"" + std::string(100000, 'a') + "\", "
+               "\"options\" : { \"noop\" : " + noop + " } }";
+    };
+    auto large_txt = getText("true");
+
+    SECTION("accepts a valid document") {
+        std::istringstream json_stream { large_txt };
+        REQUIRE(schema.validate(json_stream, error, parse_error));
+    }
+
+    SECTION("rejects an invalid document") {
+        std::istringstream json_stream { getText("1") };
+        REQUIRE_FALSE(schema.validate(json_stream, error, parse_error));
+        REQUIRE_FALSE(parse_error);
+        REQUIRE(error.find("options.noop") != std::string::npos);
+    }
+
+    SECTION("reports invalid JSON as a parse error, with its offset") {
+        std::istringstream json_stream { large_txt + " }" };
+        REQUIRE_FALSE(schema.validate(json_stream, error, parse_error));
+        REQUIRE(parse_error);
+        REQUIRE(error.find(std::to_string(large_txt.size() + 1))
+                != std::string::npos);
+    }
+}
+
+// Hidden; run with: pxp-agent-unittests "[benchmark]"
+TEST_CASE("CompiledSchema benchmark", "[.][benchmark]") {
+    static const int NUM_VALIDATIONS { 100000 };
+    lth_jc::JsonContainer schema_json { SCHEMA_TXT };
+    lth_jc::JsonContainer params { VALID_PARAMS_TXT };
+    CompiledSchema compiled_schema { schema_json };
+    PCPClient::Validator validator {};
+    validator.registerSchema(PCPClient::Schema { "action", schema_json });
+    std::string error;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < NUM_VALIDATIONS; idx++) {
+        validator.validate(params, "action");
+    }
+    auto validator_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    auto num_valid = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < NUM_VALIDATIONS; idx++) {
+        num_valid += compiled_schema.validate(params, error);
+    }
+    auto compiled_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    WARN("Validator: " << validator_us << " us; CompiledSchema: "
+         << compiled_us << " us (" << NUM_VALIDATIONS << " validations)");
+    REQUIRE(num_valid == NUM_VALIDATIONS);
+    REQUIRE(compiled_us < validator_us);
+}
+
+}  // namespace PXPAgent
@@ -278,6 +278,12 @@ TEST_CASE("Configuration::validate", "[configuration]") {
         REQUIRE_THROWS_AS(Configuration::Instance().validate(),
                           Configuration::Error);
     }
+
+    SECTION("it fails when response-batch-delay exceeds 1000 ms") {
+        HW::SetFlag<int>("response-batch-delay", 1001);
+        REQUIRE_THROWS_AS(Configuration::Instance().validate(),
+                          Configuration::Error);
+    }
 }
 
 TEST_CASE("Configuration::setupLogging", "[configuration]") {
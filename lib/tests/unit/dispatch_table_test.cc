@@ -0,0 +1,124 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/dispatch_table.hpp>
+#include <pxp-agent/external_module.hpp>
+#include <pxp-agent/modules/echo.hpp>
+#include <pxp-agent/modules/ping.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#define EXTENSION ".bat"
+#else
+#define EXTENSION ""
+#endif
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static std::map<std::string, std::shared_ptr<Module>> getModules() {
+    std::map<std::string, std::shared_ptr<Module>> modules {};
+    modules["echo"] = std::shared_ptr<Module>(new Modules::Echo);
+    modules["ping"] = std::shared_ptr<Module>(new Modules::Ping);
+    modules["reverse_valid"] = std::shared_ptr<Module>(new ExternalModule(
+        PXP_AGENT_ROOT_PATH "/lib/tests/resources/modules/reverse_valid"
+        EXTENSION));
+    return modules;
+}
+
+TEST_CASE("DispatchTable::find", "[modules]") {
+    auto modules = getModules();
+    DispatchTable table { modules };
+
+    SECTION("returns the handle of each action of the modules") {
+        size_t num_actions { 0 };
+
+        for (const auto& module : modules) {
+            for (const auto& action : module.second->actions) {
+                auto handle_ptr = table.find(module.first, action);
+
+                REQUIRE(handle_ptr != nullptr);
+                REQUIRE(handle_ptr->module_ptr == module.second);
+                REQUIRE(handle_ptr->action_name == action);
+                num_actions++;
+            }
+        }
+
+        REQUIRE(table.handles().size() == num_actions);
+    }
+
+    SECTION("returns nullptr for unknown modules and actions") {
+        REQUIRE(table.find("foo", "echo") == nullptr);
+        REQUIRE(table.find("echo", "foo") == nullptr);
+        REQUIRE(table.find("echoe", "cho") == nullptr);
+    }
+
+    SECTION("an empty table finds nothing") {
+        DispatchTable empty_table {};
+        REQUIRE(empty_table.find("echo", "echo") == nullptr);
+    }
+
+    SECTION("internal actions support only blocking requests") {
+        REQUIRE(table.find("echo", "echo")->blocking_only);
+        REQUIRE_FALSE(table.find("reverse_valid", "string")->blocking_only);
+    }
+}
+
+TEST_CASE("DispatchTable::Handle::validateInput", "[modules]") {
+    DispatchTable table { getModules() };
+    auto handle_ptr = table.find("reverse_valid", "string");
+    REQUIRE(handle_ptr != nullptr);
+
+    SECTION("accepts valid parameters") {
+        REQUIRE_NOTHROW(handle_ptr->validateInput(
+            lth_jc::JsonContainer("{ \"argument\" : \"maradona\" }")));
+    }
+
+    SECTION("throws a validation_error for invalid parameters") {
+        REQUIRE_THROWS_AS(handle_ptr->validateInput(
+                              lth_jc::JsonContainer("{ \"argument\" : 1 }")),
+                          PCPClient::validation_error);
+    }
+}
+
+TEST_CASE("DispatchTable::Handle::recordRequest", "[modules]") {
+    DispatchTable table { getModules() };
+    auto handle_ptr = table.find("echo", "echo");
+
+    handle_ptr->recordRequest(true, 10);
+    handle_ptr->recordRequest(false, 5);
+
+    REQUIRE(handle_ptr->stats.num_requests == 2u);
+    REQUIRE(handle_ptr->stats.num_failures == 1u);
+    REQUIRE(handle_ptr->stats.total_duration_ms == 15u);
+}
+
+TEST_CASE("DispatchTable::Handle::recordPhase", "[modules]") {
+    DispatchTable table { getModules() };
+    auto handle_ptr = table.find("echo", "echo");
+
+    handle_ptr->recordPhase(DispatchTable::Phase::Execution, 1000);
+    handle_ptr->recordPhase(DispatchTable::Phase::Execution, 3000);
+    handle_ptr->recordPhase(DispatchTable::Phase::Send, 10);
+
+    const auto& latencies = handle_ptr->stats.latencies;
+    auto execution = latencies[static_cast<size_t>(DispatchTable::Phase::Execution)]
+                     .snapshot();
+
+    REQUIRE(execution.count == 2u);
+    REQUIRE(execution.sum_us == 4000u);
+    REQUIRE(execution.max_us == 3000u);
+    REQUIRE(latencies[static_cast<size_t>(DispatchTable::Phase::Send)]
+            .snapshot().count == 1u);
+    REQUIRE(latencies[static_cast<size_t>(DispatchTable::Phase::Validation)]
+            .snapshot().count == 0u);
+}
+
+}  // namespace PXPAgent
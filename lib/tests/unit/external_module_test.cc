@@ -2,6 +2,7 @@
 #include "content_format.hpp"
 
 #include <pxp-agent/external_module.hpp>
+#include <pxp-agent/spool_layout.hpp>
 #include <pxp-agent/configuration.hpp>
 #include <pxp-agent/util/process.hpp>
 
@@ -170,6 +171,14 @@ TEST_CASE("ExternalModule::callAction - blocking", "[modules]") {
 
             REQUIRE(outcome.std_out.find("anodaram") != std::string::npos);
         }
+
+        SECTION("the output is validated while being parsed") {
+            ActionRequest request { RequestType::Blocking, CONTENT };
+            auto outcome = reverse_module.executeAction(request);
+
+            REQUIRE(outcome.validated);
+            REQUIRE(outcome.results.get<std::string>("output") == "anodaram");
+        }
     }
 
     SECTION("it should handle module failures") {
@@ -222,9 +231,10 @@ TEST_CASE("ExternalModule::callAction - non blocking", "[modules]") {
                              "/lib/tests/resources/modules/reverse_valid"
                              EXTENSION };
         ActionRequest request { RequestType::NonBlocking, NON_BLOCKING_CONTENT };
-        fs::path spool_path { SPOOL_DIR };
-        fs::create_directories(spool_path / request.transactionId());
-        auto pid_path = spool_path / request.transactionId() / "pid";
+        fs::path results_dir_path {
+            SpoolLayout::getJobDir(SPOOL_DIR, request.transactionId()) };
+        fs::create_directories(results_dir_path);
+        auto pid_path = results_dir_path / "pid";
 
         REQUIRE_NOTHROW(e_m.executeAction(request));
         REQUIRE(fs::exists(pid_path));
@@ -236,6 +246,20 @@ TEST_CASE("ExternalModule::callAction - non blocking", "[modules]") {
             FAIL("fail to get pid");
         }
     }
+
+    SECTION("the results are not parsed if the requester is not notified") {
+        ExternalModule e_m { PXP_AGENT_ROOT_PATH
+                             "/lib/tests/resources/modules/reverse_valid"
+                             EXTENSION };
+        ActionRequest request { RequestType::NonBlocking, NON_BLOCKING_CONTENT };
+        fs::create_directories(
+            SpoolLayout::getJobDir(SPOOL_DIR, request.transactionId()));
+        auto outcome = e_m.executeAction(request);
+
+        REQUIRE(outcome.validated);
+        REQUIRE(outcome.std_out.find("ocziz") != std::string::npos);
+        REQUIRE_FALSE(outcome.results.includes("output"));
+    }
 }
 
 }  // namespace PXPAgent
@@ -0,0 +1,66 @@
+#include <pxp-agent/histogram.hpp>
+
+#include <catch.hpp>
+
+#include <thread>
+#include <vector>
+
+namespace PXPAgent {
+
+TEST_CASE("Histogram::bucketOf", "[metrics]") {
+    SECTION("small durations have their own bucket") {
+        REQUIRE(Histogram::bucketOf(0) == 0u);
+        REQUIRE(Histogram::bucketOf(3) == 3u);
+    }
+
+    SECTION("durations are within the bounds of their bucket") {
+        for (uint64_t duration_us = 4; duration_us < 100000; duration_us += 7) {
+            auto bucket = Histogram::bucketOf(duration_us);
+
+            REQUIRE(duration_us < Histogram::upperBoundOf(bucket));
+            REQUIRE(duration_us >= Histogram::upperBoundOf(bucket - 1));
+        }
+    }
+
+    SECTION("huge durations fall in the last bucket") {
+        REQUIRE(Histogram::bucketOf(UINT64_MAX) == Histogram::NUM_BUCKETS - 1);
+    }
+}
+
+TEST_CASE("Histogram::record", "[metrics]") {
+    Histogram histogram {};
+
+    SECTION("an empty histogram has no quantiles") {
+        auto snapshot = histogram.snapshot();
+
+        REQUIRE(snapshot.count == 0u);
+        REQUIRE(snapshot.quantile(0.5) == 0u);
+    }
+
+    SECTION("counts the durations recorded by concurrent threads") {
+        std::vector<std::thread> threads {};
+
+        for (auto idx = 0; idx < 4; idx++) {
+            threads.emplace_back([&histogram]() {
+                for (uint64_t duration_us = 1; duration_us <= 1000; duration_us++) {
+                    histogram.record(duration_us);
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto snapshot = histogram.snapshot();
+
+        REQUIRE(snapshot.count == 4000u);
+        REQUIRE(snapshot.sum_us == 4u * 500500u);
+        REQUIRE(snapshot.max_us == 1000u);
+        REQUIRE(snapshot.quantile(0.5) >= 500u);
+        REQUIRE(snapshot.quantile(0.5) < 500u * 5 / 4);
+        REQUIRE(snapshot.quantile(1.0) == 1000u);
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,146 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/job_archive.hpp>
+#include <pxp-agent/output_compressor.hpp>
+#include <pxp-agent/spool_layout.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <catch.hpp>
+
+#include <ctime>
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+static const std::string METADATA_TXT { "{\"completed\" : true, "
+                                        "\"exitcode\" : 0}" };
+
+static std::string createJob(const std::string& job_id,
+                             const std::string& out,
+                             const std::string& err) {
+    auto job_dir = SpoolLayout::getJobDir(SPOOL_DIR, job_id);
+
+    if (!fs::create_directories(job_dir)) {
+        FAIL("Failed to create the results directory");
+    }
+
+    lth_file::atomic_write_to_file(METADATA_TXT, job_dir + "/metadata");
+    lth_file::atomic_write_to_file(out, job_dir + "/stdout");
+    lth_file::atomic_write_to_file(err, job_dir + "/stderr");
+    return job_dir;
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("JobArchive::pack", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    std::string long_output {};
+
+    for (auto idx = 0; idx < 1000; idx++) {
+        long_output += "Notice: Applied catalog in 4.2 seconds\n";
+    }
+
+    auto job_dir = createJob("job-1", long_output, "warning");
+    OutputCompressor::compressFile(job_dir + "/stdout", COMPRESSION_MIN_SIZE);
+    JobArchive archive { SPOOL_DIR };
+
+    REQUIRE_NOTHROW(archive.pack(job_dir));
+
+    SECTION("removes the results directory") {
+        REQUIRE_FALSE(fs::exists(job_dir));
+    }
+
+    SECTION("the record can be retrieved") {
+        JobArchive::Record record {};
+
+        REQUIRE(archive.find("job-1", record));
+        REQUIRE(record.metadata == METADATA_TXT);
+        REQUIRE(record.stdout_txt == long_output);
+        REQUIRE(record.stderr_txt == "warning");
+    }
+
+    SECTION("the record can be retrieved after reloading the index") {
+        JobArchive reloaded_archive { SPOOL_DIR };
+        JobArchive::Record record {};
+
+        REQUIRE(reloaded_archive.find("job-1", record));
+        REQUIRE(record.stdout_txt == long_output);
+    }
+
+    SECTION("returns false for an unknown job") {
+        JobArchive::Record record {};
+        REQUIRE_FALSE(archive.find("job-2", record));
+    }
+}
+
+TEST_CASE("JobArchive::pack removes the job from the index", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto job_dir = createJob("job-1", "out", "err");
+    auto job_index_ptr = std::make_shared<JobIndex>();
+    job_index_ptr->set("job-1", job_dir);
+    job_index_ptr->set("job-2", "/fake/job-2");
+    JobArchive archive { SPOOL_DIR, 0, 0, ARCHIVE_MAX_SEGMENT_SIZE, job_index_ptr };
+
+    archive.pack(job_dir);
+    JobIndex::Entry entry {};
+
+    REQUIRE_FALSE(job_index_ptr->find("job-1", entry));
+    REQUIRE(job_index_ptr->find("job-2", entry));
+    REQUIRE(job_index_ptr->size() == 1u);
+}
+
+TEST_CASE("JobArchive::packCompletedJobs", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto job_dir = createJob("job-1", "out", "err");
+    JobArchive archive { SPOOL_DIR };
+
+    SECTION("does not pack recently updated jobs") {
+        REQUIRE(archive.packCompletedJobs(std::time(nullptr) - 3600) == 0);
+        REQUIRE(fs::exists(job_dir));
+    }
+
+    SECTION("packs the completed jobs") {
+        JobArchive::Record record {};
+
+        REQUIRE(archive.packCompletedJobs(std::time(nullptr) + 3600) == 1);
+        REQUIRE_FALSE(fs::exists(job_dir));
+        REQUIRE(archive.find("job-1", record));
+    }
+}
+
+TEST_CASE("JobArchive::removeSegments", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    // NB: a tiny segment size, so that each record seals its segment
+    JobArchive archive { SPOOL_DIR, 0, 0, 1 };
+    archive.pack(createJob("job-1", "out", "err"));
+    archive.pack(createJob("job-2", "out", "err"));
+    JobArchive::Record record {};
+
+    SECTION("does not remove recent segments") {
+        REQUIRE(archive.removeSegments(std::time(nullptr) - 3600) == 0);
+        REQUIRE(archive.find("job-1", record));
+    }
+
+    SECTION("removes the sealed segments but not the current one") {
+        REQUIRE(archive.removeSegments(std::time(nullptr) + 3600) == 1);
+        REQUIRE_FALSE(archive.find("job-1", record));
+        REQUIRE(archive.find("job-2", record));
+    }
+}
+
+}  // namespace PXPAgent
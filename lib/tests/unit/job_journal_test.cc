@@ -0,0 +1,125 @@
+#include "root_path.hpp"
+#include "content_format.hpp"
+
+#include <pxp-agent/job_journal.hpp>
+#include <pxp-agent/action_request.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>       // ParsedChunks
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string JOURNAL_FILE { std::string { PXP_AGENT_ROOT_PATH }
+                                        + "/lib/tests/resources/test_spool/"
+                                          "jobs.journal" };
+
+static const std::vector<lth_jc::JsonContainer> NO_DEBUG {};
+
+static ActionRequest getRequest(const std::string& transaction_id) {
+    PCPClient::ParsedChunks parsed_chunks {
+        lth_jc::JsonContainer(ENVELOPE_TXT),
+        lth_jc::JsonContainer((NON_BLOCKING_DATA_FORMAT
+                               % ("\"" + transaction_id + "\"")
+                               % "\"reverse\""
+                               % "\"string\""
+                               % "{\"argument\" : \"maradona\"}"
+                               % "true").str()),
+        NO_DEBUG,
+        0 };
+    return ActionRequest { RequestType::NonBlocking, parsed_chunks };
+}
+
+static void resetTest() {
+    fs::remove_all(fs::path(JOURNAL_FILE).parent_path());
+}
+
+TEST_CASE("JobJournal::JobJournal", "[journal]") {
+    lth_util::scope_exit journal_cleaner { resetTest };
+
+    SECTION("creates the journal file") {
+        JobJournal journal { JOURNAL_FILE };
+        REQUIRE(fs::exists(JOURNAL_FILE));
+        REQUIRE(journal.getInterruptedJobs().empty());
+    }
+}
+
+TEST_CASE("JobJournal replay", "[journal]") {
+    lth_util::scope_exit journal_cleaner { resetTest };
+
+    {
+        JobJournal journal { JOURNAL_FILE };
+        std::vector<bool> durable {};
+        auto on_durable = [&durable](bool ok) { durable.push_back(ok); };
+        journal.logAccepted(getRequest("queued"), on_durable);
+        journal.logAccepted(getRequest("running"), on_durable);
+        journal.logAccepted(getRequest("done"), on_durable);
+        journal.flush();
+        REQUIRE(durable == std::vector<bool>({ true, true, true }));
+
+        journal.logStarted("running");
+        journal.logStarted("done");
+        journal.logCompleted("done");
+    }
+
+    SECTION("reports the jobs that were accepted but not started") {
+        JobJournal journal { JOURNAL_FILE };
+        auto jobs = journal.getInterruptedJobs();
+
+        REQUIRE(jobs.size() == 1);
+        REQUIRE(jobs[0].job_id == "queued");
+        REQUIRE(jobs[0].requester == "pcp://controller/test_controller");
+        REQUIRE(jobs[0].module == "reverse");
+        REQUIRE(jobs[0].notify_outcome);
+    }
+
+    SECTION("does not keep the records of the started jobs") {
+        {
+            JobJournal journal { JOURNAL_FILE };
+        }
+
+        std::string content;
+        REQUIRE(lth_file::read(JOURNAL_FILE, content));
+        REQUIRE(content.find("queued") != std::string::npos);
+        REQUIRE(content.find("running") == std::string::npos);
+        REQUIRE(content.find("done") == std::string::npos);
+    }
+
+    SECTION("does not report the jobs once flagged as failed") {
+        {
+            JobJournal journal { JOURNAL_FILE };
+            journal.logFailed("queued");
+        }
+
+        JobJournal journal { JOURNAL_FILE };
+        REQUIRE(journal.getInterruptedJobs().empty());
+    }
+
+    SECTION("ignores a corrupted record") {
+        std::string content;
+        REQUIRE(lth_file::read(JOURNAL_FILE, content));
+        auto pos = content.find("queued");
+        REQUIRE(pos != std::string::npos);
+        content[pos] = 'Q';
+        lth_file::atomic_write_to_file(content, JOURNAL_FILE);
+
+        JobJournal journal { JOURNAL_FILE };
+        REQUIRE(journal.getInterruptedJobs().empty());
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,119 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/metadata_writer.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+static void configureTest() {
+    if (!fs::exists(SPOOL_DIR) && !fs::create_directories(SPOOL_DIR)) {
+        FAIL("Failed to create the spool directory");
+    }
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("MetadataWriter::write", "[metadata]") {
+    configureTest();
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto file_path = (fs::path(SPOOL_DIR) / "metadata").string();
+
+    SECTION("writes the file once flushed") {
+        MetadataWriter writer {};
+        writer.write(file_path, "{\"completed\":false}\n");
+        writer.flush();
+
+        REQUIRE(lth_file::read(file_path) == "{\"completed\":false}\n");
+    }
+
+    SECTION("writes the queued updates when destroyed") {
+        {
+            MetadataWriter writer { 1000 };
+            writer.write(file_path, "{\"completed\":true}\n");
+        }
+
+        REQUIRE(lth_file::read(file_path) == "{\"completed\":true}\n");
+    }
+
+    SECTION("coalesces the updates of the same file") {
+        MetadataWriter writer { 200 };
+        writer.write(file_path, "first\n");
+        writer.write(file_path, "second\n");
+        writer.write(file_path, "third\n");
+        writer.flush();
+
+        REQUIRE(writer.getNumWrittenBatches() == 1);
+        REQUIRE(lth_file::read(file_path) == "third\n");
+    }
+
+    SECTION("tells the callbacks once the file is written") {
+        MetadataWriter writer { 200 };
+        std::vector<bool> written {};
+        writer.write(file_path, "first\n",
+                     [&written](bool ok) { written.push_back(ok); });
+        writer.write(file_path, "second\n",
+                     [&written](bool ok) { written.push_back(ok); });
+        writer.flush();
+
+        REQUIRE(written == std::vector<bool>({ true, true }));
+        REQUIRE(lth_file::read(file_path) == "second\n");
+    }
+
+    SECTION("tells the callbacks if the file cannot be written") {
+        MetadataWriter writer {};
+        std::vector<bool> written {};
+        writer.write((fs::path(SPOOL_DIR) / "missing" / "metadata").string(),
+                     "{\"completed\":false}\n",
+                     [&written](bool ok) { written.push_back(ok); });
+        writer.flush();
+
+        REQUIRE(written == std::vector<bool>({ false }));
+    }
+}
+
+TEST_CASE("MetadataWriter::read", "[metadata]") {
+    configureTest();
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto file_path = (fs::path(SPOOL_DIR) / "metadata").string();
+    MetadataWriter writer { 1000 };
+    std::string content;
+
+    SECTION("retrieves the updates that are not written yet") {
+        writer.write(file_path, "pending\n");
+
+        REQUIRE(writer.read(file_path, content));
+        REQUIRE(content == "pending\n");
+    }
+
+    SECTION("retrieves the content from disk otherwise") {
+        lth_file::atomic_write_to_file("on disk\n", file_path);
+
+        REQUIRE(writer.read(file_path, content));
+        REQUIRE(content == "on disk\n");
+    }
+
+    SECTION("returns false if the file does not exist") {
+        REQUIRE_FALSE(writer.read(file_path, content));
+    }
+}
+
+}  // namespace PXPAgent
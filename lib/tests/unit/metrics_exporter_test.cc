@@ -0,0 +1,161 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/metrics_exporter.hpp>
+#include <pxp-agent/dispatch_table.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string EXPORT_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                      + "/lib/tests/resources/test_metrics" };
+
+static void resetTest() {
+    fs::remove_all(EXPORT_DIR);
+}
+
+static std::shared_ptr<AgentMetrics> getMetrics(const DispatchTable& table) {
+    auto metrics_ptr = std::make_shared<AgentMetrics>(table);
+    metrics_ptr->addGauge("answer", []() -> uint64_t { return 42; });
+    return metrics_ptr;
+}
+
+TEST_CASE("MetricsExporter::writeTextfile", "[metrics]") {
+    lth_util::scope_exit export_cleaner { resetTest };
+    fs::create_directories(EXPORT_DIR);
+    DispatchTable table {};
+    auto textfile = EXPORT_DIR + "/pxp_agent.prom";
+
+    SECTION("writes the metrics in the Prometheus format") {
+        MetricsExporter exporter { getMetrics(table), textfile, 3600, "" };
+        exporter.writeTextfile();
+
+        REQUIRE(lth_file::read(textfile).find("pxp_agent_answer 42\n")
+                != std::string::npos);
+    }
+
+    SECTION("throws a MetricsExporter::Error if it fails to write") {
+        MetricsExporter exporter { getMetrics(table),
+                                   EXPORT_DIR + "/missing/pxp_agent.prom",
+                                   3600, "" };
+
+        REQUIRE_THROWS_AS(exporter.writeTextfile(), MetricsExporter::Error);
+    }
+}
+
+#ifndef _WIN32
+
+// Connect to the socket and send the request; return the client socket
+static int sendRequest(const std::string& socket_path,
+                       const std::string& request) {
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)) == 0);
+    REQUIRE(::write(fd, request.data(), request.size())
+            == static_cast<ssize_t>(request.size()));
+    return fd;
+}
+
+static std::string query(const std::string& socket_path,
+                         const std::string& request) {
+    auto fd = sendRequest(socket_path, request);
+    std::string response {};
+    char buffer[1024];
+    ssize_t n;
+
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, static_cast<size_t>(n));
+    }
+
+    ::close(fd);
+    return response;
+}
+
+TEST_CASE("MetricsExporter serves the metrics on a socket", "[metrics]") {
+    lth_util::scope_exit export_cleaner { resetTest };
+    fs::create_directories(EXPORT_DIR);
+    DispatchTable table {};
+    auto socket_path = EXPORT_DIR + "/metrics.sock";
+
+    SECTION("as an HTTP response to GET requests") {
+        MetricsExporter exporter { getMetrics(table), "", 60, socket_path };
+        auto response = query(socket_path, "GET /metrics HTTP/1.0\r\n\r\n");
+
+        REQUIRE(response.find("HTTP/1.0 200 OK\r\n") == 0);
+        REQUIRE(response.find("\r\n\r\n# HELP") != std::string::npos);
+        REQUIRE(response.find("pxp_agent_answer 42\n") != std::string::npos);
+    }
+
+    SECTION("as is to other clients") {
+        MetricsExporter exporter { getMetrics(table), "", 60, socket_path };
+        auto response = query(socket_path, "\n");
+
+        REQUIRE(response.find("# HELP") == 0);
+        REQUIRE(response.find("pxp_agent_answer 42\n") != std::string::npos);
+    }
+
+    SECTION("gives up on a client that does not read the response") {
+        auto metrics_ptr = getMetrics(table);
+
+        // NB: several MB of metrics, more than the socket buffers hold
+        for (auto idx = 0; idx < 2048; idx++) {
+            metrics_ptr->addGauge(std::to_string(idx) + std::string(1000, 'x'),
+                                  []() -> uint64_t { return 0; });
+        }
+
+        MetricsExporter exporter { metrics_ptr, "", 60, socket_path };
+        auto stuck_fd = sendRequest(socket_path, "\n");
+        auto start = std::chrono::steady_clock::now();
+
+        // NB: served once the exporter stops writing to the stuck client
+        auto response = query(socket_path, "\n");
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        ::close(stuck_fd);
+
+        REQUIRE(response.find("pxp_agent_answer 42\n") != std::string::npos);
+        REQUIRE(elapsed < std::chrono::seconds(10));
+    }
+
+    SECTION("removes the socket file when destroyed") {
+        {
+            MetricsExporter exporter { getMetrics(table), "", 60, socket_path };
+            REQUIRE(fs::exists(socket_path));
+        }
+
+        REQUIRE_FALSE(fs::exists(socket_path));
+    }
+
+    SECTION("throws a MetricsExporter::Error if the path is not a socket") {
+        lth_file::atomic_write_to_file("foo\n", socket_path);
+
+        REQUIRE_THROWS_AS(MetricsExporter(getMetrics(table), "", 60, socket_path),
+                          MetricsExporter::Error);
+    }
+}
+
+#endif  // _WIN32
+
+}  // namespace PXPAgent
@@ -0,0 +1,304 @@
+#include <pxp-agent/outbound_queue.hpp>
+
+#include <cpp-pcp-client/connector/errors.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>  // move
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+static OutboundQueue::Message getMessage(const std::string& transaction_id) {
+    lth_jc::JsonContainer data {};
+    data.set<std::string>("transaction_id", transaction_id);
+    return OutboundQueue::Message { { "pcp://controller/test_controller" },
+                                    "http://puppetlabs.com/rpc_provisional_response",
+                                    data,
+                                    {},
+                                    "test message " + transaction_id,
+                                    false,
+                                    0,
+                                    "" };
+}
+
+TEST_CASE("OutboundQueue::push", "[outbound]") {
+    SECTION("sends the messages in order") {
+        std::vector<std::string> sent {};
+        OutboundQueue queue {
+            [&sent](const OutboundQueue::Message& msg) {
+                sent.push_back(msg.data.get<std::string>("transaction_id"));
+            },
+            0, 0 };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(getMessage("2")));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "1", "2", "3" }));
+    }
+
+    SECTION("sends the data serialized when queued") {
+        std::vector<std::string> sent {};
+        OutboundQueue queue {
+            [&sent](const OutboundQueue::Message& msg) {
+                sent.push_back(msg.data_txt);
+            },
+            0, 0 };
+        auto msg = getMessage("1");
+        auto serialized_msg = getMessage("2");
+        serialized_msg.data_txt = "{\"transaction_id\":\"serialized\"}";
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(std::move(serialized_msg)));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> {
+                    msg.data.toString(),
+                    "{\"transaction_id\":\"serialized\"}" }));
+    }
+
+    SECTION("retries the messages that failed with a connection error") {
+        std::atomic<int> num_attempts { 0 };
+        OutboundQueue queue {
+            [&num_attempts](const OutboundQueue::Message&) {
+                if (++num_attempts < 3) {
+                    throw PCPClient::connection_error { "not connected" };
+                }
+            },
+            0, 0, 10 };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE(num_attempts == 3);
+        REQUIRE(queue.getNumDropped() == 0u);
+    }
+
+    SECTION("drops the messages that failed with other errors") {
+        OutboundQueue queue {
+            [](const OutboundQueue::Message&) {
+                throw std::runtime_error { "bad message" };
+            },
+            0, 0 };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE(queue.getNumDropped() == 1u);
+    }
+
+    SECTION("drops the messages once expired") {
+        OutboundQueue queue {
+            [](const OutboundQueue::Message&) {
+                throw PCPClient::connection_error { "not connected" };
+            },
+            0, 1, 10 };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE(queue.getNumDropped() == 1u);
+    }
+
+    SECTION("rejects messages when full") {
+        OutboundQueue queue {
+            [](const OutboundQueue::Message&) {
+                throw PCPClient::connection_error { "not connected" };
+            },
+            1, 0, 1000 };
+
+        // NB: the first message is always accepted
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE_FALSE(queue.push(getMessage("2")));
+        REQUIRE(queue.getNumQueued() == 1u);
+    }
+
+    SECTION("waits for room when full, if a timeout is specified") {
+        std::vector<std::string> sent {};
+        OutboundQueue queue {
+            [&sent](const OutboundQueue::Message& msg) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                sent.push_back(msg.data.get<std::string>("transaction_id"));
+            },
+            1, 0 };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(getMessage("2"), 5000));
+        REQUIRE(queue.flush(5000));
+        REQUIRE(queue.getNumDropped() == 0u);
+        REQUIRE((sent == std::vector<std::string> { "1", "2" }));
+    }
+}
+
+TEST_CASE("OutboundQueue - persistent messages", "[outbound]") {
+    std::vector<std::string> undelivered {};
+    OutboundQueue::UndeliveredFunction store_undelivered {
+        [&undelivered](const OutboundQueue::Message& msg) {
+            undelivered.push_back(msg.data.get<std::string>("transaction_id"));
+            return true;
+        } };
+
+    SECTION("are handed over after a connection error, without retrying") {
+        std::atomic<int> num_attempts { 0 };
+
+        {
+            OutboundQueue queue {
+                [&num_attempts](const OutboundQueue::Message&) {
+                    num_attempts++;
+                    throw PCPClient::connection_error { "not connected" };
+                },
+                0, 0, 10, store_undelivered };
+            auto msg = getMessage("1");
+            msg.persistent = true;
+
+            REQUIRE(queue.push(std::move(msg)));
+            REQUIRE(queue.flush(5000));
+        }
+
+        REQUIRE(num_attempts == 1);
+        REQUIRE(undelivered == std::vector<std::string> { "1" });
+    }
+
+    SECTION("are handed over when the queue is destroyed") {
+        {
+            OutboundQueue queue {
+                [](const OutboundQueue::Message&) {
+                    throw PCPClient::connection_error { "not connected" };
+                },
+                0, 0, 1000, store_undelivered };
+            auto msg = getMessage("1");
+
+            REQUIRE(queue.push(getMessage("0")));
+            msg.persistent = true;
+            REQUIRE(queue.push(std::move(msg)));
+        }
+
+        REQUIRE(undelivered == std::vector<std::string> { "1" });
+    }
+
+    SECTION("the idle function can queue messages") {
+        std::vector<std::string> sent {};
+        std::atomic<size_t> num_sent { 0 };
+        std::atomic<bool> redelivered { false };
+        std::atomic<OutboundQueue*> queue_ptr { nullptr };
+
+        {
+            OutboundQueue queue {
+                [&sent, &num_sent](const OutboundQueue::Message& msg) {
+                    sent.push_back(msg.data.get<std::string>("transaction_id"));
+                    num_sent++;
+                },
+                0, 0, 10, store_undelivered,
+                [&redelivered, &queue_ptr]() {
+                    auto ptr = queue_ptr.load();
+                    if (ptr != nullptr && !redelivered.exchange(true)) {
+                        ptr->push(getMessage("stored"));
+                    }
+                } };
+            queue_ptr = &queue;
+            REQUIRE(queue.push(getMessage("1")));
+
+            for (auto idx = 0; idx < 100 && num_sent < 2; idx++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+
+        REQUIRE((sent == std::vector<std::string> { "1", "stored" }));
+    }
+}
+
+TEST_CASE("OutboundQueue::enableBatching", "[outbound]") {
+    std::vector<std::string> sent {};
+    OutboundQueue queue {
+        [&sent](const OutboundQueue::Message& msg) {
+            sent.push_back(msg.data.get<std::string>("transaction_id"));
+        },
+        0, 0 };
+
+    auto batch_function = [](std::vector<OutboundQueue::Message>&& messages) {
+        std::string transaction_ids {};
+        for (const auto& msg : messages) {
+            transaction_ids += (transaction_ids.empty() ? "" : ",")
+                               + msg.data.get<std::string>("transaction_id");
+        }
+        auto batch = getMessage(transaction_ids);
+        batch.message_type = "http://puppetlabs.com/rpc_batch_response";
+        return batch;
+    };
+
+    auto enable = [&](size_t max_messages) {
+        queue.enableBatching(OutboundQueue::BatchOptions {
+            200,
+            max_messages,
+            { "http://puppetlabs.com/rpc_provisional_response" },
+            batch_function });
+    };
+
+    SECTION("combines the messages to the same target") {
+        enable(10);
+        auto other_msg = getMessage("4");
+        other_msg.targets = { "pcp://controller/other_controller" };
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(std::move(other_msg)));
+        REQUIRE(queue.push(getMessage("2")));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "1,2,3", "4" }));
+    }
+
+    SECTION("sends the messages to other targets while a batch waits") {
+        enable(10);
+        auto other_msg = getMessage("4");
+        other_msg.targets = { "pcp://controller/other_controller" };
+        other_msg.message_type = "http://puppetlabs.com/rpc_error_message";
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(std::move(other_msg)));
+        REQUIRE(queue.push(getMessage("2")));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "4", "1,2,3" }));
+    }
+
+    SECTION("sends a batch once it reaches the maximum size") {
+        enable(2);
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(getMessage("2")));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "1,2", "3" }));
+    }
+
+    SECTION("does not reorder the messages to the same target") {
+        enable(10);
+        auto error_msg = getMessage("2");
+        error_msg.message_type = "http://puppetlabs.com/rpc_error_message";
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(std::move(error_msg)));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "1", "2", "3" }));
+    }
+
+    SECTION("does not batch the messages retrieved from the outbox") {
+        enable(10);
+        auto stored_msg = getMessage("2");
+        stored_msg.outbox_sequence_number = 42;
+
+        REQUIRE(queue.push(getMessage("1")));
+        REQUIRE(queue.push(std::move(stored_msg)));
+        REQUIRE(queue.push(getMessage("3")));
+        REQUIRE(queue.flush(5000));
+        REQUIRE((sent == std::vector<std::string> { "1", "2", "3" }));
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,99 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/output_compressor.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+static void configureTest() {
+    if (!fs::exists(SPOOL_DIR) && !fs::create_directories(SPOOL_DIR)) {
+        FAIL("Failed to create the spool directory");
+    }
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("OutputCompressor::compressFile", "[spool]") {
+    configureTest();
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto file_path = (fs::path(SPOOL_DIR) / "stdout").string();
+    std::string output {};
+
+    for (auto idx = 0; idx < 1000; idx++) {
+        output += "Notice: Applied catalog in 4.2 seconds\n";
+    }
+
+    lth_file::atomic_write_to_file(output, file_path);
+
+    SECTION("replaces the file with the compressed one") {
+        REQUIRE(OutputCompressor::compressFile(file_path, COMPRESSION_MIN_SIZE));
+        REQUIRE_FALSE(fs::exists(file_path));
+        REQUIRE(fs::exists(file_path + COMPRESSED_FILE_SUFFIX));
+        REQUIRE(fs::file_size(file_path + COMPRESSED_FILE_SUFFIX) < output.size());
+        REQUIRE(OutputCompressor::exists(file_path));
+    }
+
+    SECTION("the compressed file is read transparently") {
+        std::string content;
+        OutputCompressor::compressFile(file_path, COMPRESSION_MIN_SIZE);
+
+        REQUIRE(OutputCompressor::read(file_path, content));
+        REQUIRE(content == output);
+    }
+
+    SECTION("does not compress small files") {
+        REQUIRE_FALSE(OutputCompressor::compressFile(file_path, output.size() + 1));
+        REQUIRE(fs::exists(file_path));
+    }
+}
+
+TEST_CASE("OutputCompressor::read", "[spool]") {
+    configureTest();
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto file_path = (fs::path(SPOOL_DIR) / "stderr").string();
+    std::string content;
+
+    SECTION("reads an uncompressed file") {
+        lth_file::atomic_write_to_file("error\n", file_path);
+        REQUIRE(OutputCompressor::read(file_path, content));
+        REQUIRE(content == "error\n");
+    }
+
+    SECTION("returns false if the file does not exist") {
+        REQUIRE_FALSE(OutputCompressor::exists(file_path));
+        REQUIRE_FALSE(OutputCompressor::read(file_path, content));
+    }
+}
+
+TEST_CASE("OutputCompressor::compressData", "[spool]") {
+    std::string results {};
+
+    for (auto idx = 0; idx < 1000; idx++) {
+        results += "{\"line\" : " + std::to_string(idx) + "},";
+    }
+
+    auto compressed = OutputCompressor::compressData(results);
+
+    REQUIRE(compressed.size() < results.size());
+    REQUIRE(OutputCompressor::decompress(compressed) == results);
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,193 @@
+#include "certs.hpp"
+#include "content_format.hpp"
+#include "root_path.hpp"
+
+#include <pxp-agent/pxp_connector.hpp>
+#include <pxp-agent/pxp_schemas.hpp>
+#include <pxp-agent/configuration.hpp>
+#include <pxp-agent/util/base64.hpp>
+
+#include <cpp-pcp-client/protocol/chunks.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <catch.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <limits>
+#include <string>
+#include <utility>  // move
+#include <vector>
+
+namespace PXPAgent {
+
+#ifdef TEST_VIRTUAL
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+static const std::string RESULTS_FILE { SPOOL_DIR + "/stdout" };
+
+// Keeps the queued messages, instead of sending them; rejects the
+// fragments beyond max_fragments, as if the queue was full
+class QueueingConnector : public PXPConnector {
+  public:
+    std::vector<OutboundQueue::Message> queued;
+    size_t max_fragments;
+
+    explicit QueueingConnector(const Configuration::Agent& agent_configuration)
+            : PXPConnector { agent_configuration },
+              queued {},
+              max_fragments { std::numeric_limits<size_t>::max() } {
+    }
+
+  private:
+    bool enqueue(OutboundQueue::Message&& msg, uint32_t) {
+        if (msg.message_type == PXPSchemas::RESULTS_FRAGMENT_TYPE) {
+            if (max_fragments == 0) {
+                return false;
+            }
+
+            max_fragments--;
+        }
+
+        queued.push_back(std::move(msg));
+        return true;
+    }
+};
+
+static Configuration::Agent getConfiguration(int result_fragment_size) {
+    Configuration::Agent agent_configuration { "",
+                                               "wss://127.0.0.1:8090/pxp/",
+                                               getCaPath(),
+                                               getCertPath(),
+                                               getKeyPath(),
+                                               SPOOL_DIR,
+                                               "",  // modules config dir
+                                               "test_agent" };
+    agent_configuration.result_fragment_size = result_fragment_size;
+    return agent_configuration;
+}
+
+static const std::string NON_BLOCKING_DATA_TXT {
+    (NON_BLOCKING_DATA_FORMAT % "\"04352987\""
+                              % "\"module name\""
+                              % "\"action name\""
+                              % "{}"
+                              % "true").str() };
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("PXPConnector::sendFragmentedNonBlockingResponse", "[connector]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    fs::create_directories(SPOOL_DIR);
+    lth_jc::JsonContainer envelope { ENVELOPE_TXT };
+    lth_jc::JsonContainer data { NON_BLOCKING_DATA_TXT };
+    std::vector<lth_jc::JsonContainer> debug {};
+    const PCPClient::ParsedChunks p_c { envelope, data, debug, 0 };
+    ActionRequest request { RequestType::NonBlocking, p_c };
+
+    // NB: 2.5 fragments of 1 KiB, with every byte value
+    std::string results_txt {};
+    for (size_t idx = 0; idx < 2560; idx++) {
+        results_txt.push_back(static_cast<char>(idx % 256));
+    }
+    lth_file::atomic_write_to_file(results_txt, RESULTS_FILE);
+
+    SECTION("does not fragment if the fragment size is 0") {
+        QueueingConnector connector { getConfiguration(0) };
+
+        REQUIRE_FALSE(connector.sendFragmentedNonBlockingResponse(
+            request, RESULTS_FILE, "job_1"));
+        REQUIRE(connector.queued.empty());
+    }
+
+    SECTION("does not fragment results that fit in a fragment") {
+        QueueingConnector connector { getConfiguration(4) };
+
+        REQUIRE_FALSE(connector.sendFragmentedNonBlockingResponse(
+            request, RESULTS_FILE, "job_1"));
+        REQUIRE(connector.queued.empty());
+    }
+
+    SECTION("does not fragment if the results file does not exist") {
+        QueueingConnector connector { getConfiguration(1) };
+
+        REQUIRE_FALSE(connector.sendFragmentedNonBlockingResponse(
+            request, SPOOL_DIR + "/missing", "job_1"));
+        REQUIRE(connector.queued.empty());
+    }
+
+    SECTION("sends the fragments followed by the response") {
+        QueueingConnector connector { getConfiguration(1) };
+
+        REQUIRE(connector.sendFragmentedNonBlockingResponse(
+            request, RESULTS_FILE, "job_1"));
+        REQUIRE(connector.queued.size() == 4u);
+
+        std::string reassembled {};
+
+        for (size_t idx = 0; idx < 3; idx++) {
+            const auto& fragment = connector.queued[idx];
+            REQUIRE(fragment.message_type == PXPSchemas::RESULTS_FRAGMENT_TYPE);
+            // NB: retried in order, instead of being stored in the outbox
+            REQUIRE_FALSE(fragment.persistent);
+            REQUIRE(fragment.data.get<std::string>("transaction_id") == "04352987");
+            REQUIRE(fragment.data.get<std::string>("job_id") == "job_1");
+            REQUIRE(fragment.data.get<int>("index") == static_cast<int>(idx));
+            REQUIRE(fragment.data.get<int>("num_fragments") == 3);
+
+            auto slice = Util::base64Decode(fragment.data.get<std::string>("data"));
+            // NB: the last fragment has the remaining half
+            REQUIRE(slice.size() == (idx < 2 ? 1024u : 512u));
+            reassembled += slice;
+        }
+
+        REQUIRE(reassembled == results_txt);
+
+        const auto& response = connector.queued.back();
+        REQUIRE(response.message_type == PXPSchemas::NON_BLOCKING_RESPONSE_TYPE);
+        REQUIRE(response.data.get<int>("num_fragments") == 3);
+        REQUIRE(response.data.get<std::string>("job_id") == "job_1");
+        REQUIRE_FALSE(response.data.includes("results"));
+    }
+
+    SECTION("aborts the stream with a PXP error if a fragment can't be queued") {
+        QueueingConnector connector { getConfiguration(1) };
+        connector.max_fragments = 1;
+
+        REQUIRE_THROWS_AS(connector.sendFragmentedNonBlockingResponse(
+                              request, RESULTS_FILE, "job_1"),
+                          PXPConnector::StreamError);
+        REQUIRE(connector.queued.size() == 2u);
+        REQUIRE(connector.queued.front().message_type
+                == PXPSchemas::RESULTS_FRAGMENT_TYPE);
+        REQUIRE(connector.queued.back().message_type
+                == PXPSchemas::PXP_ERROR_MSG_TYPE);
+    }
+
+    SECTION("aborts the stream if the first fragment can't be queued") {
+        QueueingConnector connector { getConfiguration(1) };
+        connector.max_fragments = 0;
+
+        REQUIRE_THROWS_AS(connector.sendFragmentedNonBlockingResponse(
+                              request, RESULTS_FILE, "job_1"),
+                          PXPConnector::StreamError);
+        REQUIRE(connector.queued.size() == 1u);
+        REQUIRE(connector.queued.front().message_type
+                == PXPSchemas::PXP_ERROR_MSG_TYPE);
+    }
+}
+
+#endif  // TEST_VIRTUAL
+
+}  // namespace PXPAgent
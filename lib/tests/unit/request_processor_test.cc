@@ -105,7 +105,7 @@ class TestConnector : public PXPConnector {
     }
 
     void sendBlockingResponse(const ActionRequest&,
-                              const lth_jc::JsonContainer&) {
+                              lth_jc::JsonContainer&&) {
         throw blocking_response {};
     }
 
@@ -113,7 +113,7 @@ class TestConnector : public PXPConnector {
     // another thread
 
     virtual void sendNonBlockingResponse(const ActionRequest&,
-                                         const lth_jc::JsonContainer&,
+                                         lth_jc::JsonContainer&&,
                                          const std::string&) {
         sent_non_blocking_response = true;
     }
@@ -0,0 +1,219 @@
+#include <pxp-agent/request_scheduler.hpp>
+
+#include <cpp-pcp-client/util/thread.hpp>
+#include <cpp-pcp-client/util/chrono.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace pcp_util = PCPClient::Util;
+
+TEST_CASE("TokenBucket::tryConsume", "[scheduler]") {
+    auto now = TokenBucket::clock::now();
+
+    SECTION("can consume up to the burst size at once") {
+        TokenBucket bucket { 1.0, 3.0 };
+        REQUIRE(bucket.tryConsume(now));
+        REQUIRE(bucket.tryConsume(now));
+        REQUIRE(bucket.tryConsume(now));
+        REQUIRE_FALSE(bucket.tryConsume(now));
+    }
+
+    SECTION("refills over time") {
+        TokenBucket bucket { 2.0, 1.0 };
+        REQUIRE(bucket.tryConsume(now));
+        REQUIRE_FALSE(bucket.tryConsume(now));
+        REQUIRE(bucket.tryConsume(now + pcp_util::chrono::milliseconds(600)));
+    }
+
+    SECTION("is full once refilled") {
+        TokenBucket bucket { 10.0, 2.0 };
+        REQUIRE(bucket.tryConsume(now));
+        REQUIRE_FALSE(bucket.isFull(now));
+        REQUIRE(bucket.isFull(now + pcp_util::chrono::seconds(1)));
+    }
+}
+
+TEST_CASE("RequestScheduler::admit", "[scheduler]") {
+    SECTION("admits everything when rate limiting is disabled") {
+        RequestScheduler scheduler {};
+        for (auto idx = 0; idx < 100; idx++) {
+            REQUIRE(scheduler.admit("pcp://controller/spammer"));
+        }
+    }
+
+    SECTION("rejects requests above the burst size of a sender") {
+        RequestScheduler scheduler { 0, 0.001, 2 };
+        REQUIRE(scheduler.admit("pcp://controller/spammer"));
+        REQUIRE(scheduler.admit("pcp://controller/spammer"));
+        REQUIRE_FALSE(scheduler.admit("pcp://controller/spammer"));
+
+        SECTION("without affecting other senders") {
+            REQUIRE(scheduler.admit("pcp://controller/polite"));
+        }
+    }
+
+    SECTION("evicts the least recently used buckets") {
+        RequestScheduler scheduler { 0, 0.001, 1 };
+        REQUIRE(scheduler.admit("pcp://controller/spammer"));
+
+        // NB: 1024 buckets are kept
+        for (auto idx = 0; idx < 1023; idx++) {
+            REQUIRE(scheduler.admit("pcp://controller/" + std::to_string(idx)));
+        }
+
+        SECTION("keeping the recently used ones") {
+            REQUIRE_FALSE(scheduler.admit("pcp://controller/spammer"));
+            REQUIRE(scheduler.admit("pcp://controller/new"));
+            REQUIRE_FALSE(scheduler.admit("pcp://controller/spammer"));
+            REQUIRE_FALSE(scheduler.admit("pcp://controller/new"));
+        }
+
+        SECTION("discarding the least recently used one") {
+            REQUIRE(scheduler.admit("pcp://controller/new"));
+            REQUIRE(scheduler.admit("pcp://controller/spammer"));
+        }
+    }
+}
+
+static void waitForJobs(RequestScheduler& scheduler) {
+    while (scheduler.getNumRunningJobs() > 0) {
+        pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+    }
+
+    // Let the worker threads flag their completion, otherwise the
+    // ThreadContainer dtor will invoke std::terminate
+    pcp_util::this_thread::sleep_for(pcp_util::chrono::milliseconds(10));
+}
+
+TEST_CASE("RequestScheduler::schedule", "[scheduler]") {
+    SECTION("starts the jobs immediately when there is no limit") {
+        RequestScheduler scheduler {};
+        std::atomic<int> counter { 0 };
+
+        for (auto idx = 0; idx < 5; idx++) {
+            REQUIRE(scheduler.schedule("pcp://controller/test",
+                                       [&counter]() { counter++; }));
+        }
+
+        waitForJobs(scheduler);
+        REQUIRE(counter == 5);
+        REQUIRE(scheduler.getNumQueuedJobs() == 0);
+    }
+
+    SECTION("queues the jobs above the concurrency limit") {
+        RequestScheduler scheduler { 1 };
+        std::atomic<bool> release { false };
+        std::atomic<int> counter { 0 };
+
+        REQUIRE(scheduler.schedule("pcp://controller/test",
+                                   [&release]() {
+                                       while (!release) {
+                                           pcp_util::this_thread::sleep_for(
+                                               pcp_util::chrono::milliseconds(10));
+                                       }
+                                   }));
+        REQUIRE_FALSE(scheduler.schedule("pcp://controller/test",
+                                         [&counter]() { counter++; }));
+        REQUIRE(scheduler.getNumRunningJobs() == 1);
+        REQUIRE(scheduler.getNumQueuedJobs() == 1);
+
+        release = true;
+        waitForJobs(scheduler);
+        REQUIRE(counter == 1);
+        REQUIRE(scheduler.getNumQueuedJobs() == 0);
+    }
+
+    SECTION("rejects the jobs above the queue limit") {
+        RequestScheduler scheduler { 1, 0.0, 1, 1 };
+        std::atomic<bool> release { false };
+        std::atomic<int> counter { 0 };
+
+        REQUIRE_FALSE(scheduler.isFull());
+        REQUIRE(scheduler.schedule("pcp://controller/test",
+                                   [&release]() {
+                                       while (!release) {
+                                           pcp_util::this_thread::sleep_for(
+                                               pcp_util::chrono::milliseconds(10));
+                                       }
+                                   }));
+        REQUIRE_FALSE(scheduler.isFull());
+        REQUIRE_FALSE(scheduler.schedule("pcp://controller/test",
+                                         [&counter]() { counter++; }));
+        REQUIRE(scheduler.isFull());
+        REQUIRE_THROWS_AS(scheduler.schedule("pcp://controller/other",
+                                             [&counter]() { counter++; }),
+                          RequestScheduler::Error);
+        REQUIRE(scheduler.getNumQueuedJobs() == 1);
+
+        release = true;
+        waitForJobs(scheduler);
+        REQUIRE(counter == 1);
+        REQUIRE_FALSE(scheduler.isFull());
+    }
+
+    SECTION("serves the queued jobs of different senders in round-robin") {
+        RequestScheduler scheduler { 1 };
+        std::atomic<bool> release { false };
+        std::vector<std::string> order {};
+
+        scheduler.schedule("pcp://controller/first",
+                           [&release]() {
+                               while (!release) {
+                                   pcp_util::this_thread::sleep_for(
+                                       pcp_util::chrono::milliseconds(10));
+                               }
+                           });
+
+        // NB: the queued jobs are executed sequentially by the same
+        // thread, so there's no need to synchronize 'order'
+        for (auto idx = 0; idx < 3; idx++) {
+            scheduler.schedule("pcp://controller/greedy",
+                               [&order]() { order.push_back("greedy"); });
+        }
+        scheduler.schedule("pcp://controller/polite",
+                           [&order]() { order.push_back("polite"); });
+
+        release = true;
+        waitForJobs(scheduler);
+        REQUIRE(order == (std::vector<std::string> {
+            "greedy", "polite", "greedy", "greedy" }));
+    }
+}
+
+TEST_CASE("RequestScheduler::drain", "[scheduler]") {
+    RequestScheduler scheduler { 1 };
+    std::atomic<int> counter { 0 };
+
+    scheduler.schedule("pcp://controller/test",
+                       []() {
+                           pcp_util::this_thread::sleep_for(
+                               pcp_util::chrono::milliseconds(100));
+                       });
+    scheduler.schedule("pcp://controller/test", [&counter]() { counter++; });
+
+    SECTION("waits for the running jobs without starting the queued ones") {
+        REQUIRE(scheduler.drain(1000));
+        REQUIRE(scheduler.isDraining());
+        REQUIRE(counter == 0);
+    }
+
+    SECTION("returns false if the running jobs don't complete in time") {
+        REQUIRE_FALSE(scheduler.drain(0));
+        waitForJobs(scheduler);
+    }
+
+    SECTION("does not accept jobs once draining") {
+        scheduler.drain(1000);
+        REQUIRE_THROWS_AS(scheduler.schedule("pcp://controller/test",
+                                             [&counter]() { counter++; }),
+                          RequestScheduler::Error);
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,77 @@
+#include <pxp-agent/request_timeline.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace lth_jc = leatherman::json_container;
+
+TEST_CASE("RequestTimeline::stamp", "[request]") {
+    RequestTimeline timeline {};
+
+    SECTION("the receipt is stamped on instantiation") {
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Received) == 0);
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Sent) == -1);
+    }
+
+    SECTION("stamps the elapsed time since the receipt") {
+        timeline.stamp(RequestTimeline::Event::Validated);
+        timeline.stamp(RequestTimeline::Event::Sent);
+
+        auto validated = timeline.elapsedMicroseconds(RequestTimeline::Event::Validated);
+        REQUIRE(validated >= 0);
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Sent)
+                >= validated);
+    }
+}
+
+TEST_CASE("RequestTimeline::elapsedMicroseconds", "[request]") {
+    RequestTimeline timeline {};
+    timeline.stamp(RequestTimeline::Event::Validated);
+    timeline.stamp(RequestTimeline::Event::Sent);
+
+    SECTION("returns the time elapsed between two events") {
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Validated,
+                                             RequestTimeline::Event::Sent)
+                == timeline.elapsedMicroseconds(RequestTimeline::Event::Sent)
+                   - timeline.elapsedMicroseconds(RequestTimeline::Event::Validated));
+    }
+
+    SECTION("returns -1 if either event was not stamped") {
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Started,
+                                             RequestTimeline::Event::Sent) == -1);
+        REQUIRE(timeline.elapsedMicroseconds(RequestTimeline::Event::Validated,
+                                             RequestTimeline::Event::Exited) == -1);
+    }
+}
+
+TEST_CASE("RequestTimeline::getDebugChunk", "[request]") {
+    RequestTimeline timeline {};
+    timeline.stamp(RequestTimeline::Event::Validated);
+    timeline.stamp(RequestTimeline::Event::Sent);
+
+    auto hops = timeline.getDebugChunk().get<std::vector<lth_jc::JsonContainer>>(
+        "hops");
+
+    SECTION("reports a hop for each stamped event, in order") {
+        REQUIRE(hops.size() == 3u);
+        REQUIRE(hops[0].get<std::string>("stage") == "received");
+        REQUIRE(hops[1].get<std::string>("stage") == "validated");
+        REQUIRE(hops[2].get<std::string>("stage") == "sent");
+    }
+
+    SECTION("hops have the PCP entries and the elapsed time") {
+        for (const auto& hop : hops) {
+            REQUIRE(hop.get<std::string>("server") == "pxp-agent");
+            REQUIRE(hop.get<std::string>("time").back() == 'Z');
+            REQUIRE(hop.get<double>("elapsed_ms") >= 0.0);
+        }
+    }
+}
+
+}  // namespace PXPAgent
@@ -0,0 +1,103 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/spool_layout.hpp>
+
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+static void createLegacyJob(const std::string& job_id, bool completed) {
+    auto job_path = fs::path(SPOOL_DIR) / job_id;
+    if (!fs::exists(job_path) && !fs::create_directories(job_path)) {
+        FAIL("Failed to create the job directory");
+    }
+
+    lth_file::atomic_write_to_file(
+        std::string { "{\"completed\":" } + (completed ? "true" : "false") + "}\n",
+        (job_path / "metadata").string());
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("SpoolLayout::getJobDir", "[spool]") {
+    SECTION("places the job in a shard named with two hex digits") {
+        auto shard = SpoolLayout::getShard("the-job");
+
+        REQUIRE(shard.size() == 2);
+        REQUIRE(shard.find_first_not_of("0123456789abcdef") == std::string::npos);
+        REQUIRE(SpoolLayout::getJobDir(SPOOL_DIR, "the-job")
+                == (fs::path(SPOOL_DIR) / shard / "the-job").string());
+    }
+
+    SECTION("is deterministic") {
+        REQUIRE(SpoolLayout::getShard("the-job") == SpoolLayout::getShard("the-job"));
+    }
+}
+
+TEST_CASE("SpoolLayout::findJobDir", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+
+    SECTION("returns the sharded directory of an unknown job") {
+        REQUIRE(SpoolLayout::findJobDir(SPOOL_DIR, "unknown")
+                == SpoolLayout::getJobDir(SPOOL_DIR, "unknown"));
+    }
+
+    SECTION("returns the directory of a job stored with the legacy layout") {
+        createLegacyJob("legacy", false);
+        REQUIRE(SpoolLayout::findJobDir(SPOOL_DIR, "legacy")
+                == (fs::path(SPOOL_DIR) / "legacy").string());
+    }
+}
+
+TEST_CASE("SpoolLayout::migrate", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    createLegacyJob("completed", true);
+    createLegacyJob("running", false);
+
+    REQUIRE(SpoolLayout::migrate(SPOOL_DIR) == 1);
+
+    SECTION("moves the completed jobs to their shard") {
+        REQUIRE(fs::exists(fs::path(SpoolLayout::getJobDir(SPOOL_DIR, "completed"))
+                           / "metadata"));
+        REQUIRE_FALSE(fs::exists(fs::path(SPOOL_DIR) / "completed"));
+    }
+
+    SECTION("leaves the incomplete jobs in place") {
+        REQUIRE(fs::exists(fs::path(SPOOL_DIR) / "running" / "metadata"));
+    }
+
+    SECTION("lists the jobs of both layouts") {
+        REQUIRE(SpoolLayout::listJobDirs(SPOOL_DIR).size() == 2);
+    }
+
+    SECTION("scans the spool until no job is left in the legacy layout") {
+        fs::remove_all(fs::path(SPOOL_DIR) / "running");
+        createLegacyJob("done", true);
+
+        REQUIRE(SpoolLayout::migrate(SPOOL_DIR) == 1);
+
+        createLegacyJob("late", true);
+
+        REQUIRE(SpoolLayout::migrate(SPOOL_DIR) == 0);
+        REQUIRE(fs::exists(fs::path(SPOOL_DIR) / "late"));
+    }
+}
+
+}  // namespace PXPAgent
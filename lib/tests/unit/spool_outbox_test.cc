@@ -0,0 +1,127 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/spool_outbox.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+static OutboundQueue::Message getMessage(const std::string& transaction_id) {
+    lth_jc::JsonContainer data {};
+    data.set<std::string>("transaction_id", transaction_id);
+    return OutboundQueue::Message { { "pcp://controller/test_controller" },
+                                    "http://puppetlabs.com/rpc_non_blocking_response",
+                                    data,
+                                    {},
+                                    "response for transaction " + transaction_id,
+                                    true,
+                                    0,
+                                    "" };
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("SpoolOutbox::store", "[outbox]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    SpoolOutbox outbox { SPOOL_DIR };
+
+    SECTION("creates the outbox directory") {
+        REQUIRE_NOTHROW(outbox.store(getMessage("1")));
+        REQUIRE(fs::is_directory(fs::path(SPOOL_DIR) / "outbox"));
+        REQUIRE(outbox.size() == 1u);
+    }
+}
+
+TEST_CASE("SpoolOutbox::take", "[outbox]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+
+    {
+        SpoolOutbox outbox { SPOOL_DIR };
+
+        for (auto idx = 1; idx <= 12; idx++) {
+            outbox.store(getMessage(std::to_string(idx)));
+        }
+    }
+
+    SECTION("retrieves the stored messages in order, after a restart") {
+        SpoolOutbox outbox { SPOOL_DIR };
+        REQUIRE(outbox.size() == 12u);
+
+        auto messages = outbox.take(5);
+        REQUIRE(messages.size() == 5u);
+
+        for (auto idx = 0; idx < 5; idx++) {
+            REQUIRE(messages[idx].data.get<std::string>("transaction_id")
+                    == std::to_string(idx + 1));
+            REQUIRE(messages[idx].persistent);
+            REQUIRE(messages[idx].targets
+                    == std::vector<std::string> { "pcp://controller/test_controller" });
+        }
+
+        REQUIRE(outbox.take().size() == 7u);
+        REQUIRE(outbox.take().empty());
+    }
+
+    SECTION("keeps the files of the retrieved messages until removed") {
+        {
+            SpoolOutbox outbox { SPOOL_DIR };
+            auto messages = outbox.take(5);
+            REQUIRE(outbox.size() == 12u);
+
+            outbox.remove(messages[0].outbox_sequence_number);
+            outbox.remove(messages[1].outbox_sequence_number);
+            REQUIRE(outbox.size() == 10u);
+        }
+
+        // After a restart, the messages not removed are retrieved again
+        SpoolOutbox outbox { SPOOL_DIR };
+        auto messages = outbox.take(20);
+
+        REQUIRE(messages.size() == 10u);
+        REQUIRE(messages.front().data.get<std::string>("transaction_id") == "3");
+    }
+
+    SECTION("puts an undelivered message back in its original position") {
+        SpoolOutbox outbox { SPOOL_DIR };
+        auto messages = outbox.take(3);
+        REQUIRE(messages[0].outbox_sequence_number > 0u);
+
+        outbox.store(messages[0]);
+        REQUIRE(outbox.size() == 12u);
+
+        auto retaken = outbox.take(2);
+        REQUIRE(retaken.size() == 2u);
+        REQUIRE(retaken[0].data.get<std::string>("transaction_id") == "1");
+        REQUIRE(retaken[0].outbox_sequence_number
+                == messages[0].outbox_sequence_number);
+        REQUIRE(retaken[1].data.get<std::string>("transaction_id") == "4");
+    }
+
+    SECTION("stores new messages after the existing ones") {
+        SpoolOutbox outbox { SPOOL_DIR };
+        outbox.store(getMessage("13"));
+        auto messages = outbox.take(20);
+
+        REQUIRE(messages.size() == 13u);
+        REQUIRE(messages.back().data.get<std::string>("transaction_id") == "13");
+    }
+}
+
+}  // namespace PXPAgent
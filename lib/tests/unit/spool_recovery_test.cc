@@ -0,0 +1,176 @@
+#include "root_path.hpp"
+
+#include <pxp-agent/spool_recovery.hpp>
+#include <pxp-agent/util/process.hpp>
+
+#include <leatherman/json_container/json_container.hpp>
+#include <leatherman/file_util/file.hpp>
+#include <leatherman/util/scope_exit.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <catch.hpp>
+
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace PXPAgent {
+
+namespace fs = boost::filesystem;
+namespace lth_jc = leatherman::json_container;
+namespace lth_file = leatherman::file_util;
+namespace lth_util = leatherman::util;
+
+static const std::string SPOOL_DIR { std::string { PXP_AGENT_ROOT_PATH }
+                                     + "/lib/tests/resources/test_spool" };
+
+// NB: no process can have such PID
+static const int DEAD_PID { std::numeric_limits<int>::max() };
+
+static void createJob(const std::string& job_id,
+                      int pid,
+                      uint64_t start_time = 0) {
+    auto job_path = fs::path(SPOOL_DIR) / job_id;
+    if (!fs::exists(job_path) && !fs::create_directories(job_path)) {
+        FAIL("Failed to create the job directory");
+    }
+
+    lth_jc::JsonContainer metadata {};
+    metadata.set<std::string>("module", "reverse");
+    metadata.set<std::string>("action", "string");
+    metadata.set<bool>("completed", false);
+    metadata.set<bool>("notify_outcome", false);
+    lth_file::atomic_write_to_file(metadata.toString() + "\n",
+                                   (job_path / "metadata").string());
+    lth_file::atomic_write_to_file(std::to_string(pid) + "\n"
+                                   + std::to_string(start_time) + "\n",
+                                   (job_path / "pid").string());
+}
+
+static lth_jc::JsonContainer readJobMetadata(const std::string& job_id) {
+    return lth_jc::JsonContainer {
+        lth_file::read((fs::path(SPOOL_DIR) / job_id / "metadata").string()) };
+}
+
+static void resetTest() {
+    fs::remove_all(SPOOL_DIR);
+}
+
+TEST_CASE("SpoolRecovery::adoptJobs", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+
+    SECTION("does not throw if the spool directory does not exist") {
+        SpoolRecovery recovery { SPOOL_DIR + "/fake_dir", nullptr };
+        REQUIRE(recovery.adoptJobs() == 0);
+    }
+
+    SECTION("finalizes the jobs that completed while not running") {
+        createJob("completed-job", DEAD_PID);
+        lth_file::atomic_write_to_file(
+            "3\n", (fs::path(SPOOL_DIR) / "completed-job" / "exitcode").string());
+        SpoolRecovery recovery { SPOOL_DIR, nullptr };
+
+        REQUIRE(recovery.adoptJobs() == 0);
+        auto metadata = readJobMetadata("completed-job");
+        REQUIRE(metadata.get<bool>("completed"));
+        REQUIRE(metadata.get<bool>("adopted"));
+        REQUIRE(metadata.get<int>("exitcode") == 3);
+    }
+
+    SECTION("flags the jobs without exit code as interrupted") {
+        createJob("lost-job", DEAD_PID);
+        SpoolRecovery recovery { SPOOL_DIR, nullptr };
+
+        REQUIRE(recovery.adoptJobs() == 0);
+        auto metadata = readJobMetadata("lost-job");
+        REQUIRE(metadata.get<bool>("completed"));
+        REQUIRE(metadata.get<bool>("interrupted"));
+    }
+
+    SECTION("adopts the jobs whose process is executing") {
+        createJob("running-job", Util::getPid());
+        SpoolRecovery recovery { SPOOL_DIR, nullptr };
+
+        REQUIRE(recovery.adoptJobs() == 1);
+        REQUIRE_FALSE(readJobMetadata("running-job").get<bool>("completed"));
+    }
+
+    SECTION("adopts the jobs whose process start time matches") {
+        createJob("running-job", Util::getPid(),
+                  Util::getProcessStartTime(Util::getPid()));
+        SpoolRecovery recovery { SPOOL_DIR, nullptr };
+
+        REQUIRE(recovery.adoptJobs() == 1);
+    }
+
+#ifdef __linux__
+    SECTION("does not adopt the jobs whose PID was recycled") {
+        createJob("recycled-job", Util::getPid(),
+                  Util::getProcessStartTime(Util::getPid()) + 1);
+        SpoolRecovery recovery { SPOOL_DIR, nullptr };
+
+        REQUIRE(recovery.adoptJobs() == 0);
+        REQUIRE(readJobMetadata("recycled-job").get<bool>("interrupted"));
+    }
+#endif
+}
+
+TEST_CASE("SpoolRecovery::scan", "[spool]") {
+    lth_util::scope_exit spool_cleaner { resetTest };
+    auto index_ptr = std::make_shared<JobIndex>();
+
+    createJob("running-job", Util::getPid());
+    createJob("lost-job", DEAD_PID);
+    createJob("exited-job", DEAD_PID);
+    lth_file::atomic_write_to_file(
+        "0\n", (fs::path(SPOOL_DIR) / "exited-job" / "exitcode").string());
+    createJob("completed-job", DEAD_PID);
+    auto metadata = readJobMetadata("completed-job");
+    metadata.set<bool>("completed", true);
+    metadata.set<int>("exitcode", 0);
+    lth_file::atomic_write_to_file(
+        metadata.toString() + "\n",
+        (fs::path(SPOOL_DIR) / "completed-job" / "metadata").string());
+
+    SECTION("classifies the jobs") {
+        SpoolRecovery recovery { SPOOL_DIR, nullptr, index_ptr };
+        auto report = recovery.scan();
+
+        REQUIRE(report.num_jobs == 4);
+        REQUIRE(report.num_completed == 1);
+        REQUIRE(report.num_running == 1);
+        REQUIRE(report.num_exited == 1);
+        REQUIRE(report.num_interrupted == 1);
+        REQUIRE(report.num_invalid == 0);
+    }
+
+    SECTION("indexes the jobs") {
+        SpoolRecovery recovery { SPOOL_DIR, nullptr, index_ptr };
+        recovery.scan();
+        JobIndex::Entry entry {};
+
+        // NB: only the jobs in progress
+        REQUIRE(index_ptr->size() == 2);
+        REQUIRE(index_ptr->find("running-job", entry));
+        REQUIRE(entry.job_dir == (fs::path(SPOOL_DIR) / "running-job").string());
+        REQUIRE(index_ptr->find("exited-job", entry));
+        REQUIRE_FALSE(index_ptr->find("lost-job", entry));
+        REQUIRE_FALSE(index_ptr->find("completed-job", entry));
+
+        recovery.adoptJobs();
+        REQUIRE_FALSE(index_ptr->find("exited-job", entry));
+        REQUIRE(index_ptr->size() == 1);
+    }
+
+    SECTION("ignores the specified jobs") {
+        SpoolRecovery recovery { SPOOL_DIR, nullptr, index_ptr };
+        auto report = recovery.scan({ "lost-job" });
+
+        REQUIRE(report.num_jobs == 3);
+        REQUIRE_FALSE(readJobMetadata("lost-job").get<bool>("completed"));
+    }
+}
+
+}  // namespace PXPAgent
@@ -79,6 +79,48 @@ TEST_CASE("ThreadContainer::add, ~ThreadContainer", "[async]") {
     }
 }
 
+TEST_CASE("ThreadContainer::waitForAll", "[async]") {
+    SECTION("returns true once all threads have completed") {
+        ThreadContainer container { "TESTING_4_1" };
+        addTasksTo(container, 5, 0, 50000);
+        REQUIRE(container.waitForAll(1000));
+    }
+
+    SECTION("returns false if the threads don't complete in time") {
+        ThreadContainer container { "TESTING_4_2" };
+        addTasksTo(container, 1, 0, 300000);
+        REQUIRE_FALSE(container.waitForAll(10));
+        REQUIRE(container.waitForAll(1000));
+    }
+}
+
+TEST_CASE("ThreadContainer::getNumRunningThreads", "[async]") {
+    SECTION("counts only the threads that have not completed") {
+        ThreadContainer container { "TESTING_6_1" };
+        addTasksTo(container, 2, 0, 300000);
+        REQUIRE(container.getNumRunningThreads() == 2u);
+        REQUIRE(container.waitForAll(1000));
+        REQUIRE(container.getNumRunningThreads() == 0u);
+    }
+}
+
+TEST_CASE("ThreadContainer::~ThreadContainer", "[async]") {
+    SECTION("detaches the threads that are still executing") {
+        std::shared_ptr<std::atomic<bool>> a { new std::atomic<bool> { false } };
+
+        auto f = [a]{
+                    ThreadContainer container { "TESTING_5_1" };
+                    auto t = PCPClient::Util::thread(testTask, a, 100000);
+                    container.add(std::move(t), a);
+                 };
+        REQUIRE_NOTHROW(f());
+
+        // Let the detached thread complete
+        PCPClient::Util::this_thread::sleep_for(PCPClient::Util::chrono::microseconds(200000));
+        REQUIRE(*a);
+    }
+}
+
 auto monitoring_interval_us = THREADS_MONITORING_INTERVAL_MS * 1000;
 
 TEST_CASE("ThreadContainer::monitoringTask", "[async]") {
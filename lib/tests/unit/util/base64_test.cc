@@ -0,0 +1,45 @@
+#include <pxp-agent/util/base64.hpp>
+
+#include <catch.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace PXPAgent {
+namespace Util {
+
+TEST_CASE("Util::base64Encode", "[util]") {
+    SECTION("encodes the RFC 4648 test vectors") {
+        REQUIRE(base64Encode("") == "");
+        REQUIRE(base64Encode("f") == "Zg==");
+        REQUIRE(base64Encode("fo") == "Zm8=");
+        REQUIRE(base64Encode("foo") == "Zm9v");
+        REQUIRE(base64Encode("foob") == "Zm9vYg==");
+        REQUIRE(base64Encode("fooba") == "Zm9vYmE=");
+        REQUIRE(base64Encode("foobar") == "Zm9vYmFy");
+    }
+
+    SECTION("encodes binary data") {
+        REQUIRE(base64Encode(std::string("\x00\xff\xfe", 3)) == "AP/+");
+    }
+}
+
+TEST_CASE("Util::base64Decode", "[util]") {
+    SECTION("decodes what was encoded") {
+        std::string data {};
+
+        for (auto idx = 0; idx < 256; idx++) {
+            data.push_back(static_cast<char>(idx));
+            REQUIRE(base64Decode(base64Encode(data)) == data);
+        }
+    }
+
+    SECTION("throws a std::invalid_argument in case of invalid text") {
+        REQUIRE_THROWS_AS(base64Decode("Zm9"), std::invalid_argument);
+        REQUIRE_THROWS_AS(base64Decode("Zm9*"), std::invalid_argument);
+        REQUIRE_THROWS_AS(base64Decode("Z==="), std::invalid_argument);
+    }
+}
+
+}  // namespace Util
+}  // namespace PXPAgent
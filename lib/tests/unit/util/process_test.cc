@@ -22,6 +22,52 @@ TEST_CASE("processExists", "[util]") {
     }
 }
 
+TEST_CASE("processExists with start time", "[util]") {
+    auto start_time = getProcessStartTime(getPid());
+
+    SECTION("this process is executing") {
+        REQUIRE(processExists(getPid(), start_time));
+    }
+
+    SECTION("an unknown start time is ignored") {
+        REQUIRE(processExists(getPid(), 0));
+    }
+
+#ifdef __linux__
+    SECTION("a recycled PID is not executing") {
+        REQUIRE(start_time > 0);
+        REQUIRE_FALSE(processExists(getPid(), start_time + 1));
+    }
+#endif
+}
+
+TEST_CASE("ProcessSnapshot::processExists", "[util]") {
+    ProcessSnapshot snapshot {};
+
+    auto start_time = getProcessStartTime(getPid());
+
+    SECTION("this process is executing") {
+        REQUIRE(snapshot.processExists(getPid(), start_time));
+    }
+
+    SECTION("an unknown start time is ignored") {
+        REQUIRE(snapshot.processExists(getPid(), 0));
+    }
+
+#ifdef __linux__
+    SECTION("a recycled PID is not executing") {
+        REQUIRE(start_time > 0);
+        REQUIRE_FALSE(snapshot.processExists(getPid(), start_time + 1));
+    }
+#endif
+}
+
+TEST_CASE("waitForProcessExit", "[util]") {
+    SECTION("times out if the process is executing") {
+        REQUIRE_FALSE(waitForProcessExit(getPid(), 10));
+    }
+}
+
 TEST_CASE("getPid", "[util]") {
     SECTION("can call it") {
         REQUIRE_NOTHROW(getPid());